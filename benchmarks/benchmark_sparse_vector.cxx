@@ -0,0 +1,340 @@
+#include <benchmark/benchmark.h>
+
+#include <mixedbag/sparse_vector.hxx>
+
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compares sparse_vector with the standard containers that are used for the same purpose, for each operation, element count, index spread,
+// element size and index type. The index spread is the ratio of the index range to the number of elements, so a spread of one means that all
+// indices in the range are present.
+
+namespace {
+
+    template <std::size_t Size>
+    struct Payload {
+        std::array<std::uint64_t, Size / sizeof(std::uint64_t)> words{};
+
+        auto operator<=>(const Payload& other) const = default;
+    };
+
+    // Each container is used through the same static functions, so that every benchmark can be written once
+
+    template <typename T, typename SizeT, std::size_t PageSize>
+    struct sparse_vector_container {
+        using type = ARo::sparse_vector<T, SizeT, true, PageSize>;
+
+        static void prepare(type& /*c*/, std::size_t /*extent*/) {}
+
+        static void insert(type& c, SizeT index, const T& value)
+        {
+            c.insert(index, value);
+        }
+
+        static void erase(type& c, SizeT index)
+        {
+            c.erase(index);
+        }
+
+        static const T& at(const type& c, SizeT index)
+        {
+            return c[index];
+        }
+
+        static const T* find(const type& c, SizeT index)
+        {
+            return c.get_if(index);
+        }
+
+        template <typename Func>
+        static void for_each(const type& c, Func func)
+        {
+            for (const auto& value : c)
+                func(value);
+        }
+    };
+
+    template <typename T, typename SizeT>
+    struct unordered_map_container {
+        using type = std::unordered_map<SizeT, T>;
+
+        static void prepare(type& /*c*/, std::size_t /*extent*/) {}
+
+        static void insert(type& c, SizeT index, const T& value)
+        {
+            c.emplace(index, value);
+        }
+
+        static void erase(type& c, SizeT index)
+        {
+            c.erase(index);
+        }
+
+        static const T& at(const type& c, SizeT index)
+        {
+            return c.at(index);
+        }
+
+        static const T* find(const type& c, SizeT index)
+        {
+            const auto it = c.find(index);
+            return it == c.end() ? nullptr : &it->second;
+        }
+
+        template <typename Func>
+        static void for_each(const type& c, Func func)
+        {
+            for (const auto& [index, value] : c)
+                func(value);
+        }
+    };
+
+    template <typename T, typename SizeT>
+    struct map_container {
+        using type = std::map<SizeT, T>;
+
+        static void prepare(type& /*c*/, std::size_t /*extent*/) {}
+
+        static void insert(type& c, SizeT index, const T& value)
+        {
+            c.emplace(index, value);
+        }
+
+        static void erase(type& c, SizeT index)
+        {
+            c.erase(index);
+        }
+
+        static const T& at(const type& c, SizeT index)
+        {
+            return c.at(index);
+        }
+
+        static const T* find(const type& c, SizeT index)
+        {
+            const auto it = c.find(index);
+            return it == c.end() ? nullptr : &it->second;
+        }
+
+        template <typename Func>
+        static void for_each(const type& c, Func func)
+        {
+            for (const auto& [index, value] : c)
+                func(value);
+        }
+    };
+
+    template <typename T, typename SizeT>
+    struct optional_vector_container {
+        using type = std::vector<std::optional<T>>;
+
+        // Sized up front, as it would be when the index range is known
+        static void prepare(type& c, std::size_t extent)
+        {
+            c.resize(extent);
+        }
+
+        static void insert(type& c, SizeT index, const T& value)
+        {
+            c[index] = value;
+        }
+
+        static void erase(type& c, SizeT index)
+        {
+            c[index].reset();
+        }
+
+        static const T& at(const type& c, SizeT index)
+        {
+            return *c[index];
+        }
+
+        static const T* find(const type& c, SizeT index)
+        {
+            return index < c.size() && c[index] ? &*c[index] : nullptr;
+        }
+
+        template <typename Func>
+        static void for_each(const type& c, Func func)
+        {
+            for (const auto& value : c) {
+                if (value)
+                    func(*value);
+            }
+        }
+    };
+
+    // The indices of the elements, and indices in the same range that are not present, both in random order
+    template <typename SizeT>
+    struct index_set {
+        std::vector<SizeT> present;
+        std::vector<SizeT> absent;
+        std::size_t extent = 0;
+
+        index_set(std::size_t count, std::size_t spread)
+            : extent(2 * count * spread)
+        {
+            std::mt19937_64 random(count ^ spread);
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto slot = i * spread + random() % spread;
+                present.push_back(static_cast<SizeT>(2 * slot));
+                absent.push_back(static_cast<SizeT>(2 * slot + 1));
+            }
+            std::ranges::shuffle(present, random);
+            std::ranges::shuffle(absent, random);
+        }
+    };
+
+    template <typename Container, typename T, typename SizeT>
+    typename Container::type make_filled(const index_set<SizeT>& indices)
+    {
+        typename Container::type c;
+        Container::prepare(c, indices.extent);
+        for (const auto index : indices.present)
+            Container::insert(c, index, T{{index}});
+        return c;
+    }
+
+    template <typename Container, typename T, typename SizeT>
+    void insert(benchmark::State& state)
+    {
+        const index_set<SizeT> indices(static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+        for (auto _ : state) {
+            typename Container::type c;
+            Container::prepare(c, indices.extent);
+            for (const auto index : indices.present)
+                Container::insert(c, index, T{{index}});
+            benchmark::DoNotOptimize(c);
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * indices.present.size()));
+    }
+
+    template <typename Container, typename T, typename SizeT>
+    void erase(benchmark::State& state)
+    {
+        const index_set<SizeT> indices(static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+        const auto filled = make_filled<Container, T>(indices);
+        for (auto _ : state) {
+            state.PauseTiming();
+            auto c = filled;
+            state.ResumeTiming();
+            for (const auto index : indices.present)
+                Container::erase(c, index);
+            benchmark::DoNotOptimize(c);
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * indices.present.size()));
+    }
+
+    template <typename Container, typename T, typename SizeT>
+    void lookup_hit(benchmark::State& state)
+    {
+        const index_set<SizeT> indices(static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+        const auto c = make_filled<Container, T>(indices);
+        for (auto _ : state) {
+            std::uint64_t sum = 0;
+            for (const auto index : indices.present)
+                sum += Container::at(c, index).words[0];
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * indices.present.size()));
+    }
+
+    template <typename Container, typename T, typename SizeT>
+    void lookup_miss(benchmark::State& state)
+    {
+        const index_set<SizeT> indices(static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+        const auto c = make_filled<Container, T>(indices);
+        for (auto _ : state) {
+            std::size_t found = 0;
+            for (const auto index : indices.absent)
+                found += Container::find(c, index) != nullptr ? 1 : 0;
+            benchmark::DoNotOptimize(found);
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * indices.absent.size()));
+    }
+
+    template <typename Container, typename T, typename SizeT>
+    void iterate(benchmark::State& state)
+    {
+        const index_set<SizeT> indices(static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+        const auto c = make_filled<Container, T>(indices);
+        for (auto _ : state) {
+            std::uint64_t sum = 0;
+            Container::for_each(c, [&sum](const T& value) { sum += value.words[0]; });
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * indices.present.size()));
+    }
+
+    // Compares equal containers, which have to be compared in full, filled in different orders
+    template <typename Container, typename T, typename SizeT>
+    void compare(benchmark::State& state)
+    {
+        auto indices = index_set<SizeT>(static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+        const auto c = make_filled<Container, T>(indices);
+        std::ranges::reverse(indices.present);
+        const auto other = make_filled<Container, T>(indices);
+        for (auto _ : state) {
+            bool equal = c == other;
+            benchmark::DoNotOptimize(equal);
+        }
+        state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * indices.present.size()));
+    }
+
+    void sizes(benchmark::internal::Benchmark* b)
+    {
+        b->ArgNames({"count", "spread"});
+        for (const std::int64_t count : {1 << 10, 1 << 14}) {
+            for (const std::int64_t spread : {1, 16, 256})
+                b->Args({count, spread});
+        }
+    }
+
+    template <typename Container, typename T, typename SizeT>
+    void register_container(const std::string& name)
+    {
+        benchmark::RegisterBenchmark(("insert/" + name).c_str(), insert<Container, T, SizeT>)->Apply(sizes);
+        benchmark::RegisterBenchmark(("erase/" + name).c_str(), erase<Container, T, SizeT>)->Apply(sizes);
+        benchmark::RegisterBenchmark(("lookup_hit/" + name).c_str(), lookup_hit<Container, T, SizeT>)->Apply(sizes);
+        benchmark::RegisterBenchmark(("lookup_miss/" + name).c_str(), lookup_miss<Container, T, SizeT>)->Apply(sizes);
+        benchmark::RegisterBenchmark(("iterate/" + name).c_str(), iterate<Container, T, SizeT>)->Apply(sizes);
+        benchmark::RegisterBenchmark(("compare/" + name).c_str(), compare<Container, T, SizeT>)->Apply(sizes);
+    }
+
+    template <typename T, typename SizeT>
+    void register_containers(const std::string& types)
+    {
+        register_container<sparse_vector_container<T, SizeT, 0>, T, SizeT>("sparse_vector<" + types + ">");
+        register_container<sparse_vector_container<T, SizeT, 4096>, T, SizeT>("sparse_vector_paged<" + types + ">");
+        register_container<sparse_vector_container<T, SizeT, ARo::BitmapIndex>, T, SizeT>("sparse_vector_bitmap<" + types + ">");
+        register_container<unordered_map_container<T, SizeT>, T, SizeT>("unordered_map<" + types + ">");
+        register_container<map_container<T, SizeT>, T, SizeT>("map<" + types + ">");
+        register_container<optional_vector_container<T, SizeT>, T, SizeT>("vector_optional<" + types + ">");
+    }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    register_containers<Payload<8>, std::uint32_t>("8B,uint32");
+    register_containers<Payload<8>, std::uint64_t>("8B,uint64");
+    register_containers<Payload<64>, std::uint32_t>("64B,uint32");
+    register_containers<Payload<64>, std::uint64_t>("64B,uint64");
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
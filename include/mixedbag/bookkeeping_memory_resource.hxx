@@ -1,23 +1,46 @@
 #pragma once
 
 #include <mixedbag/exports.h>
+#include <mixedbag/detail/allocation_registry.hxx>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
 #include <iostream>
 #include <memory_resource>
+#include <string>
+#include <unordered_map>
 
 namespace ARo {
 
 /**
  * A memory resource meant for tests, that can be queried for stats, checks deallocations that they match a live allocation, and asserts on leaks.
+ *
+ * Live allocations are kept in a hash table keyed by address, so allocating and deallocating take constant time on average, however many allocations
+ * are live. To detect double frees, the addresses of the most recent deallocations are remembered, up to a configurable number, so that the memory
+ * used for bookkeeping stays bounded over long runs. A double free of an address that has been forgotten is reported as a deallocation of memory
+ * that was not allocated by this resource.
+ *
+ * It also profiles the allocations: the peak and cumulative number of bytes allocated, the allocation rate, and histograms of the sizes and
+ * alignments. Optionally, the call site of each allocation can be captured (see set_capture_call_sites()), so that live allocations can be
+ * grouped by where they were made. write_profile() writes all of it as JSON.
  */
 class MIXEDBAG_EXPORT bookkeeping_memory_resource final : public std::pmr::memory_resource {
     public:
-    explicit bookkeeping_memory_resource(std::pmr::memory_resource* upstream)
+    static constexpr std::size_t DefaultFreedHistorySize = 65536;
+    static constexpr std::size_t HistogramSize = 64; // One bucket per power of two
+
+    /**
+     * @param upstream The resource to allocate from, which is also used for the bookkeeping
+     * @param freedHistorySize The number of deallocated addresses to remember for detecting double frees
+     */
+    explicit bookkeeping_memory_resource(std::pmr::memory_resource* upstream, std::size_t freedHistorySize = DefaultFreedHistorySize)
         : upstream_(upstream)
-        , liveAllocations_(upstream)
-        , deadAllocations_(upstream)
+        , allocations_(upstream, freedHistorySize)
+        , liveCallSites_(upstream)
+        , callSites_(upstream)
     {};
 
     bookkeeping_memory_resource() : bookkeeping_memory_resource(std::pmr::get_default_resource()) {}
@@ -32,12 +55,18 @@ class MIXEDBAG_EXPORT bookkeeping_memory_resource final : public std::pmr::memor
 
     [[nodiscard]] std::size_t get_num_live_allocations() const noexcept
     {
-        return liveAllocations_.size();
+        return allocations_.live_count();
     }
 
     [[nodiscard]] std::size_t get_num_deallocations() const noexcept
     {
-        return deadAllocations_.size();
+        return numDeallocations_;
+    }
+
+    /** Returns the number of deallocated addresses that are remembered for detecting double frees */
+    [[nodiscard]] std::size_t get_freed_history_size() const noexcept
+    {
+        return allocations_.freed_history_size();
     }
 
     [[nodiscard]] std::size_t get_num_live_allocated_bytes() const noexcept
@@ -47,29 +76,93 @@ class MIXEDBAG_EXPORT bookkeeping_memory_resource final : public std::pmr::memor
 
     [[nodiscard]] std::size_t is_unused() const noexcept
     {
-        return liveAllocations_.empty() && deadAllocations_.empty();
+        return allocations_.live_count() == 0 && numDeallocations_ == 0;
     }
 
     [[nodiscard]] std::size_t has_no_leak() const noexcept
     {
-        return liveAllocations_.empty();
+        return allocations_.live_count() == 0;
+    }
+
+    /** Returns the largest number of bytes that have been allocated at the same time */
+    [[nodiscard]] std::size_t get_peak_allocated_bytes() const noexcept
+    {
+        return peakAllocatedBytes_;
+    }
+
+    /** Returns the number of bytes allocated in total, including those that have since been deallocated */
+    [[nodiscard]] std::size_t get_total_allocated_bytes() const noexcept
+    {
+        return totalAllocatedBytes_;
+    }
+
+    /** Returns the number of allocations made in total, including those that have since been deallocated */
+    [[nodiscard]] std::size_t get_num_allocations() const noexcept
+    {
+        return numAllocations_;
     }
 
+    /** Returns the average number of allocations per second since the resource was created */
+    [[nodiscard]] double get_allocation_rate() const noexcept;
+
+    /**
+     * Returns the number of allocations made of each size class, where class k holds the sizes from 2^(k-1) + 1 up to 2^k bytes
+     * (and class zero holds sizes of zero and one byte)
+     */
+    [[nodiscard]] const std::array<std::size_t, HistogramSize>& get_size_histogram() const noexcept
+    {
+        return sizeHistogram_;
+    }
+
+    /** Returns the number of allocations made with each alignment, where entry k counts the alignment 2^k */
+    [[nodiscard]] const std::array<std::size_t, HistogramSize>& get_alignment_histogram() const noexcept
+    {
+        return alignmentHistogram_;
+    }
+
+    /** Returns true if the library was built with std::stacktrace (the CMake option MIXEDBAG_ENABLE_STACKTRACE), so that call sites can be captured */
+    [[nodiscard]] static bool can_capture_call_sites() noexcept;
+
+    /**
+     * Starts or stops capturing the call site of each allocation, which is slow, but lets print_live_allocations() and write_profile() tell where
+     * the allocations were made
+     *
+     * @throws std::runtime_error when enabling capture if can_capture_call_sites() is false
+     */
+    void set_capture_call_sites(bool capture);
+
+    /** Prints the live allocations, grouped by call site if call sites are captured */
     void print_live_allocations(std::ostream& outputStream) const;
 
-    private:
-    struct Allocation {
-        std::size_t byteCount;
-        std::size_t alignment;
-        void* address;
+    /** Writes the counters, the histograms, and the allocations per call site if call sites are captured, as a JSON object */
+    void write_profile(std::ostream& outputStream) const;
 
-        auto operator<=>(const Allocation&) const noexcept = default;
+    private:
+    struct CallSite {
+        std::string description;
+        std::size_t numAllocations = 0; // In total, including the ones that have been deallocated
+        std::size_t numAllocatedBytes = 0;
+        std::size_t numLiveAllocations = 0;
+        std::size_t numLiveAllocatedBytes = 0;
     };
 
+    void record_allocation(std::size_t byteCount, std::size_t alignment, CallSite* callSite) noexcept;
+    CallSite* capture_call_site(void* address);                           // Returns nullptr if call sites cannot be captured
+    void release_call_site(void* address, std::size_t byteCount) noexcept; // Updates the call site of a deallocated address
+
     std::pmr::memory_resource* upstream_;
-    std::pmr::vector<Allocation> liveAllocations_;
-    std::pmr::vector<Allocation> deadAllocations_;
+    detail::allocation_registry allocations_;
     std::size_t numAllocatedBytes_ = 0;
+    std::size_t numDeallocations_ = 0;
+    std::size_t peakAllocatedBytes_ = 0;
+    std::size_t totalAllocatedBytes_ = 0;
+    std::size_t numAllocations_ = 0;
+    std::chrono::steady_clock::time_point created_ = std::chrono::steady_clock::now();
+    std::array<std::size_t, HistogramSize> sizeHistogram_{};
+    std::array<std::size_t, HistogramSize> alignmentHistogram_{};
+    bool captureCallSites_ = false;
+    std::pmr::unordered_map<void*, std::size_t> liveCallSites_; // The call site of each live allocation that was captured, by hash
+    std::pmr::unordered_map<std::size_t, CallSite> callSites_; // The call sites seen, by the hash of their stack trace
 
     void* do_allocate(std::size_t byteCount, std::size_t alignment) override;
     void do_deallocate(void* address, std::size_t byteCount, std::size_t alignment) override;
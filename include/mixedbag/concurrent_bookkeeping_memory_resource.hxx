@@ -0,0 +1,117 @@
+#pragma once
+
+#include <mixedbag/exports.h>
+#include <mixedbag/detail/allocation_registry.hxx>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <memory_resource>
+#include <mutex>
+
+namespace ARo {
+
+/**
+ * A thread safe variant of bookkeeping_memory_resource, for checking for leaks and bad deallocations in multi-threaded code.
+ *
+ * It gives the same diagnostics: a deallocation that does not match a live allocation throws, and so does a double free of an address among the most
+ * recently deallocated ones, and a leak is fatal when the resource is destroyed. The allocations are tracked in a number of shards, chosen by a hash
+ * of the address, each with its own lock, so threads only contend when they happen to use the same shard at the same time. Each shard also keeps its
+ * own share of the freed history (see the constructor), so double frees are remembered per shard. The counters are atomic,
+ * and can be read at any time without locking.
+ *
+ * The upstream resource must be thread safe, such as the default new/delete resource or a std::pmr::synchronized_pool_resource. It is also used for
+ * the bookkeeping.
+ */
+class MIXEDBAG_EXPORT concurrent_bookkeeping_memory_resource final : public std::pmr::memory_resource {
+    public:
+    static constexpr std::size_t ShardCount = 64;
+    static constexpr std::size_t DefaultFreedHistorySize = 65536;
+
+    /**
+     * @param upstream The thread safe resource to allocate from, which is also used for the bookkeeping
+     * @param freedHistorySize The number of deallocated addresses to remember for detecting double frees. It is split evenly over the shards, rounded up
+     *                         to a multiple of ShardCount, and each shard only remembers the addresses that hash to it, so a double free is only detected if
+     *                         fewer than about freedHistorySize / ShardCount other addresses of the same shard were deallocated in between.
+     */
+    explicit concurrent_bookkeeping_memory_resource(std::pmr::memory_resource* upstream, std::size_t freedHistorySize = DefaultFreedHistorySize);
+
+    concurrent_bookkeeping_memory_resource() : concurrent_bookkeeping_memory_resource(std::pmr::get_default_resource()) {}
+
+    concurrent_bookkeeping_memory_resource(const concurrent_bookkeeping_memory_resource&) = delete;
+    concurrent_bookkeeping_memory_resource& operator=(const concurrent_bookkeeping_memory_resource&) = delete;
+
+    ~concurrent_bookkeeping_memory_resource() override
+    {
+        if (!has_no_leak()) {
+            std::cerr << "Leaking memory resource!\n";
+            std::terminate();
+        }
+    }
+
+    [[nodiscard]] std::size_t get_num_live_allocations() const noexcept
+    {
+        return numLiveAllocations_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::size_t get_num_deallocations() const noexcept
+    {
+        return numDeallocations_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the number of deallocated addresses that are remembered for detecting double frees, over all shards
+     *
+     * This is the size passed to the constructor rounded up to a multiple of ShardCount. Each shard remembers a ShardCount-th of it.
+     */
+    [[nodiscard]] std::size_t get_freed_history_size() const noexcept
+    {
+        return shards_.front().allocations.freed_history_size() * ShardCount;
+    }
+
+    [[nodiscard]] std::size_t get_num_live_allocated_bytes() const noexcept
+    {
+        return numAllocatedBytes_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool is_unused() const noexcept
+    {
+        return get_num_live_allocations() == 0 && get_num_deallocations() == 0;
+    }
+
+    [[nodiscard]] bool has_no_leak() const noexcept
+    {
+        return get_num_live_allocations() == 0;
+    }
+
+    /** Prints the live allocations, which is only consistent if no other thread allocates or deallocates meanwhile */
+    void print_live_allocations(std::ostream& outputStream) const;
+
+    private:
+    // Aligned to a cache line, so that threads using different shards do not share one
+    struct alignas(64) Shard {
+        Shard(std::pmr::memory_resource* upstream, std::size_t freedHistorySize)
+            : allocations(upstream, freedHistorySize)
+        {}
+
+        mutable std::mutex mutex;
+        detail::allocation_registry allocations;
+    };
+
+    [[nodiscard]] Shard& shard_of(const void* address) const noexcept;
+    void count_allocation(std::size_t byteCount) noexcept;   // Must be called with the lock of the allocation's shard held
+    void count_deallocation(std::size_t byteCount) noexcept; // Likewise
+
+    void* do_allocate(std::size_t byteCount, std::size_t alignment) override;
+    void do_deallocate(void* address, std::size_t byteCount, std::size_t alignment) override;
+    bool do_is_equal(const memory_resource& other) const noexcept override;
+
+    std::pmr::memory_resource* upstream_;
+    mutable std::array<Shard, ShardCount> shards_;
+    std::atomic<std::size_t> numLiveAllocations_ = 0;
+    std::atomic<std::size_t> numAllocatedBytes_ = 0;
+    std::atomic<std::size_t> numDeallocations_ = 0;
+};
+
+} // namespace ARo
@@ -0,0 +1,473 @@
+#pragma once
+
+#include <mixedbag/exports.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <ranges>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace ARo {
+
+    /**
+     * concurrent_sparse_vector is a variant of sparse_vector that allows any number of threads to insert and look up elements, while other threads iterate
+     * over them, without locks.
+     *
+     * The sparse index is split into pages that are allocated on first use and published with an atomic compare-and-swap. The values are stored in
+     * segments of doubling size, so that they never move once constructed, and each position in the dense storage is claimed with an atomic increment.
+     * An element becomes visible to lookups and iteration only once it is fully constructed.
+     *
+     * Threads that insert many elements should each use an appender, which claims positions in blocks, so the shared counter is only touched once per block.
+     *
+     * Elements can not be erased. The container is meant for building up a data set concurrently, and is not movable or copyable.
+     *
+     * @note The memory resource must be thread safe (such as std::pmr::synchronized_pool_resource or std::pmr::new_delete_resource()), since pages and
+     *       segments are allocated by whichever thread needs them first.
+     *
+     * @tparam T The type of elements to store
+     * @tparam SizeT The size type, which limits both the indices and the number of elements
+     * @tparam PageSize The number of entries in each page of the sparse index, which must be a power of two
+     */
+    template <typename T, typename SizeT = std::size_t, std::size_t PageSize = 4096>
+    class MIXEDBAG_EXPORT concurrent_sparse_vector final {
+        static_assert(std::has_single_bit(PageSize), "concurrent_sparse_vector: PageSize must be a power of two");
+
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+        using value_type = T;
+        using reference = T&;
+        using pointer = T*;
+        using size_type = SizeT;
+
+        template <bool WithIndex>
+        class basic_iterator;
+
+        using iterator = basic_iterator<false>;
+        using item_iterator = basic_iterator<true>;
+
+        class appender;
+
+    public:
+        /**
+         * Creates an empty container for indices below indexLimit
+         *
+         * The page table of the sparse index is allocated up front (one pointer per PageSize indices), since it can not be grown while other threads use it.
+         */
+        explicit concurrent_sparse_vector(size_type indexLimit, const allocator_type& allocator = {})
+            : indexLimit_(indexLimit)
+            , pages_((static_cast<std::size_t>(indexLimit) >> PageShift) + ((indexLimit & PageMask) != 0), allocator)
+        {}
+
+        concurrent_sparse_vector(const concurrent_sparse_vector&) = delete;
+        concurrent_sparse_vector& operator=(const concurrent_sparse_vector&) = delete;
+
+        ~concurrent_sparse_vector()
+        {
+            const auto claimed = claimed_.load(std::memory_order_acquire);
+            for (std::size_t segment = 0; segment < segments_.size(); ++segment) {
+                auto* block = segments_[segment].load(std::memory_order_acquire);
+                if (block == nullptr)
+                    continue;
+
+                const auto first = segment_start(segment);
+                const auto count = std::min(segment_size(segment), claimed > first ? claimed - first : 0);
+                for (std::size_t i = 0; i < count; ++i) {
+                    if (segment_indices(block)[i].load(std::memory_order_relaxed) != InvalidPos)
+                        std::destroy_at(segment_values(block, segment) + i);
+                }
+                get_allocator().deallocate_bytes(block, segment_bytes(segment), SegmentAlignment);
+            }
+
+            for (auto& page : pages_) {
+                if (auto* entries = page.load(std::memory_order_acquire))
+                    get_allocator().deallocate_object(entries, PageSize);
+            }
+        }
+
+        /** Returns the allocator in use */
+        allocator_type get_allocator() const
+        {
+            return pages_.get_allocator();
+        }
+
+        /** Returns the exclusive upper limit of the indices */
+        [[nodiscard]] size_type index_limit() const noexcept
+        {
+            return indexLimit_;
+        }
+
+        ///@{
+        /**
+         * Inserts an element at the specified index by constructing it in place, unless there already is one
+         *
+         * If several threads insert at the same index at the same time, exactly one of them succeeds.
+         *
+         * @returns a pointer to the element at the index, and true if it was inserted by this call
+         * @throws std::runtime_error if the index is out of range
+         */
+        template <typename... Args>
+        std::pair<pointer, bool> try_emplace(size_type index, Args&&... args)
+        {
+            auto& entry = acquire_entry(index);
+            if (const auto existing = entry.load(std::memory_order_acquire); existing != InvalidPos)
+                return {value_at(existing), false};
+
+            return emplace_at(claim(1), entry, index, std::forward<Args>(args)...);
+        }
+
+        std::pair<pointer, bool> insert(size_type index, const value_type& value)
+        {
+            return try_emplace(index, value);
+        }
+
+        std::pair<pointer, bool> insert(size_type index, value_type&& value)
+        {
+            return try_emplace(index, std::move(value));
+        }
+        ///@}
+
+        ///@{
+        /** Returns a pointer to the element at the specified index, or nullptr if there is none (or the index is out of range) */
+        [[nodiscard]] pointer find(size_type index) noexcept
+        {
+            const auto pos = find_pos(index);
+            return pos == InvalidPos ? nullptr : value_at(pos);
+        }
+
+        [[nodiscard]] const value_type* find(size_type index) const noexcept
+        {
+            const auto pos = find_pos(index);
+            return pos == InvalidPos ? nullptr : value_at(pos);
+        }
+
+        [[nodiscard]] bool contains(size_type index) const noexcept
+        {
+            return find_pos(index) != InvalidPos;
+        }
+        ///@}
+
+        /** Returns the number of elements that have been inserted so far */
+        [[nodiscard]] size_type size() const noexcept
+        {
+            return static_cast<size_type>(size_.load(std::memory_order_relaxed));
+        }
+
+        /** Check for emptiness */
+        [[nodiscard]] bool empty() const noexcept
+        {
+            return size() == 0;
+        }
+
+        ///@{
+        /**
+         * Iteration over the values, or over (index, value) pairs with items()
+         *
+         * Iteration can run concurrently with insertion. It visits every element that was inserted before begin() was called, and may or may not visit the
+         * elements inserted after that.
+         */
+        [[nodiscard]] iterator begin() noexcept
+        {
+            return iterator{this, 0, claimed_.load(std::memory_order_acquire)};
+        }
+
+        [[nodiscard]] std::default_sentinel_t end() const noexcept
+        {
+            return {};
+        }
+
+        [[nodiscard]] std::ranges::subrange<item_iterator, std::default_sentinel_t> items() noexcept
+        {
+            return {item_iterator{this, 0, claimed_.load(std::memory_order_acquire)}, std::default_sentinel};
+        }
+        ///@}
+
+    private:
+        static constexpr SizeT InvalidPos = ~(SizeT(0));
+        static constexpr std::size_t PageShift = std::countr_zero(PageSize);
+        static constexpr std::size_t PageMask = PageSize - 1;
+
+        // The dense storage is made up of segments, where segment k holds FirstSegmentSize << k elements
+        static constexpr std::size_t FirstSegmentSize = 64;
+        static constexpr std::size_t SegmentAlignment = std::max(alignof(T), alignof(std::atomic<SizeT>));
+
+        static constexpr std::size_t segment_of(std::size_t pos) noexcept
+        {
+            return static_cast<std::size_t>(std::bit_width(pos / FirstSegmentSize + 1)) - 1;
+        }
+
+        static constexpr std::size_t segment_start(std::size_t segment) noexcept
+        {
+            return FirstSegmentSize * ((std::size_t{1} << segment) - 1);
+        }
+
+        static constexpr std::size_t segment_size(std::size_t segment) noexcept
+        {
+            return FirstSegmentSize << segment;
+        }
+
+        // Each segment is a single block holding the index of each element, followed by the values
+        static constexpr std::size_t segment_values_offset(std::size_t segment) noexcept
+        {
+            return (segment_size(segment) * sizeof(std::atomic<SizeT>) + alignof(T) - 1) / alignof(T) * alignof(T);
+        }
+
+        static constexpr std::size_t segment_bytes(std::size_t segment) noexcept
+        {
+            return segment_values_offset(segment) + segment_size(segment) * sizeof(T);
+        }
+
+        static std::atomic<SizeT>* segment_indices(void* block) noexcept
+        {
+            return static_cast<std::atomic<SizeT>*>(block);
+        }
+
+        static T* segment_values(void* block, std::size_t segment) noexcept
+        {
+            return reinterpret_cast<T*>(static_cast<std::byte*>(block) + segment_values_offset(segment));
+        }
+
+        // Claims count consecutive positions in the dense storage
+        std::size_t claim(std::size_t count)
+        {
+            const auto first = claimed_.fetch_add(count, std::memory_order_relaxed);
+            if (first + count >= InvalidPos || segment_of(first + count) >= segments_.size())
+                throw std::runtime_error("concurrent_sparse_vector: insert - too many elements");
+            return first;
+        }
+
+        // Returns the block of the segment, allocating and publishing it if no other thread has done so
+        void* acquire_segment(std::size_t segment)
+        {
+            auto* block = segments_[segment].load(std::memory_order_acquire);
+            if (block != nullptr)
+                return block;
+
+            auto* newBlock = get_allocator().allocate_bytes(segment_bytes(segment), SegmentAlignment);
+            for (std::size_t i = 0; i < segment_size(segment); ++i)
+                std::construct_at(segment_indices(newBlock) + i, InvalidPos);
+
+            if (segments_[segment].compare_exchange_strong(block, newBlock, std::memory_order_acq_rel, std::memory_order_acquire))
+                return newBlock;
+
+            get_allocator().deallocate_bytes(newBlock, segment_bytes(segment), SegmentAlignment);
+            return block;
+        }
+
+        // Returns the sparse index entry for the index, allocating and publishing its page if no other thread has done so
+        std::atomic<SizeT>& acquire_entry(size_type index)
+        {
+            if (index >= indexLimit_)
+                throw std::runtime_error("concurrent_sparse_vector: insert - index out of range");
+
+            auto& page = pages_[static_cast<std::size_t>(index) >> PageShift];
+            auto* entries = page.load(std::memory_order_acquire);
+            if (entries == nullptr) {
+                auto* newEntries = get_allocator().template allocate_object<std::atomic<SizeT>>(PageSize);
+                for (std::size_t i = 0; i < PageSize; ++i)
+                    std::construct_at(newEntries + i, InvalidPos);
+
+                if (page.compare_exchange_strong(entries, newEntries, std::memory_order_acq_rel, std::memory_order_acquire))
+                    entries = newEntries;
+                else
+                    get_allocator().deallocate_object(newEntries, PageSize);
+            }
+            return entries[index & PageMask];
+        }
+
+        // Constructs the element at a claimed position and publishes it, unless another thread got there first.
+        // The position is left unused if the element is not inserted.
+        template <typename... Args>
+        std::pair<pointer, bool> emplace_at(std::size_t pos, std::atomic<SizeT>& entry, size_type index, Args&&... args)
+        {
+            const auto segment = segment_of(pos);
+            auto* block = acquire_segment(segment);
+            const auto offset = pos - segment_start(segment);
+
+            auto* value = std::construct_at(segment_values(block, segment) + offset, std::forward<Args>(args)...);
+
+            auto expected = InvalidPos;
+            if (!entry.compare_exchange_strong(expected, static_cast<SizeT>(pos), std::memory_order_acq_rel, std::memory_order_acquire)) {
+                std::destroy_at(value);
+                return {value_at(expected), false};
+            }
+
+            segment_indices(block)[offset].store(index, std::memory_order_release);
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return {value, true};
+        }
+
+        [[nodiscard]] SizeT find_pos(size_type index) const noexcept
+        {
+            if (index >= indexLimit_)
+                return InvalidPos;
+
+            const auto* entries = pages_[static_cast<std::size_t>(index) >> PageShift].load(std::memory_order_acquire);
+            return entries == nullptr ? InvalidPos : entries[index & PageMask].load(std::memory_order_acquire);
+        }
+
+        // The position must be published, which means that its segment is too
+        [[nodiscard]] pointer value_at(std::size_t pos) const noexcept
+        {
+            const auto segment = segment_of(pos);
+            return segment_values(segments_[segment].load(std::memory_order_acquire), segment) + (pos - segment_start(segment));
+        }
+
+        size_type indexLimit_;
+        std::pmr::vector<std::atomic<std::atomic<SizeT>*>> pages_;
+        std::array<std::atomic<void*>, std::numeric_limits<std::size_t>::digits - std::bit_width(FirstSegmentSize) + 1> segments_{};
+        std::atomic<std::size_t> claimed_{0}; // Number of positions claimed in the dense storage, including ones that are not (yet) used
+        std::atomic<std::size_t> size_{0};
+    };
+
+    /**
+     * Forward iterator over the elements of a concurrent_sparse_vector, which skips positions that have been claimed but not (yet) filled
+     */
+    template <typename T, typename SizeT, std::size_t PageSize>
+    template <bool WithIndex>
+    class concurrent_sparse_vector<T, SizeT, PageSize>::basic_iterator {
+    public:
+        using iterator_concept = std::forward_iterator_tag;
+        using iterator_category = std::conditional_t<WithIndex, std::input_iterator_tag, std::forward_iterator_tag>;
+        using value_type = std::conditional_t<WithIndex, std::pair<SizeT, T&>, T>;
+        using reference = std::conditional_t<WithIndex, std::pair<SizeT, T&>, T&>;
+        using difference_type = std::ptrdiff_t;
+
+        basic_iterator() noexcept = default;
+
+        [[nodiscard]] reference operator*() const noexcept
+        {
+            if constexpr (WithIndex)
+                return {index_, *value_};
+            else
+                return *value_;
+        }
+
+        basic_iterator& operator++() noexcept
+        {
+            ++pos_;
+            skip_unused();
+            return *this;
+        }
+
+        basic_iterator operator++(int) noexcept
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+
+        [[nodiscard]] friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) noexcept
+        {
+            return lhs.pos_ == rhs.pos_;
+        }
+
+        [[nodiscard]] friend bool operator==(const basic_iterator& it, std::default_sentinel_t) noexcept
+        {
+            return it.pos_ == it.end_;
+        }
+
+    private:
+        friend class concurrent_sparse_vector;
+
+        basic_iterator(concurrent_sparse_vector* vector, std::size_t pos, std::size_t end) noexcept
+            : vector_(vector)
+            , pos_(pos)
+            , end_(end)
+        {
+            skip_unused();
+        }
+
+        // Advances to the next position holding a published element, or to the end
+        void skip_unused() noexcept
+        {
+            while (pos_ < end_) {
+                const auto segment = segment_of(pos_);
+                auto* block = vector_->segments_[segment].load(std::memory_order_acquire);
+                if (block == nullptr) {
+                    pos_ = std::min(end_, segment_start(segment + 1));
+                    continue;
+                }
+
+                const auto offset = pos_ - segment_start(segment);
+                index_ = segment_indices(block)[offset].load(std::memory_order_acquire);
+                if (index_ != InvalidPos) {
+                    value_ = segment_values(block, segment) + offset;
+                    return;
+                }
+                ++pos_;
+            }
+        }
+
+        concurrent_sparse_vector* vector_ = nullptr;
+        std::size_t pos_ = 0;
+        std::size_t end_ = 0;
+        SizeT index_ = InvalidPos;
+        T* value_ = nullptr;
+    };
+
+    /**
+     * Inserts elements into a concurrent_sparse_vector from a single thread, claiming positions in the dense storage a block at a time
+     *
+     * Each inserting thread should use its own appender. Positions that are left unused when the appender is destroyed are skipped by iteration.
+     */
+    template <typename T, typename SizeT, std::size_t PageSize>
+    class concurrent_sparse_vector<T, SizeT, PageSize>::appender final {
+    public:
+        explicit appender(concurrent_sparse_vector& vector, std::size_t blockSize = 64)
+            : vector_(&vector)
+            , blockSize_(blockSize == 0 ? 1 : blockSize)
+        {}
+
+        appender(const appender&) = delete;
+        appender& operator=(const appender&) = delete;
+        appender(appender&&) noexcept = default;
+        appender& operator=(appender&&) noexcept = default;
+        ~appender() = default;
+
+        /** Same as concurrent_sparse_vector::try_emplace, but uses the next position of the block claimed by this appender */
+        template <typename... Args>
+        std::pair<pointer, bool> try_emplace(size_type index, Args&&... args)
+        {
+            auto& entry = vector_->acquire_entry(index);
+            if (const auto existing = entry.load(std::memory_order_acquire); existing != InvalidPos)
+                return {vector_->value_at(existing), false};
+
+            if (next_ == end_) {
+                next_ = vector_->claim(blockSize_);
+                end_ = next_ + blockSize_;
+            }
+
+            // A position is only used up if the element was inserted
+            auto result = vector_->emplace_at(next_, entry, index, std::forward<Args>(args)...);
+            if (result.second)
+                ++next_;
+            return result;
+        }
+
+        std::pair<pointer, bool> insert(size_type index, const value_type& value)
+        {
+            return try_emplace(index, value);
+        }
+
+        std::pair<pointer, bool> insert(size_type index, value_type&& value)
+        {
+            return try_emplace(index, std::move(value));
+        }
+
+    private:
+        concurrent_sparse_vector* vector_;
+        std::size_t blockSize_;
+        std::size_t next_ = 0; // Next unused position of the claimed block
+        std::size_t end_ = 0;
+    };
+
+} // namespace ARo
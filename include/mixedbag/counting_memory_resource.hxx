@@ -0,0 +1,107 @@
+#pragma once
+
+#include <mixedbag/exports.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace ARo {
+
+/**
+ * A memory resource that counts the allocations passed to its upstream resource, cheap enough to wrap every resource in production.
+ *
+ * Unlike bookkeeping_memory_resource, it keeps nothing per allocation, so it cannot check deallocations or report leaks, and it never terminates.
+ * The counters are spread over a number of slots, each on its own cache line. When a thread first uses any counting_memory_resource, it takes a
+ * slot number that it owns until it exits, when the number is handed back for reuse by later threads. As each slot has a single writer, the
+ * allocation path updates it with plain atomic loads and stores, without locks or read-modify-write instructions. Threads beyond SlotCount running
+ * at the same time share an extra slot, which they update with atomic read-modify-writes instead. snapshot() adds up the slots on demand, and can
+ * be called from any thread at any time, for instance to export metrics.
+ *
+ * The peak number of live bytes can not be derived from the per thread counts, so each slot also keeps the number of bytes allocated minus
+ * deallocated since it last published them, and publishes that to a shared total once it reaches peakGranularity bytes either way. The peak is
+ * taken of that total, so it is exact with a granularity of one byte, and otherwise may be off by up to peakGranularity bytes per slot in use.
+ * snapshot() reports at least the live bytes it counted, so the peak is never below them.
+ *
+ * The upstream resource must be thread safe if the counting resource is used by more than one thread.
+ */
+class MIXEDBAG_EXPORT counting_memory_resource final : public std::pmr::memory_resource {
+    public:
+    static constexpr std::size_t SlotCount = 64;
+    static constexpr std::size_t DefaultPeakGranularity = 64 * 1024;
+
+    /** The sum of the counters of all threads, at the time snapshot() was called */
+    struct counters {
+        std::size_t numAllocations = 0;
+        std::size_t numDeallocations = 0;
+        std::size_t numAllocatedBytes = 0;   // In total, including the ones that have since been deallocated
+        std::size_t numDeallocatedBytes = 0;
+        std::size_t numFailures = 0;         // Allocations for which the upstream resource threw
+        std::size_t peakAllocatedBytes = 0;  // The largest number of bytes that were allocated at the same time, within the peak granularity
+
+        [[nodiscard]] std::size_t live_allocations() const noexcept
+        {
+            return numAllocations - numDeallocations;
+        }
+
+        [[nodiscard]] std::size_t live_bytes() const noexcept
+        {
+            return numAllocatedBytes - numDeallocatedBytes;
+        }
+    };
+
+    /**
+     * @param upstream The resource to allocate from
+     * @param peakGranularity The number of bytes that a thread allocates or deallocates before it publishes them for tracking the peak
+     */
+    explicit counting_memory_resource(std::pmr::memory_resource* upstream, std::size_t peakGranularity = DefaultPeakGranularity)
+        : upstream_(upstream)
+        , peakGranularity_(static_cast<std::int64_t>(peakGranularity))
+    {}
+
+    counting_memory_resource() : counting_memory_resource(std::pmr::get_default_resource()) {}
+
+    counting_memory_resource(const counting_memory_resource&) = delete;
+    counting_memory_resource& operator=(const counting_memory_resource&) = delete;
+
+    /** Returns the counters summed over all threads. The sums are not taken atomically, so allocations made meanwhile may be counted in part */
+    [[nodiscard]] counters snapshot() const noexcept;
+
+    /** Returns the number of slots that are not owned by a running thread, which are shared by all counting_memory_resources */
+    [[nodiscard]] static std::size_t get_num_free_slots() noexcept;
+
+    [[nodiscard]] std::pmr::memory_resource* upstream_resource() const noexcept
+    {
+        return upstream_;
+    }
+
+    private:
+    // Aligned to a cache line, so that threads using different slots do not share one
+    struct alignas(64) Slot {
+        std::atomic<std::size_t> numAllocations = 0;
+        std::atomic<std::size_t> numDeallocations = 0;
+        std::atomic<std::size_t> numAllocatedBytes = 0;
+        std::atomic<std::size_t> numDeallocatedBytes = 0;
+        std::atomic<std::size_t> numFailures = 0;
+        std::atomic<std::int64_t> unpublishedBytes = 0; // Bytes allocated minus deallocated, not yet added to liveBytes_
+    };
+
+    static constexpr std::size_t SharedSlot = SlotCount; // The slot of the threads that could not get one of their own
+
+    [[nodiscard]] static std::size_t current_slot() noexcept;
+    void publish(Slot& slot, bool shared, std::int64_t byteDelta) noexcept;
+
+    void* do_allocate(std::size_t byteCount, std::size_t alignment) override;
+    void do_deallocate(void* address, std::size_t byteCount, std::size_t alignment) override;
+    bool do_is_equal(const memory_resource& other) const noexcept override;
+
+    std::pmr::memory_resource* upstream_;
+    std::int64_t peakGranularity_;
+    std::array<Slot, SlotCount + 1> slots_; // One per slot number, and the shared slot
+    alignas(64) std::atomic<std::int64_t> liveBytes_ = 0; // The bytes published by all slots
+    std::atomic<std::size_t> peakAllocatedBytes_ = 0;
+};
+
+} // namespace ARo
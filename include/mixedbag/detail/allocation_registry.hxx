@@ -0,0 +1,75 @@
+#pragma once
+
+#include <mixedbag/exports.h>
+
+#include <cstddef>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+namespace ARo::detail {
+
+    /**
+     * The live allocations of a bookkeeping memory resource, and the most recently deallocated addresses, for detecting double frees.
+     *
+     * Live allocations are kept in a hash table keyed by address, so adding and removing them take constant time on average. The deallocated
+     * addresses are kept in a ring buffer of a fixed size, with a count per address for looking them up, so that the memory used stays bounded.
+     * This class is not thread safe.
+     */
+    class MIXEDBAG_EXPORT allocation_registry final {
+    public:
+        struct allocation {
+            std::size_t byteCount;
+            std::size_t alignment;
+            void* address;
+        };
+
+        /**
+         * @param resource The resource to allocate the bookkeeping from
+         * @param freedHistorySize The number of deallocated addresses to remember
+         */
+        allocation_registry(std::pmr::memory_resource* resource, std::size_t freedHistorySize);
+
+        /**
+         * Records a new allocation
+         *
+         * @throws std::runtime_error if there already is a live allocation at the address, which means that the upstream resource handed it out twice, or
+         *         that it was deallocated without going through the bookkeeping resource
+         */
+        void add(const allocation& newAllocation);
+
+        /** Removes the record of an allocation that was just added, without remembering it as deallocated, for when the allocation fails after all */
+        void discard(void* address) noexcept;
+
+        /**
+         * Removes the record of a live allocation, after checking that it is deallocated with the size and alignment it was allocated with
+         *
+         * @throws std::runtime_error if the address is not that of a live allocation, the size or alignment does not match, or it is a double free
+         */
+        void remove(const allocation& deallocation);
+
+        [[nodiscard]] std::size_t live_count() const noexcept
+        {
+            return live_.size();
+        }
+
+        /** Returns the number of deallocated addresses that are remembered */
+        [[nodiscard]] std::size_t freed_history_size() const noexcept
+        {
+            return freedHistorySize_;
+        }
+
+        /** Appends the live allocations to allocations, in no particular order */
+        void collect_live(std::vector<allocation>& allocations) const;
+
+    private:
+        void remember_freed(void* address);
+
+        std::pmr::unordered_map<void*, allocation> live_;
+        std::pmr::vector<void*> freedHistory_;                    // The most recently deallocated addresses, as a ring buffer
+        std::pmr::unordered_map<void*, std::size_t> freedCounts_; // The number of times each address occurs in freedHistory_
+        std::size_t freedHistorySize_;
+        std::size_t freedHistoryNext_ = 0; // The slot of freedHistory_ to overwrite next, once it is full
+    };
+
+} // namespace ARo::detail
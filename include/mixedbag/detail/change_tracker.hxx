@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace ARo::detail {
+
+    /** An entry in a change log: the index that was changed or erased, and the epoch in which it happened */
+    template <typename SizeT>
+    struct change_entry final {
+        SizeT index;
+        std::uint64_t epoch;
+    };
+
+    /**
+     * Records the changes to a sparse_vector, for sending them incrementally (see sparse_vector's TrackChanges).
+     *
+     * Every change is logged with the current epoch, and each entry in the log of changed indices has a sequence number, counting all entries ever logged.
+     * There is one stamp per position in the dense storage, holding the sequence number of the last entry for that element, so that each element has at most
+     * one entry per epoch, and only its last entry matches its stamp. An index that is erased and inserted again in the same epoch thus has an entry for each
+     * element, but only the one for the current element is live. There is also a log of erased indices. Mutable access to all elements at once is recorded by
+     * a single epoch, instead of as a change to each element.
+     *
+     * The hooks are called by the sparse_vector as its dense storage changes, and must keep the stamps in step with it.
+     * When tracking is disabled, the tracker is empty and all its hooks do nothing.
+     */
+    template <typename SizeT, bool Enabled>
+    class change_tracker;
+
+    template <typename SizeT>
+    class change_tracker<SizeT, false> final {
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        change_tracker() noexcept = default;
+        explicit change_tracker(const allocator_type& /*allocator*/) noexcept {}
+        change_tracker(const change_tracker& /*other*/, const allocator_type& /*allocator*/) noexcept {}
+        change_tracker(change_tracker&& /*other*/, const allocator_type& /*allocator*/) noexcept {}
+
+        void on_insert(SizeT /*index*/) noexcept {}
+        void on_change(std::size_t /*pos*/, SizeT /*index*/) noexcept {}
+        void on_change_all() noexcept {}
+        void on_erase(SizeT /*index*/) noexcept {}
+        void on_swap_remove(std::size_t /*pos*/) noexcept {}
+        void on_relocate(std::size_t /*from*/, std::size_t /*to*/) noexcept {}
+        void on_truncate(std::size_t /*count*/) noexcept {}
+        void on_load(std::size_t /*count*/) noexcept {}
+
+        [[nodiscard]] std::uint64_t stamp(std::size_t /*pos*/) const noexcept
+        {
+            return 0;
+        }
+
+        void set_stamp(std::size_t /*pos*/, std::uint64_t /*stamp*/) noexcept {}
+
+        [[nodiscard]] std::size_t allocated_bytes() const noexcept
+        {
+            return 0;
+        }
+
+        void shrink_to_fit() noexcept {}
+    };
+
+    template <typename SizeT>
+    class change_tracker<SizeT, true> final {
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+        using entry = change_entry<SizeT>;
+
+        change_tracker() noexcept = default;
+
+        explicit change_tracker(const allocator_type& allocator)
+            : stamps_(allocator)
+            , changed_(allocator)
+            , erased_(allocator)
+        {}
+
+        change_tracker(const change_tracker& other, const allocator_type& allocator)
+            : epoch_(other.epoch_)
+            , allChanged_(other.allChanged_)
+            , logBase_(other.logBase_)
+            , epochStart_(other.epochStart_)
+            , stamps_(other.stamps_, allocator)
+            , changed_(other.changed_, allocator)
+            , erased_(other.erased_, allocator)
+        {}
+
+        change_tracker(change_tracker&& other, const allocator_type& allocator)
+            : epoch_(other.epoch_)
+            , allChanged_(other.allChanged_)
+            , logBase_(other.logBase_)
+            , epochStart_(other.epochStart_)
+            , stamps_(std::move(other.stamps_), allocator)
+            , changed_(std::move(other.changed_), allocator)
+            , erased_(std::move(other.erased_), allocator)
+        {}
+
+        [[nodiscard]] std::uint64_t epoch() const noexcept
+        {
+            return epoch_;
+        }
+
+        std::uint64_t next_epoch() noexcept
+        {
+            epochStart_ = next_sequence();
+            return epoch_++;
+        }
+
+        /** Returns the last epoch in which all elements were accessed mutably, or zero */
+        [[nodiscard]] std::uint64_t all_changed() const noexcept
+        {
+            return allChanged_;
+        }
+
+        /** Returns the change log entries of epochs after the specified one */
+        [[nodiscard]] std::span<const entry> changed_since(std::uint64_t epoch) const noexcept
+        {
+            return since(changed_, epoch);
+        }
+
+        /** Returns the erase log entries of epochs after the specified one */
+        [[nodiscard]] std::span<const entry> erased_since(std::uint64_t epoch) const noexcept
+        {
+            return since(erased_, epoch);
+        }
+
+        /** Returns true if the entry, which must be in the change log, is the last one for the element at pos */
+        [[nodiscard]] bool is_live(const entry* logEntry, std::size_t pos) const noexcept
+        {
+            return stamps_[pos] == logBase_ + static_cast<std::uint64_t>(logEntry - changed_.data());
+        }
+
+        /** Drops the log entries of the specified epoch and earlier */
+        void discard(std::uint64_t epoch)
+        {
+            const auto discarded = changed_.size() - changed_since(epoch).size();
+            changed_.erase(changed_.begin(), changed_.begin() + static_cast<std::ptrdiff_t>(discarded));
+            logBase_ += discarded;
+            erased_.erase(erased_.begin(), erased_.begin() + static_cast<std::ptrdiff_t>(erased_.size() - erased_since(epoch).size()));
+        }
+
+        // Called after a new element has been added at the end of the dense storage. If it fails, nothing is recorded.
+        void on_insert(SizeT index)
+        {
+            const auto sequence = next_sequence();
+            changed_.push_back({index, epoch_});
+            try {
+                stamps_.push_back(sequence);
+            } catch (...) {
+                changed_.pop_back();
+                throw;
+            }
+        }
+
+        void on_change(std::size_t pos, SizeT index)
+        {
+            // Stamps from before the current epoch are lower than its first sequence number
+            if (stamps_[pos] < epochStart_) {
+                const auto sequence = next_sequence();
+                changed_.push_back({index, epoch_});
+                stamps_[pos] = sequence;
+            }
+        }
+
+        void on_change_all() noexcept
+        {
+            allChanged_ = epoch_;
+        }
+
+        void on_erase(SizeT index)
+        {
+            erased_.push_back({index, epoch_});
+        }
+
+        // Called when the element at pos is replaced by the last one, which is removed
+        void on_swap_remove(std::size_t pos) noexcept
+        {
+            stamps_[pos] = stamps_.back();
+            stamps_.pop_back();
+        }
+
+        void on_relocate(std::size_t from, std::size_t to) noexcept
+        {
+            stamps_[to] = stamps_[from];
+        }
+
+        void on_truncate(std::size_t count)
+        {
+            stamps_.resize(count);
+        }
+
+        // Called when the dense storage has been replaced by count new elements, which have no log entries
+        void on_load(std::size_t count)
+        {
+            stamps_.assign(count, NoEntry);
+            allChanged_ = epoch_;
+        }
+
+        [[nodiscard]] std::uint64_t stamp(std::size_t pos) const noexcept
+        {
+            return stamps_[pos];
+        }
+
+        void set_stamp(std::size_t pos, std::uint64_t stamp) noexcept
+        {
+            stamps_[pos] = stamp;
+        }
+
+        [[nodiscard]] std::size_t allocated_bytes() const noexcept
+        {
+            return stamps_.capacity() * sizeof(std::uint64_t) + (changed_.capacity() + erased_.capacity()) * sizeof(entry);
+        }
+
+        void shrink_to_fit()
+        {
+            stamps_.shrink_to_fit();
+            changed_.shrink_to_fit();
+            erased_.shrink_to_fit();
+        }
+
+    private:
+        static constexpr std::uint64_t NoEntry = 0; // Stamp of an element that has no log entry, below all sequence numbers
+
+        [[nodiscard]] std::uint64_t next_sequence() const noexcept
+        {
+            return logBase_ + changed_.size();
+        }
+
+        // The logs are in epoch order, so the entries after an epoch are found by binary search
+        static std::span<const entry> since(const std::pmr::vector<entry>& log, std::uint64_t epoch) noexcept
+        {
+            const auto first = std::ranges::upper_bound(log, epoch, {}, &entry::epoch);
+            return {first, log.end()};
+        }
+
+        std::uint64_t epoch_ = 1;      // Epoch of changes made now, starting after zero so that every change is after epoch zero
+        std::uint64_t allChanged_ = 0; // Last epoch in which all elements were accessed mutably
+        std::uint64_t logBase_ = 1;    // Sequence number of the first entry in changed_, starting after NoEntry
+        std::uint64_t epochStart_ = 1; // Sequence number of the first entry of the current epoch
+        std::pmr::vector<std::uint64_t> stamps_; // Sequence number of the last change log entry of the element at each position, or NoEntry
+        std::pmr::vector<entry> changed_;        // Log of changed and inserted indices
+        std::pmr::vector<entry> erased_;         // Log of erased indices
+    };
+
+} // namespace ARo::detail
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace ARo::detail {
+
+    /**
+     * The cached content hash of a sparse_vector (see sparse_vector's CacheHash), or zero if there is none, in which case a hash that happens to be zero
+     * is computed on each call.
+     *
+     * It is written by const member functions, so it is atomic, and it is discarded when moved from, since the moved from sparse_vector is left empty.
+     * When caching is disabled, the cache is empty and never holds a hash.
+     */
+    template <bool Enabled>
+    class hash_cache;
+
+    template <>
+    class hash_cache<false> final {
+    public:
+        [[nodiscard]] static constexpr std::size_t get() noexcept
+        {
+            return 0;
+        }
+
+        static constexpr void set(std::size_t /*hash*/) noexcept {}
+        static constexpr void reset() noexcept {}
+    };
+
+    template <>
+    class hash_cache<true> final {
+    public:
+        hash_cache() noexcept = default;
+
+        hash_cache(const hash_cache& other) noexcept
+            : value_(other.get())
+        {}
+
+        hash_cache(hash_cache&& other) noexcept
+            : value_(other.get())
+        {
+            other.reset();
+        }
+
+        hash_cache& operator=(const hash_cache& other) noexcept
+        {
+            set(other.get());
+            return *this;
+        }
+
+        hash_cache& operator=(hash_cache&& other) noexcept
+        {
+            set(other.get());
+            other.reset();
+            return *this;
+        }
+
+        [[nodiscard]] std::size_t get() const noexcept
+        {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+        void set(std::size_t hash) noexcept
+        {
+            value_.store(hash, std::memory_order_relaxed);
+        }
+
+        void reset() noexcept
+        {
+            set(0);
+        }
+
+    private:
+        std::atomic<std::size_t> value_ = 0;
+    };
+
+} // namespace ARo::detail
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+namespace ARo::detail {
+
+    /**
+     * Random access iterator over two parallel arrays holding indices and values, that yields (index, value reference) pairs.
+     */
+    template <typename SizeT, typename V>
+    class item_iterator final {
+    public:
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::input_iterator_tag; // The reference type is a proxy
+        using value_type = std::pair<SizeT, V&>;
+        using reference = std::pair<SizeT, V&>;
+        using difference_type = std::ptrdiff_t;
+
+        item_iterator() noexcept = default;
+
+        constexpr item_iterator(const SizeT* index, V* value) noexcept
+            : index_(index)
+            , value_(value)
+        {}
+
+        /** Conversion from a mutable to a const iterator */
+        template <typename U>
+            requires std::is_same_v<V, const U>
+        constexpr item_iterator(const item_iterator<SizeT, U>& other) noexcept // NOLINT: Implicit conversion intended
+            : index_(other.index_)
+            , value_(other.value_)
+        {}
+
+        [[nodiscard]] constexpr reference operator*() const noexcept
+        {
+            return {*index_, *value_};
+        }
+
+        [[nodiscard]] constexpr reference operator[](difference_type n) const noexcept
+        {
+            return {index_[n], value_[n]};
+        }
+
+        constexpr item_iterator& operator++() noexcept
+        {
+            ++index_;
+            ++value_;
+            return *this;
+        }
+
+        constexpr item_iterator operator++(int) noexcept
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+
+        constexpr item_iterator& operator--() noexcept
+        {
+            --index_;
+            --value_;
+            return *this;
+        }
+
+        constexpr item_iterator operator--(int) noexcept
+        {
+            auto result = *this;
+            --*this;
+            return result;
+        }
+
+        constexpr item_iterator& operator+=(difference_type n) noexcept
+        {
+            index_ += n;
+            value_ += n;
+            return *this;
+        }
+
+        constexpr item_iterator& operator-=(difference_type n) noexcept
+        {
+            return *this += -n;
+        }
+
+        [[nodiscard]] friend constexpr item_iterator operator+(item_iterator it, difference_type n) noexcept
+        {
+            return it += n;
+        }
+
+        [[nodiscard]] friend constexpr item_iterator operator+(difference_type n, item_iterator it) noexcept
+        {
+            return it += n;
+        }
+
+        [[nodiscard]] friend constexpr item_iterator operator-(item_iterator it, difference_type n) noexcept
+        {
+            return it -= n;
+        }
+
+        [[nodiscard]] friend constexpr difference_type operator-(const item_iterator& lhs, const item_iterator& rhs) noexcept
+        {
+            return lhs.value_ - rhs.value_;
+        }
+
+        [[nodiscard]] friend constexpr bool operator==(const item_iterator& lhs, const item_iterator& rhs) noexcept
+        {
+            return lhs.value_ == rhs.value_;
+        }
+
+        [[nodiscard]] friend constexpr auto operator<=>(const item_iterator& lhs, const item_iterator& rhs) noexcept
+        {
+            return lhs.value_ <=> rhs.value_;
+        }
+
+    private:
+        template <typename, typename>
+        friend class item_iterator;
+
+        const SizeT* index_ = nullptr;
+        V* value_ = nullptr;
+    };
+
+} // namespace ARo::detail
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ARo::detail {
+
+    /**
+     * The header of a binary snapshot of a sparse_vector, as written by sparse_vector::write_snapshot()
+     *
+     * A snapshot is laid out as follows, with all numbers in the byte order of the machine that wrote it:
+     *
+     * | Offset              | Contents                                                                                      |
+     * |---------------------|-----------------------------------------------------------------------------------------------|
+     * | 0                   | This header (48 bytes), followed by zero padding up to offset 64                              |
+     * | 64                  | The lookup, to find the position of the element at an index, in one of two forms (see below)  |
+     * | next multiple of 64 | The indices: count values of the size type, holding the index of the element at each position |
+     * | next multiple of 64 | The values: count values of the element type, as their object representation                  |
+     *
+     * The lookup is dense if the extent is at most snapshot_layout::DenseFactor times the number of elements: extent values of the size type, one per index,
+     * holding the position of the element at that index, or all bits set if there is none. Otherwise it is sorted, so that the size of a snapshot follows the
+     * number of elements however far apart their indices are: count values of the size type holding the indices in ascending order, followed by count values
+     * holding the position of the element at each of them.
+     *
+     * Padding between the arrays is zero. The arrays start at multiples of 64 bytes, so a snapshot that is itself aligned to 64 bytes (such as a memory mapped file)
+     * can be used in place, see sparse_vector_view.
+     *
+     * Generation counters (see sparse_vector's GenerationBits) are not part of a snapshot.
+     */
+    struct snapshot_header final {
+        static constexpr std::array<char, 8> Magic{'A', 'R', 'o', 'S', 'P', 'V', 'E', 'C'};
+        static constexpr std::uint32_t CurrentVersion = 1;
+        static constexpr std::uint32_t ByteOrderMark = 0x01020304;
+        static constexpr std::uint32_t DenseLookup = 0;
+        static constexpr std::uint32_t SortedLookup = 1;
+
+        std::array<char, 8> magic = Magic;
+        std::uint32_t version = CurrentVersion;
+        std::uint32_t byteOrder = ByteOrderMark; // Reads differently on a machine with another byte order
+        std::uint32_t sizeTypeSize = 0;          // sizeof the size type
+        std::uint32_t valueSize = 0;             // sizeof the element type
+        std::uint32_t valueAlignment = 0;        // alignof the element type
+        std::uint32_t lookup = DenseLookup;      // The form of the lookup
+        std::uint64_t extent = 0; // One past the largest index that the sparse_vector could look up
+        std::uint64_t count = 0;  // Number of elements
+    };
+
+    static_assert(sizeof(snapshot_header) == 48 && std::is_trivially_copyable_v<snapshot_header>);
+
+    /** Byte offsets of the parts of a snapshot */
+    struct snapshot_layout final {
+        static constexpr std::size_t Alignment = 64;
+        static constexpr std::size_t DenseFactor = 8; // The lookup is dense if the extent is at most this many times the number of elements
+
+        bool sorted = false; // Whether the lookup is sorted rather than dense
+        std::size_t lookup = 0;
+        std::size_t index = 0;
+        std::size_t data = 0;
+        std::size_t size = 0; // Total size of the snapshot
+
+        /** Returns the layout of a snapshot written for extent and count */
+        template <typename T, typename SizeT>
+        [[nodiscard]] static constexpr snapshot_layout of(std::size_t extent, std::size_t count) noexcept
+        {
+            return of<T, SizeT>(extent, count, extent / DenseFactor > count);
+        }
+
+        template <typename T, typename SizeT>
+        [[nodiscard]] static constexpr snapshot_layout of(std::size_t extent, std::size_t count, bool sorted) noexcept
+        {
+            static_assert(alignof(T) <= Alignment, "snapshot_layout: element types with an alignment over 64 bytes are not supported");
+
+            snapshot_layout layout;
+            layout.sorted = sorted;
+            layout.lookup = align(sizeof(snapshot_header));
+            layout.index = align(layout.lookup + (sorted ? 2 * count : extent) * sizeof(SizeT));
+            layout.data = align(layout.index + count * sizeof(SizeT));
+            layout.size = layout.data + count * sizeof(T);
+            return layout;
+        }
+
+        [[nodiscard]] static constexpr std::size_t align(std::size_t offset) noexcept
+        {
+            return (offset + Alignment - 1) / Alignment * Alignment;
+        }
+    };
+
+    /** The arrays of a snapshot, referring directly into its bytes */
+    template <typename T, typename SizeT>
+    struct snapshot_contents final {
+        std::span<const SizeT> positions;     // The dense lookup, or empty if it is sorted
+        std::span<const SizeT> sortedIndex;   // The sorted lookup, or empty if it is dense
+        std::span<const SizeT> sortedPositions;
+        std::span<const SizeT> index;
+        std::span<const T> data;
+        std::size_t extent = 0;
+    };
+
+    template <typename T, typename SizeT>
+    [[nodiscard]] snapshot_header make_snapshot_header(std::size_t extent, std::size_t count) noexcept
+    {
+        snapshot_header header;
+        header.sizeTypeSize = sizeof(SizeT);
+        header.valueSize = sizeof(T);
+        header.valueAlignment = alignof(T);
+        header.lookup = snapshot_layout::of<T, SizeT>(extent, count).sorted ? snapshot_header::SortedLookup : snapshot_header::DenseLookup;
+        header.extent = extent;
+        header.count = count;
+        return header;
+    }
+
+    /**
+     * Checks that a snapshot was written for the element and size types T and SizeT, and on a machine with the same byte order, and returns its arrays
+     *
+     * The offsets of the arrays are computed from the header, and checked to lie within the snapshot. The contents of the arrays are not checked, which
+     * takes time proportional to the extent, see validate_snapshot().
+     *
+     * @throws std::runtime_error if the snapshot does not match, is truncated, or is not aligned to the alignment of T and SizeT
+     */
+    template <typename T, typename SizeT>
+    [[nodiscard]] snapshot_contents<T, SizeT> read_snapshot(std::span<const std::byte> snapshot)
+    {
+        snapshot_header header;
+        if (snapshot.size() < sizeof(header))
+            throw std::runtime_error("sparse_vector: snapshot - truncated header");
+        std::memcpy(&header, snapshot.data(), sizeof(header));
+
+        if (header.magic != snapshot_header::Magic)
+            throw std::runtime_error("sparse_vector: snapshot - not a sparse_vector snapshot");
+        if (header.version != snapshot_header::CurrentVersion)
+            throw std::runtime_error("sparse_vector: snapshot - unsupported version");
+        if (header.byteOrder != snapshot_header::ByteOrderMark)
+            throw std::runtime_error("sparse_vector: snapshot - written with a different byte order");
+        if (header.sizeTypeSize != sizeof(SizeT) || header.valueSize != sizeof(T) || header.valueAlignment != alignof(T))
+            throw std::runtime_error("sparse_vector: snapshot - written for a different element or size type");
+
+        if (header.lookup != snapshot_header::DenseLookup && header.lookup != snapshot_header::SortedLookup)
+            throw std::runtime_error("sparse_vector: snapshot - unsupported lookup");
+        const bool sorted = header.lookup == snapshot_header::SortedLookup;
+
+        // Bound the counts by the size of the snapshot before computing offsets from them, so that the computation cannot overflow. Only a dense lookup
+        // is stored per index.
+        if ((!sorted && header.extent > snapshot.size() / sizeof(SizeT)) || header.count > snapshot.size() / std::max(sizeof(SizeT), sizeof(T)))
+            throw std::runtime_error("sparse_vector: snapshot - truncated");
+        if (header.count > header.extent || (header.extent > 0 && header.extent - 1 > std::numeric_limits<SizeT>::max()))
+            throw std::runtime_error("sparse_vector: snapshot - extent out of range");
+        const auto extent = static_cast<std::size_t>(header.extent);
+        const auto count = static_cast<std::size_t>(header.count);
+        const auto layout = snapshot_layout::of<T, SizeT>(extent, count, sorted);
+        if (snapshot.size() < layout.size)
+            throw std::runtime_error("sparse_vector: snapshot - truncated");
+
+        if (reinterpret_cast<std::uintptr_t>(snapshot.data()) % std::max(alignof(T), alignof(SizeT)) != 0)
+            throw std::runtime_error("sparse_vector: snapshot - misaligned");
+
+        const auto* bytes = snapshot.data();
+        const auto* lookup = reinterpret_cast<const SizeT*>(bytes + layout.lookup);
+        return {
+            {lookup, sorted ? 0 : extent},
+            {lookup, sorted ? count : 0},
+            {lookup + count, sorted ? count : 0},
+            {reinterpret_cast<const SizeT*>(bytes + layout.index), count},
+            {reinterpret_cast<const T*>(bytes + layout.data), count},
+            extent,
+        };
+    }
+
+    /**
+     * Checks that the lookup and the indices of a snapshot agree, so that every position in the lookup is that of an element, and every element is found at its index
+     *
+     * @throws std::runtime_error if they do not
+     */
+    template <typename T, typename SizeT>
+    void validate_snapshot(const snapshot_contents<T, SizeT>& contents)
+    {
+        constexpr auto InvalidPos = std::numeric_limits<SizeT>::max();
+        const auto count = contents.index.size();
+        const auto found = [&contents, count](std::size_t index, SizeT pos) {
+            return static_cast<std::size_t>(pos) < count && static_cast<std::size_t>(contents.index[pos]) == index;
+        };
+
+        // Each index is present at most once, so if count of them are found at their positions, the positions are those of all the elements
+        std::size_t numFound = 0;
+        if (contents.sortedIndex.empty()) {
+            for (std::size_t index = 0; index < contents.positions.size(); ++index) {
+                if (contents.positions[index] == InvalidPos)
+                    continue;
+                if (!found(index, contents.positions[index]))
+                    throw std::runtime_error("sparse_vector: snapshot - corrupt lookup");
+                ++numFound;
+            }
+        } else {
+            for (std::size_t i = 0; i < contents.sortedIndex.size(); ++i) {
+                const auto index = static_cast<std::size_t>(contents.sortedIndex[i]);
+                if (index >= contents.extent || index == InvalidPos || (i > 0 && index <= static_cast<std::size_t>(contents.sortedIndex[i - 1])) || !found(index, contents.sortedPositions[i]))
+                    throw std::runtime_error("sparse_vector: snapshot - corrupt lookup");
+                ++numFound;
+            }
+        }
+        if (numFound != count)
+            throw std::runtime_error("sparse_vector: snapshot - corrupt lookup");
+    }
+
+} // namespace ARo::detail
@@ -0,0 +1,1019 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ARo {
+
+    /** Use as the PageSize of a sparse_vector to select a compressed bitmap index, see detail::bitmap_sparse_index */
+    inline constexpr std::size_t BitmapIndex = std::numeric_limits<std::size_t>::max();
+
+} // namespace ARo
+
+namespace ARo::detail {
+
+    /** A pair-like type (such as std::pair or std::tuple) holding an index and a value */
+    template <typename P, typename SizeT>
+    concept index_value_pair = requires(P&& pair) {
+        { std::get<0>(pair) } -> std::convertible_to<SizeT>;
+        std::get<1>(std::forward<P>(pair));
+    };
+
+    /** Hints that the memory at address will soon be read */
+    inline void prefetch(const void* address) noexcept
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
+    }
+
+    /**
+     * Returns the number of values in a sorted range that are less than value, like std::lower_bound
+     *
+     * The number of steps depends only on the size of the range, and the comparisons select the next step without a branch, which compilers turn into
+     * conditional moves, so that searches for unpredictable values do not mispredict a branch at every step.
+     */
+    template <typename T>
+    [[nodiscard]] std::size_t branchless_lower_bound(std::span<const T> values, T value) noexcept
+    {
+        if (values.empty())
+            return 0;
+
+        const T* base = values.data();
+        for (auto count = values.size(); count > 1; count -= count / 2)
+            base = base[count / 2] < value ? base + count / 2 : base;
+        return static_cast<std::size_t>(base - values.data()) + (*base < value ? 1 : 0);
+    }
+
+    /** Combines the hash of an index with the hash of its value, spreading the bits so that the results can be summed without losing information */
+    [[nodiscard]] constexpr std::size_t mix_hash(std::size_t index, std::size_t valueHash) noexcept
+    {
+        // The finalizer of splitmix64
+        std::uint64_t x = (static_cast<std::uint64_t>(index) * 0x9e3779b97f4a7c15ULL) ^ valueHash;
+        x = (x ^ (x >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27U)) * 0x94d049bb133111ebULL;
+        return static_cast<std::size_t>(x ^ (x >> 31U));
+    }
+
+    /**
+     * Packing of a position and a generation counter into a single index entry.
+     *
+     * The generation occupies the GenerationBits most significant bits, and the position the rest. A position with all bits set means that
+     * the index is not present. With zero generation bits an entry is just a position, so the packing compiles away.
+     */
+    template <typename SizeT, unsigned GenerationBits>
+    struct index_entry final {
+        static_assert(std::is_unsigned_v<SizeT>, "index_entry: SizeT must be an unsigned type");
+        static_assert(GenerationBits < std::numeric_limits<SizeT>::digits, "index_entry: GenerationBits must leave room for the position");
+
+        static constexpr SizeT InvalidPos = ~(SizeT(0));
+        static constexpr SizeT PosMask = InvalidPos >> GenerationBits;
+        static constexpr SizeT Empty = PosMask; // Not present, generation zero
+
+        /** Returns the position held by the entry, or InvalidPos if there is none */
+        [[nodiscard]] static constexpr SizeT pos(SizeT entry) noexcept
+        {
+            if constexpr (GenerationBits == 0)
+                return entry;
+            else
+                return (entry & PosMask) == PosMask ? InvalidPos : entry & PosMask;
+        }
+
+        [[nodiscard]] static constexpr SizeT generation(SizeT entry) noexcept
+        {
+            if constexpr (GenerationBits == 0)
+                return 0;
+            else
+                return static_cast<SizeT>(entry >> (std::numeric_limits<SizeT>::digits - GenerationBits));
+        }
+
+        /** Returns the entry for a position, or for no position if pos is InvalidPos, with generation zero */
+        [[nodiscard]] static constexpr SizeT from_pos(SizeT pos) noexcept
+        {
+            return pos == InvalidPos ? Empty : pos;
+        }
+
+        /** Returns the entry with its position replaced, keeping the generation */
+        [[nodiscard]] static constexpr SizeT with_pos(SizeT entry, SizeT pos) noexcept
+        {
+            return static_cast<SizeT>((entry & ~PosMask) | (pos & PosMask));
+        }
+
+        /** Returns the entry with no position, and the generation advanced (wrapping around) */
+        [[nodiscard]] static constexpr SizeT erased(SizeT entry) noexcept
+        {
+            if constexpr (GenerationBits == 0)
+                return Empty;
+            else
+                return static_cast<SizeT>(((entry & ~PosMask) + PosMask + 1) | PosMask);
+        }
+    };
+
+    /**
+     * Maps indices to positions in a dense array, using a single contiguous array that grows to fit the largest index used.
+     *
+     * If GenerationBits is non-zero, each entry also holds a generation counter that is advanced whenever its index is removed.
+     */
+    template <typename SizeT, unsigned GenerationBits = 0>
+    class flat_sparse_index final {
+        using entry = index_entry<SizeT, GenerationBits>;
+
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        static constexpr SizeT InvalidPos = entry::InvalidPos;
+
+        flat_sparse_index() noexcept = default;
+        flat_sparse_index(const flat_sparse_index& other) = default;
+        flat_sparse_index(flat_sparse_index&& other) noexcept = default;
+
+        explicit flat_sparse_index(const allocator_type& allocator)
+            : pos_(allocator)
+        {}
+
+        flat_sparse_index(const flat_sparse_index& other, const allocator_type& allocator)
+            : pos_(other.pos_, allocator)
+        {}
+
+        flat_sparse_index(flat_sparse_index&& other, const allocator_type& allocator)
+            : pos_(std::move(other.pos_), allocator)
+        {}
+
+        flat_sparse_index& operator=(const flat_sparse_index& other) = default;
+        flat_sparse_index& operator=(flat_sparse_index&& other) noexcept = default;
+
+        /** Returns the position stored for the index, or InvalidPos if there is none */
+        [[nodiscard]] SizeT find(SizeT index) const noexcept
+        {
+            return index < pos_.size() ? entry::pos(pos_[index]) : InvalidPos;
+        }
+
+        /** Unchecked access to the position of an index that is known to be present */
+        [[nodiscard]] SizeT operator[](SizeT index) const noexcept
+        {
+            return entry::pos(pos_[index]);
+        }
+
+        /** Hints that the entry of the index will soon be looked up */
+        void prefetch(SizeT index) const noexcept
+        {
+            if (index < pos_.size())
+                detail::prefetch(pos_.data() + index);
+        }
+
+        /** Unchecked update of the position of an index that is known to be present */
+        void set(SizeT index, SizeT pos) noexcept
+        {
+            pos_[index] = entry::with_pos(pos_[index], pos);
+        }
+
+        /** Returns the generation of the index, which is zero for indices that have never been used */
+        [[nodiscard]] SizeT generation(SizeT index) const noexcept
+        {
+            return index < pos_.size() ? entry::generation(pos_[index]) : 0;
+        }
+
+        /** Returns the position stored for the index if its generation matches, or InvalidPos otherwise, with a single load */
+        [[nodiscard]] SizeT find(SizeT index, SizeT generation) const noexcept
+        {
+            if (index >= pos_.size())
+                return InvalidPos;
+            const auto e = pos_[index];
+            return entry::generation(e) == generation ? entry::pos(e) : InvalidPos;
+        }
+
+        /** Stores the position of an index that is not present */
+        void insert(SizeT index, SizeT pos)
+        {
+            if (index >= pos_.size())
+                pos_.resize(static_cast<std::size_t>(index) + 1, entry::Empty);
+            pos_[index] = entry::with_pos(pos_[index], pos);
+        }
+
+        /** Removes an index that is present */
+        void reset(SizeT index) noexcept
+        {
+            pos_[index] = entry::erased(pos_[index]);
+        }
+
+        /** Returns one past the largest index that can currently be looked up without growing the index */
+        [[nodiscard]] std::size_t extent() const noexcept
+        {
+            return pos_.size();
+        }
+
+        /** Returns the smallest index that is present and not less than from, or extent() if there is none */
+        [[nodiscard]] std::size_t next(std::size_t from) const noexcept
+        {
+            for (; from < pos_.size(); ++from) {
+                if (entry::pos(pos_[from]) != InvalidPos)
+                    return from;
+            }
+            return pos_.size();
+        }
+
+        /** Makes sure that indices below extent can be inserted without growing the index */
+        void grow(std::size_t extent)
+        {
+            if (extent > pos_.size())
+                pos_.resize(extent, entry::Empty);
+        }
+
+        void reserve(SizeT size)
+        {
+            pos_.reserve(size);
+        }
+
+        [[nodiscard]] std::size_t used_bytes() const noexcept
+        {
+            return pos_.size() * sizeof(SizeT);
+        }
+
+        [[nodiscard]] std::size_t allocated_bytes() const noexcept
+        {
+            return pos_.capacity() * sizeof(SizeT);
+        }
+
+        /** Drops the entries after the last one in use, and releases the spare capacity. Entries that hold a generation are kept. */
+        void shrink_to_fit()
+        {
+            auto size = pos_.size();
+            while (size > 0 && pos_[size - 1] == entry::Empty)
+                --size;
+            pos_.resize(size);
+            pos_.shrink_to_fit();
+        }
+
+        /** Replaces the contents with one position per index, where InvalidPos means that the index is not present, and resets all generations */
+        void assign(std::span<const SizeT> positions)
+        {
+            pos_.assign(positions.begin(), positions.end());
+            if constexpr (GenerationBits > 0)
+                std::ranges::transform(pos_, pos_.begin(), &entry::from_pos);
+        }
+
+    private:
+        std::pmr::vector<SizeT> pos_; // Packed entries, see index_entry
+    };
+
+    /**
+     * Maps indices to positions in a dense array, using fixed size pages that are allocated when first used and freed when they become empty.
+     *
+     * Pages that hold no positions all refer to a shared, read-only page filled with InvalidPos, so a lookup is always a shift, a mask and two loads.
+     *
+     * If GenerationBits is non-zero, each entry also holds a generation counter that is advanced whenever its index is removed. Pages are then
+     * kept once allocated, since freeing a page would lose the generations of its indices.
+     */
+    template <typename SizeT, std::size_t PageSize, unsigned GenerationBits = 0>
+    class paged_sparse_index final {
+        static_assert(std::has_single_bit(PageSize), "paged_sparse_index: PageSize must be a power of two");
+
+        using entry = index_entry<SizeT, GenerationBits>;
+
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        static constexpr SizeT InvalidPos = entry::InvalidPos;
+
+        paged_sparse_index() noexcept = default;
+
+        explicit paged_sparse_index(const allocator_type& allocator)
+            : pages_(allocator)
+            , counts_(allocator)
+        {}
+
+        paged_sparse_index(const paged_sparse_index& other)
+            : paged_sparse_index(other, allocator_type{})
+        {}
+
+        paged_sparse_index(const paged_sparse_index& other, const allocator_type& allocator)
+            : paged_sparse_index(allocator)
+        {
+            copy_from(other);
+        }
+
+        paged_sparse_index(paged_sparse_index&& other) noexcept
+            : pages_(std::move(other.pages_))
+            , counts_(std::move(other.counts_))
+        {}
+
+        paged_sparse_index(paged_sparse_index&& other, const allocator_type& allocator)
+            : paged_sparse_index(allocator)
+        {
+            if (pages_.get_allocator() == other.pages_.get_allocator())
+                swap_contents(other);
+            else
+                copy_from(other);
+        }
+
+        ~paged_sparse_index()
+        {
+            clear();
+        }
+
+        paged_sparse_index& operator=(const paged_sparse_index& other)
+        {
+            if (&other == this)
+                return *this;
+
+            clear();
+            copy_from(other);
+            return *this;
+        }
+
+        paged_sparse_index& operator=(paged_sparse_index&& other) noexcept
+        {
+            if (&other == this)
+                return *this;
+
+            clear();
+            if (pages_.get_allocator() == other.pages_.get_allocator())
+                swap_contents(other);
+            else
+                copy_from(other);
+            return *this;
+        }
+
+        /** Returns the position stored for the index, or InvalidPos if there is none */
+        [[nodiscard]] SizeT find(SizeT index) const noexcept
+        {
+            const auto page = static_cast<std::size_t>(index) >> PageShift;
+            return page < pages_.size() ? entry::pos(pages_[page][index & PageMask]) : InvalidPos;
+        }
+
+        /** Unchecked access to the position of an index that is known to be present */
+        [[nodiscard]] SizeT operator[](SizeT index) const noexcept
+        {
+            return entry::pos(pages_[static_cast<std::size_t>(index) >> PageShift][index & PageMask]);
+        }
+
+        /** Hints that the entry of the index will soon be looked up (the page table itself is small, and is not prefetched) */
+        void prefetch(SizeT index) const noexcept
+        {
+            if (const auto page = static_cast<std::size_t>(index) >> PageShift; page < pages_.size())
+                detail::prefetch(pages_[page] + (index & PageMask));
+        }
+
+        /** Unchecked update of the position of an index that is known to be present */
+        void set(SizeT index, SizeT pos) noexcept
+        {
+            auto& e = pages_[static_cast<std::size_t>(index) >> PageShift][index & PageMask];
+            e = entry::with_pos(e, pos);
+        }
+
+        /** Returns the generation of the index, which is zero for indices that have never been used */
+        [[nodiscard]] SizeT generation(SizeT index) const noexcept
+        {
+            const auto page = static_cast<std::size_t>(index) >> PageShift;
+            return page < pages_.size() ? entry::generation(pages_[page][index & PageMask]) : 0;
+        }
+
+        /** Returns the position stored for the index if its generation matches, or InvalidPos otherwise, with a single load from the page */
+        [[nodiscard]] SizeT find(SizeT index, SizeT generation) const noexcept
+        {
+            const auto page = static_cast<std::size_t>(index) >> PageShift;
+            if (page >= pages_.size())
+                return InvalidPos;
+            const auto e = pages_[page][index & PageMask];
+            return entry::generation(e) == generation ? entry::pos(e) : InvalidPos;
+        }
+
+        /** Stores the position of an index that is not present, allocating its page if needed */
+        void insert(SizeT index, SizeT pos)
+        {
+            const auto page = static_cast<std::size_t>(index) >> PageShift;
+            if (page >= pages_.size())
+                grow_table(page + 1);
+
+            if (pages_[page] == empty_page())
+                pages_[page] = allocate_page();
+
+            auto& e = pages_[page][index & PageMask];
+            e = entry::with_pos(e, pos);
+            ++counts_[page];
+        }
+
+        /** Removes an index that is present, freeing its page if it becomes empty (unless generations are kept) */
+        void reset(SizeT index) noexcept
+        {
+            const auto page = static_cast<std::size_t>(index) >> PageShift;
+            auto& e = pages_[page][index & PageMask];
+            e = entry::erased(e);
+            if (--counts_[page] == 0 && GenerationBits == 0) {
+                deallocate_page(pages_[page]);
+                pages_[page] = empty_page();
+            }
+        }
+
+        /** Returns one past the largest index that can currently be looked up without growing the index */
+        [[nodiscard]] std::size_t extent() const noexcept
+        {
+            return pages_.size() << PageShift;
+        }
+
+        /** Returns the smallest index that is present and not less than from, or extent() if there is none. Empty pages are skipped without being scanned. */
+        [[nodiscard]] std::size_t next(std::size_t from) const noexcept
+        {
+            for (auto page = from >> PageShift; page < pages_.size(); from = ++page << PageShift) {
+                if (counts_[page] == 0)
+                    continue;
+
+                for (auto i = from & PageMask; i < PageSize; ++i) {
+                    if (entry::pos(pages_[page][i]) != InvalidPos)
+                        return (page << PageShift) | i;
+                }
+            }
+            return extent();
+        }
+
+        /** Makes sure that indices below extent can be inserted without growing the page table (pages are still allocated on demand) */
+        void grow(std::size_t extent)
+        {
+            const auto pageCount = (extent + PageMask) >> PageShift;
+            if (pageCount > pages_.size())
+                grow_table(pageCount);
+        }
+
+        void reserve(SizeT size)
+        {
+            const auto pageCount = (static_cast<std::size_t>(size) + PageMask) >> PageShift;
+            counts_.reserve(pageCount);
+            pages_.reserve(pageCount);
+        }
+
+        [[nodiscard]] std::size_t used_bytes() const noexcept
+        {
+            return allocated_page_count() * PageSize * sizeof(SizeT) + pages_.size() * (sizeof(SizeT*) + sizeof(std::size_t));
+        }
+
+        [[nodiscard]] std::size_t allocated_bytes() const noexcept
+        {
+            return allocated_page_count() * PageSize * sizeof(SizeT) + pages_.capacity() * sizeof(SizeT*) + counts_.capacity() * sizeof(std::size_t);
+        }
+
+        /** Drops the unallocated pages at the end of the page table, and releases its spare capacity */
+        void shrink_to_fit()
+        {
+            while (!pages_.empty() && pages_.back() == empty_page()) {
+                pages_.pop_back();
+                counts_.pop_back();
+            }
+            pages_.shrink_to_fit();
+            counts_.shrink_to_fit();
+        }
+
+        /** Replaces the contents with one position per index, where InvalidPos means that the index is not present, and resets all generations */
+        void assign(std::span<const SizeT> positions)
+        {
+            clear();
+            grow(positions.size());
+            for (std::size_t page = 0; page < pages_.size(); ++page) {
+                const auto chunk = positions.subspan(page << PageShift, std::min(PageSize, positions.size() - (page << PageShift)));
+                const auto count = static_cast<std::size_t>(std::ranges::count_if(chunk, [](SizeT pos) { return pos != InvalidPos; }));
+                if (count == 0)
+                    continue;
+
+                pages_[page] = allocate_page();
+                std::ranges::transform(chunk, pages_[page], &entry::from_pos);
+                counts_[page] = count;
+            }
+        }
+
+    private:
+        static constexpr std::size_t PageShift = std::countr_zero(PageSize);
+        static constexpr std::size_t PageMask = PageSize - 1;
+
+        // The shared page is never written to, since a page is only written after it has been allocated
+        static SizeT* empty_page() noexcept
+        {
+            static constexpr auto EmptyPage = [] {
+                std::array<SizeT, PageSize> page{};
+                page.fill(entry::Empty);
+                return page;
+            }();
+            return const_cast<SizeT*>(EmptyPage.data());
+        }
+
+        SizeT* allocate_page()
+        {
+            auto* page = pages_.get_allocator().template allocate_object<SizeT>(PageSize);
+            std::uninitialized_fill_n(page, PageSize, entry::Empty);
+            return page;
+        }
+
+        void deallocate_page(SizeT* page) noexcept
+        {
+            pages_.get_allocator().deallocate_object(page, PageSize);
+        }
+
+        [[nodiscard]] std::size_t allocated_page_count() const noexcept
+        {
+            return static_cast<std::size_t>(std::ranges::count_if(pages_, [](const SizeT* page) { return page != empty_page(); }));
+        }
+
+        // Grows the page table and the page counts to pageCount pages, keeping them the same size if either allocation fails
+        void grow_table(std::size_t pageCount)
+        {
+            counts_.resize(pageCount, 0);
+            try {
+                pages_.resize(pageCount, empty_page());
+            } catch (...) {
+                counts_.resize(pages_.size());
+                throw;
+            }
+        }
+
+        void copy_from(const paged_sparse_index& other)
+        {
+            counts_.reserve(other.counts_.size());
+            pages_.reserve(other.pages_.size());
+            for (std::size_t i = 0; i < other.pages_.size(); ++i) {
+                auto* page = empty_page();
+                if (other.pages_[i] != empty_page()) {
+                    page = allocate_page();
+                    std::copy_n(other.pages_[i], PageSize, page);
+                }
+                pages_.push_back(page);
+                counts_.push_back(other.counts_[i]);
+            }
+        }
+
+        void swap_contents(paged_sparse_index& other) noexcept
+        {
+            pages_.swap(other.pages_);
+            counts_.swap(other.counts_);
+        }
+
+        void clear() noexcept
+        {
+            for (auto* page : pages_) {
+                if (page != empty_page())
+                    deallocate_page(page);
+            }
+            pages_.clear();
+            counts_.clear();
+        }
+
+        std::pmr::vector<SizeT*> pages_;
+        std::pmr::vector<std::size_t> counts_; // Number of positions stored in each page
+    };
+
+    /**
+     * Maps indices to positions in a dense array, using a compressed bitmap of the indices that are present and a rank query, in the style of Roaring bitmaps.
+     *
+     * The index space is split into blocks of 65536 indices, and only blocks that hold at least one index are stored, in a container kept in a sorted array.
+     * A container with few indices stores their low 16 bits in a sorted array. Once it holds more than ArrayLimit indices it is converted to a bitmap,
+     * with the number of bits set before each cache line of it, and it is converted back once it has shrunk to half of that. The positions of the indices
+     * in a container are stored in ascending index order, so the position of an index is found at its rank among them: its place in the sorted array,
+     * or the number of bits set before it in the bitmap, which is a count stored for its cache line plus the popcount of at most eight words.
+     *
+     * The memory used is thus proportional to the number of indices, regardless of how far apart they are, at the cost of a binary search for each lookup,
+     * and of moving the positions after the rank for each insert and reset.
+     */
+    template <typename SizeT>
+    class bitmap_sparse_index final {
+        static_assert(std::is_unsigned_v<SizeT>, "bitmap_sparse_index: SizeT must be an unsigned type");
+
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        static constexpr SizeT InvalidPos = ~(SizeT(0));
+        static constexpr std::size_t ArrayLimit = 4096; // The largest number of indices in an array container, where it gets as large as a bitmap
+
+        bitmap_sparse_index() noexcept = default;
+        bitmap_sparse_index(const bitmap_sparse_index& other) = default;
+
+        bitmap_sparse_index(bitmap_sparse_index&& other) noexcept
+            : keys_(std::move(other.keys_))
+            , containers_(std::move(other.containers_))
+            , extent_(std::exchange(other.extent_, 0))
+        {}
+
+        explicit bitmap_sparse_index(const allocator_type& allocator)
+            : keys_(allocator)
+            , containers_(allocator)
+        {}
+
+        bitmap_sparse_index(const bitmap_sparse_index& other, const allocator_type& allocator)
+            : keys_(other.keys_, allocator)
+            , containers_(other.containers_, allocator)
+            , extent_(other.extent_)
+        {}
+
+        bitmap_sparse_index(bitmap_sparse_index&& other, const allocator_type& allocator)
+            : keys_(std::move(other.keys_), allocator)
+            , containers_(std::move(other.containers_), allocator)
+            , extent_(other.extent_)
+        {
+            other.clear();
+        }
+
+        bitmap_sparse_index& operator=(const bitmap_sparse_index& other) = default;
+
+        bitmap_sparse_index& operator=(bitmap_sparse_index&& other) noexcept
+        {
+            keys_ = std::move(other.keys_);
+            containers_ = std::move(other.containers_);
+            extent_ = other.extent_;
+            other.clear();
+            return *this;
+        }
+
+        /** Returns the position stored for the index, or InvalidPos if there is none */
+        [[nodiscard]] SizeT find(SizeT index) const noexcept
+        {
+            const auto c = container_of(index);
+            if (c == keys_.size())
+                return InvalidPos;
+            const auto [rank, present] = containers_[c].rank(low_bits(index));
+            return present ? containers_[c].positions[rank] : InvalidPos;
+        }
+
+        /** Unchecked access to the position of an index that is known to be present */
+        [[nodiscard]] SizeT operator[](SizeT index) const noexcept
+        {
+            const auto& container = containers_[container_of(index)];
+            return container.positions[container.rank(low_bits(index)).first];
+        }
+
+        /** Hints that the container word holding the index will soon be looked up */
+        void prefetch(SizeT index) const noexcept
+        {
+            if (const auto c = container_of(index); c != keys_.size())
+                containers_[c].prefetch(low_bits(index));
+        }
+
+        /** Unchecked update of the position of an index that is known to be present */
+        void set(SizeT index, SizeT pos) noexcept
+        {
+            auto& container = containers_[container_of(index)];
+            container.positions[container.rank(low_bits(index)).first] = pos;
+        }
+
+        /** Stores the position of an index that is not present, creating its container if needed */
+        void insert(SizeT index, SizeT pos)
+        {
+            const auto key = key_of(index);
+            const auto keyPos = std::ranges::lower_bound(keys_, key);
+            const auto c = static_cast<std::size_t>(keyPos - keys_.begin());
+            const bool created = keyPos == keys_.end() || *keyPos != key;
+            if (created) {
+                containers_.emplace(containers_.begin() + static_cast<std::ptrdiff_t>(c));
+                try {
+                    keys_.insert(keyPos, key);
+                } catch (...) {
+                    containers_.erase(containers_.begin() + static_cast<std::ptrdiff_t>(c));
+                    throw;
+                }
+            }
+
+            // A container is never left empty, since reset() and extent() rely on each container holding an index
+            try {
+                containers_[c].insert(low_bits(index), pos);
+            } catch (...) {
+                if (created) {
+                    containers_.erase(containers_.begin() + static_cast<std::ptrdiff_t>(c));
+                    keys_.erase(keys_.begin() + static_cast<std::ptrdiff_t>(c));
+                }
+                throw;
+            }
+            extent_ = std::max(extent_, static_cast<std::size_t>(index) + 1);
+        }
+
+        /** Removes an index that is present, removing its container if it becomes empty */
+        void reset(SizeT index) noexcept
+        {
+            const auto c = container_of(index);
+            auto& container = containers_[c];
+            container.reset(low_bits(index));
+            if (container.positions.empty()) {
+                containers_.erase(containers_.begin() + static_cast<std::ptrdiff_t>(c));
+                keys_.erase(keys_.begin() + static_cast<std::ptrdiff_t>(c));
+            }
+
+            if (static_cast<std::size_t>(index) + 1 == extent_)
+                extent_ = keys_.empty() ? 0 : (static_cast<std::size_t>(keys_.back()) << ContainerBits | containers_.back().last()) + 1;
+        }
+
+        /** Returns one past the largest index that is present */
+        [[nodiscard]] std::size_t extent() const noexcept
+        {
+            return extent_;
+        }
+
+        /** Returns the smallest index that is present and not less than from, or extent() if there is none. Absent containers are never visited. */
+        [[nodiscard]] std::size_t next(std::size_t from) const noexcept
+        {
+            if (from >= extent_)
+                return extent_;
+
+            const auto fromKey = static_cast<SizeT>(from >> ContainerBits);
+            for (auto c = static_cast<std::size_t>(std::ranges::lower_bound(keys_, fromKey) - keys_.begin()); c < keys_.size(); ++c) {
+                const auto fromLow = keys_[c] == fromKey ? static_cast<std::uint32_t>(from & LowMask) : 0U;
+                if (const auto low = containers_[c].next(fromLow); low != ContainerSize)
+                    return static_cast<std::size_t>(keys_[c]) << ContainerBits | low;
+            }
+            return extent_;
+        }
+
+        /** Does nothing, since containers are created as indices are inserted */
+        void grow(std::size_t /*extent*/) noexcept {}
+
+        /** Does nothing, since the size of the index depends on how the indices are spread rather than on their range */
+        void reserve(SizeT /*size*/) noexcept {}
+
+        [[nodiscard]] std::size_t used_bytes() const noexcept
+        {
+            std::size_t bytes = keys_.size() * sizeof(SizeT) + containers_.size() * sizeof(container);
+            for (const auto& c : containers_)
+                bytes += c.used_bytes();
+            return bytes;
+        }
+
+        [[nodiscard]] std::size_t allocated_bytes() const noexcept
+        {
+            std::size_t bytes = keys_.capacity() * sizeof(SizeT) + containers_.capacity() * sizeof(container);
+            for (const auto& c : containers_)
+                bytes += c.allocated_bytes();
+            return bytes;
+        }
+
+        /** Releases the spare capacity of the key array and of every container */
+        void shrink_to_fit()
+        {
+            keys_.shrink_to_fit();
+            containers_.shrink_to_fit();
+            for (auto& c : containers_)
+                c.shrink_to_fit();
+        }
+
+        /** Converts the bitmap containers that would be smaller as arrays, which they are not converted to as they shrink until they are half that size */
+        void compact()
+        {
+            for (auto& c : containers_) {
+                if (c.is_bitmap() && c.positions.size() <= ArrayLimit)
+                    c.to_array();
+            }
+        }
+
+        /** Replaces the contents with one position per index, where InvalidPos means that the index is not present */
+        void assign(std::span<const SizeT> positions)
+        {
+            clear();
+            for (std::size_t i = 0; i < positions.size(); ++i) {
+                if (positions[i] != InvalidPos)
+                    insert(static_cast<SizeT>(i), positions[i]);
+            }
+        }
+
+    private:
+        static constexpr unsigned ContainerBits = 16;
+        static constexpr std::uint32_t ContainerSize = 1U << ContainerBits;
+        static constexpr std::uint32_t LowMask = ContainerSize - 1;
+        static constexpr std::size_t WordCount = ContainerSize / 64;
+        static constexpr std::size_t RankBlockWords = 8; // One rank count per cache line of the bitmap
+
+        // The indices of one block of 65536 that are present, as either a sorted array or a bitmap of their low 16 bits, and their positions
+        struct container {
+            using allocator_type = std::pmr::polymorphic_allocator<>;
+
+            explicit container(const allocator_type& allocator = {})
+                : lows(allocator)
+                , bits(allocator)
+                , ranks(allocator)
+                , positions(allocator)
+            {}
+
+            container(const container& other) = default;
+            container(container&& other) noexcept = default;
+
+            container(const container& other, const allocator_type& allocator)
+                : lows(other.lows, allocator)
+                , bits(other.bits, allocator)
+                , ranks(other.ranks, allocator)
+                , positions(other.positions, allocator)
+            {}
+
+            container(container&& other, const allocator_type& allocator)
+                : lows(std::move(other.lows), allocator)
+                , bits(std::move(other.bits), allocator)
+                , ranks(std::move(other.ranks), allocator)
+                , positions(std::move(other.positions), allocator)
+            {}
+
+            container& operator=(const container& other) = default;
+            container& operator=(container&& other) noexcept = default;
+
+            [[nodiscard]] bool is_bitmap() const noexcept
+            {
+                return !bits.empty();
+            }
+
+            // Returns the number of members below low, and whether low is a member
+            [[nodiscard]] std::pair<std::size_t, bool> rank(std::uint32_t low) const noexcept
+            {
+                if (!is_bitmap()) {
+                    const auto r = branchless_lower_bound(std::span<const std::uint16_t>(lows), static_cast<std::uint16_t>(low));
+                    return {r, r < lows.size() && lows[r] == low};
+                }
+
+                const auto word = low / 64;
+                const auto bit = std::uint64_t{1} << (low % 64);
+                std::size_t count = ranks[word / RankBlockWords];
+                for (auto w = word / RankBlockWords * RankBlockWords; w < word; ++w)
+                    count += static_cast<std::size_t>(std::popcount(bits[w]));
+                count += static_cast<std::size_t>(std::popcount(bits[word] & (bit - 1)));
+                return {count, (bits[word] & bit) != 0};
+            }
+
+            void prefetch(std::uint32_t low) const noexcept
+            {
+                if (is_bitmap())
+                    detail::prefetch(bits.data() + low / 64);
+                else
+                    detail::prefetch(lows.data() + lows.size() / 2);
+            }
+
+            void insert(std::uint32_t low, SizeT pos)
+            {
+                if (!is_bitmap() && lows.size() == ArrayLimit)
+                    to_bitmap();
+
+                const auto r = rank(low).first;
+                if (is_bitmap()) {
+                    positions.insert(positions.begin() + static_cast<std::ptrdiff_t>(r), pos);
+                    bits[low / 64] |= std::uint64_t{1} << (low % 64);
+                    for (auto block = low / 64 / RankBlockWords + 1; block < ranks.size(); ++block)
+                        ++ranks[block];
+                    return;
+                }
+
+                lows.insert(lows.begin() + static_cast<std::ptrdiff_t>(r), static_cast<std::uint16_t>(low));
+                try {
+                    positions.insert(positions.begin() + static_cast<std::ptrdiff_t>(r), pos);
+                } catch (...) {
+                    lows.erase(lows.begin() + static_cast<std::ptrdiff_t>(r));
+                    throw;
+                }
+            }
+
+            void reset(std::uint32_t low) noexcept
+            {
+                const auto r = rank(low).first;
+                positions.erase(positions.begin() + static_cast<std::ptrdiff_t>(r));
+                if (!is_bitmap()) {
+                    lows.erase(lows.begin() + static_cast<std::ptrdiff_t>(r));
+                    return;
+                }
+
+                bits[low / 64] &= ~(std::uint64_t{1} << (low % 64));
+                for (auto block = low / 64 / RankBlockWords + 1; block < ranks.size(); ++block)
+                    --ranks[block];
+
+                // If there is no memory for the array, the container simply stays a bitmap
+                if (positions.size() <= ArrayLimit / 2) {
+                    try {
+                        to_array();
+                    } catch (const std::bad_alloc&) {
+                    }
+                }
+            }
+
+            [[nodiscard]] std::size_t used_bytes() const noexcept
+            {
+                return lows.size() * sizeof(std::uint16_t) + bits.size() * sizeof(std::uint64_t) + ranks.size() * sizeof(std::uint16_t) + positions.size() * sizeof(SizeT);
+            }
+
+            [[nodiscard]] std::size_t allocated_bytes() const noexcept
+            {
+                return lows.capacity() * sizeof(std::uint16_t) + bits.capacity() * sizeof(std::uint64_t) + ranks.capacity() * sizeof(std::uint16_t)
+                    + positions.capacity() * sizeof(SizeT);
+            }
+
+            void shrink_to_fit()
+            {
+                lows.shrink_to_fit();
+                positions.shrink_to_fit();
+            }
+
+            // Returns the smallest member not less than from, or ContainerSize if there is none
+            [[nodiscard]] std::uint32_t next(std::uint32_t from) const noexcept
+            {
+                if (!is_bitmap()) {
+                    const auto it = std::ranges::lower_bound(lows, static_cast<std::uint16_t>(from));
+                    return it == lows.end() ? ContainerSize : *it;
+                }
+
+                for (auto word = from / 64; word < WordCount; ++word) {
+                    const auto remaining = word == from / 64 ? bits[word] & (~std::uint64_t{0} << (from % 64)) : bits[word];
+                    if (remaining != 0)
+                        return static_cast<std::uint32_t>(word * 64 + static_cast<std::size_t>(std::countr_zero(remaining)));
+                }
+                return ContainerSize;
+            }
+
+            // Returns the largest member of a container that is not empty
+            [[nodiscard]] std::uint32_t last() const noexcept
+            {
+                if (!is_bitmap())
+                    return lows.back();
+
+                auto word = WordCount - 1;
+                while (bits[word] == 0)
+                    --word;
+                return static_cast<std::uint32_t>(word * 64 + 63 - static_cast<std::size_t>(std::countl_zero(bits[word])));
+            }
+
+            // Both conversions leave the container unchanged if they fail
+            void to_bitmap()
+            {
+                std::pmr::vector<std::uint64_t> newBits(WordCount, 0, bits.get_allocator());
+                std::pmr::vector<std::uint16_t> newRanks(WordCount / RankBlockWords, 0, ranks.get_allocator());
+                for (const auto low : lows)
+                    newBits[low / 64] |= std::uint64_t{1} << (low % 64);
+                bits.swap(newBits);
+                ranks.swap(newRanks);
+                update_ranks();
+                std::pmr::vector<std::uint16_t>(lows.get_allocator()).swap(lows);
+            }
+
+            void to_array()
+            {
+                std::pmr::vector<std::uint16_t> newLows(lows.get_allocator());
+                newLows.reserve(positions.size());
+                for (std::size_t word = 0; word < WordCount; ++word) {
+                    for (auto remaining = bits[word]; remaining != 0; remaining &= remaining - 1)
+                        newLows.push_back(static_cast<std::uint16_t>(word * 64 + static_cast<std::size_t>(std::countr_zero(remaining))));
+                }
+                lows.swap(newLows);
+                std::pmr::vector<std::uint64_t>(bits.get_allocator()).swap(bits);
+                std::pmr::vector<std::uint16_t>(ranks.get_allocator()).swap(ranks);
+            }
+
+            void update_ranks() noexcept
+            {
+                std::uint16_t count = 0;
+                for (std::size_t block = 0; block < ranks.size(); ++block) {
+                    ranks[block] = count;
+                    for (std::size_t w = 0; w < RankBlockWords; ++w)
+                        count = static_cast<std::uint16_t>(count + std::popcount(bits[block * RankBlockWords + w]));
+                }
+            }
+
+            std::pmr::vector<std::uint16_t> lows;  // Array container: the low 16 bits of each member, ascending. Empty for a bitmap container.
+            std::pmr::vector<std::uint64_t> bits;  // Bitmap container: one bit per low 16 bits value. Empty for an array container.
+            std::pmr::vector<std::uint16_t> ranks; // Bitmap container: the number of members before each block of RankBlockWords words
+            std::pmr::vector<SizeT> positions;     // Position of each member, in ascending order of the members
+        };
+
+        [[nodiscard]] static SizeT key_of(SizeT index) noexcept
+        {
+            return static_cast<SizeT>(static_cast<std::size_t>(index) >> ContainerBits);
+        }
+
+        [[nodiscard]] static std::uint32_t low_bits(SizeT index) noexcept
+        {
+            return static_cast<std::uint32_t>(index & LowMask);
+        }
+
+        void clear() noexcept
+        {
+            keys_.clear();
+            containers_.clear();
+            extent_ = 0;
+        }
+
+        // Returns the number of the container holding the index, or keys_.size() if there is none
+        [[nodiscard]] std::size_t container_of(SizeT index) const noexcept
+        {
+            const auto key = key_of(index);
+            const auto c = branchless_lower_bound(std::span<const SizeT>(keys_), key);
+            return c < keys_.size() && keys_[c] == key ? c : keys_.size();
+        }
+
+        std::pmr::vector<SizeT> keys_;           // The high bits of the indices in each container, ascending, kept apart from the containers for a compact search
+        std::pmr::vector<container> containers_;
+        std::size_t extent_ = 0;                 // One past the largest index present
+    };
+
+    /** The index type used by sparse_vector and sparse_multi_vector for a PageSize */
+    template <typename SizeT, std::size_t PageSize, unsigned GenerationBits = 0>
+    using sparse_index_for = std::conditional_t<PageSize == BitmapIndex, bitmap_sparse_index<SizeT>,
+        std::conditional_t<PageSize == 0, flat_sparse_index<SizeT, GenerationBits>, paged_sparse_index<SizeT, PageSize, GenerationBits>>>;
+
+} // namespace ARo::detail
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+
+namespace ARo::detail {
+
+    /**
+     * Random access iterator that steps through several parallel arrays at once, and yields a tuple of references to their elements.
+     */
+    template <typename... Ptrs>
+    class zip_iterator final {
+        static_assert(sizeof...(Ptrs) > 0 && (std::is_pointer_v<Ptrs> && ...), "zip_iterator: needs at least one pointer type");
+
+    public:
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::input_iterator_tag; // The reference type is a proxy
+        using value_type = std::tuple<std::iter_reference_t<Ptrs>...>;
+        using reference = std::tuple<std::iter_reference_t<Ptrs>...>;
+        using difference_type = std::ptrdiff_t;
+
+        zip_iterator() noexcept = default;
+
+        explicit zip_iterator(Ptrs... ptrs) noexcept
+            : ptrs_(ptrs...)
+        {}
+
+        /** Conversion from a mutable to a const iterator */
+        template <typename... Others>
+            requires(sizeof...(Others) == sizeof...(Ptrs) && !(std::is_same_v<Others, Ptrs> && ...) && (std::is_convertible_v<Others, Ptrs> && ...))
+        zip_iterator(const zip_iterator<Others...>& other) noexcept // NOLINT: Implicit conversion intended
+            : ptrs_(other.ptrs_)
+        {}
+
+        [[nodiscard]] reference operator*() const noexcept
+        {
+            return std::apply([](auto... ptrs) { return reference{*ptrs...}; }, ptrs_);
+        }
+
+        [[nodiscard]] reference operator[](difference_type n) const noexcept
+        {
+            return *(*this + n);
+        }
+
+        zip_iterator& operator++() noexcept
+        {
+            return *this += 1;
+        }
+
+        zip_iterator operator++(int) noexcept
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+
+        zip_iterator& operator--() noexcept
+        {
+            return *this -= 1;
+        }
+
+        zip_iterator operator--(int) noexcept
+        {
+            auto result = *this;
+            --*this;
+            return result;
+        }
+
+        zip_iterator& operator+=(difference_type n) noexcept
+        {
+            std::apply([n](auto&... ptrs) { ((ptrs += n), ...); }, ptrs_);
+            return *this;
+        }
+
+        zip_iterator& operator-=(difference_type n) noexcept
+        {
+            return *this += -n;
+        }
+
+        [[nodiscard]] friend zip_iterator operator+(zip_iterator it, difference_type n) noexcept
+        {
+            return it += n;
+        }
+
+        [[nodiscard]] friend zip_iterator operator+(difference_type n, zip_iterator it) noexcept
+        {
+            return it += n;
+        }
+
+        [[nodiscard]] friend zip_iterator operator-(zip_iterator it, difference_type n) noexcept
+        {
+            return it -= n;
+        }
+
+        [[nodiscard]] friend difference_type operator-(const zip_iterator& lhs, const zip_iterator& rhs) noexcept
+        {
+            return std::get<0>(lhs.ptrs_) - std::get<0>(rhs.ptrs_);
+        }
+
+        [[nodiscard]] friend bool operator==(const zip_iterator& lhs, const zip_iterator& rhs) noexcept
+        {
+            return std::get<0>(lhs.ptrs_) == std::get<0>(rhs.ptrs_);
+        }
+
+        [[nodiscard]] friend auto operator<=>(const zip_iterator& lhs, const zip_iterator& rhs) noexcept
+        {
+            return std::get<0>(lhs.ptrs_) <=> std::get<0>(rhs.ptrs_);
+        }
+
+    private:
+        template <typename...>
+        friend class zip_iterator;
+
+        std::tuple<Ptrs...> ptrs_;
+    };
+
+} // namespace ARo::detail
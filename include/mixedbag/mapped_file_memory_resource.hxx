@@ -0,0 +1,101 @@
+#pragma once
+
+#include <mixedbag/exports.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory_resource>
+#include <span>
+
+namespace ARo {
+
+/**
+ * A memory resource that hands out memory from a memory mapped file, which grows as needed.
+ *
+ * This lets containers such as sparse_vector keep their storage in file backed pages, that the kernel can write out and drop from memory when it is short of it,
+ * instead of in anonymous memory. The addresses of allocations never change, since the address space for the whole file (up to maxSize bytes) is reserved
+ * when the resource is created, and the file is mapped into it as it grows. Reserving address space does not use any memory.
+ *
+ * Allocations are rounded up to a power of two of at least 64 bytes, and deallocated blocks are kept in one free list per size, to be reused by later
+ * allocations of the same size. Blocks are aligned to their size, up to 4096 bytes, which is also the largest alignment supported. The file is sparse,
+ * so pages that have never been written take no space on disk.
+ *
+ * The contents of the file, including the free lists, are kept when the resource is destroyed, and are used again when the file is opened next time.
+ * Since the file may be mapped at another address then, only data that holds no pointers survives a restart, and set_root() records where to find it.
+ * A snapshot of a sparse_vector of trivially copyable elements is such data:
+ *
+ * @code
+ * ARo::mapped_file_memory_resource storage("state.heap");
+ * if (storage.root().empty()) {
+ *     auto* snapshot = static_cast<std::byte*>(storage.allocate(positions.snapshot_size(), 64));
+ *     positions.write_snapshot({snapshot, positions.snapshot_size()});
+ *     storage.set_root({snapshot, positions.snapshot_size()});
+ * }
+ * const ARo::sparse_vector_view<Position> restored(storage.root()); // After a restart
+ * @endcode
+ *
+ * The file is only guaranteed to be consistent on disk after flush(), and not if the process dies while it is allocating or deallocating.
+ * Only one resource at a time may use a file. This class is not thread safe, and is only available on POSIX systems.
+ */
+class MIXEDBAG_EXPORT mapped_file_memory_resource final : public std::pmr::memory_resource {
+    public:
+    // 64 GiB, or as much as a std::size_t can hold on 32 bit targets
+    static constexpr std::size_t DefaultMaxSize = static_cast<std::size_t>(std::min<std::uintmax_t>(std::uintmax_t{1} << 36, std::numeric_limits<std::size_t>::max()));
+    static constexpr std::size_t MaxAlignment = 4096;
+
+    /**
+     * Opens the file at path, or creates it if it does not exist
+     *
+     * @param maxSize The largest size that the file may grow to
+     * @throws std::system_error if the file cannot be opened or mapped
+     * @throws std::runtime_error if the file exists but was not created by a mapped_file_memory_resource, or is larger than maxSize
+     */
+    explicit mapped_file_memory_resource(const std::filesystem::path& path, std::size_t maxSize = DefaultMaxSize);
+
+    mapped_file_memory_resource(const mapped_file_memory_resource&) = delete;
+    mapped_file_memory_resource& operator=(const mapped_file_memory_resource&) = delete;
+
+    ~mapped_file_memory_resource() override;
+
+    /** Returns the memory recorded by set_root(), or an empty span if there is none */
+    [[nodiscard]] std::span<std::byte> root() const noexcept;
+
+    /**
+     * Records a block of memory allocated from this resource, so that it can be found again with root() after the file has been reopened
+     *
+     * @throws std::invalid_argument if the memory was not allocated from this resource
+     */
+    void set_root(std::span<const std::byte> root);
+
+    /** Writes all changes to the file to disk, and waits until they are written */
+    void flush();
+
+    /** Returns the current size of the file */
+    [[nodiscard]] std::size_t get_file_size() const noexcept
+    {
+        return mappedSize_;
+    }
+
+    /** Returns the number of bytes in live allocations, after rounding up to the block size */
+    [[nodiscard]] std::size_t get_num_allocated_bytes() const noexcept;
+
+    private:
+    struct FileHeader;
+
+    [[nodiscard]] FileHeader& header() const noexcept;
+    void grow(std::size_t requiredSize);
+
+    void* do_allocate(std::size_t byteCount, std::size_t alignment) override;
+    void do_deallocate(void* address, std::size_t byteCount, std::size_t alignment) override;
+    bool do_is_equal(const memory_resource& other) const noexcept override;
+
+    int fd_ = -1;
+    std::byte* base_ = nullptr;   // Start of the reserved address space, where the file is mapped
+    std::size_t reservedSize_ = 0;
+    std::size_t mappedSize_ = 0;  // Size of the file, all of which is mapped
+};
+
+} // namespace ARo
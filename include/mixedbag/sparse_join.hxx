@@ -0,0 +1,179 @@
+#pragma once
+
+#include <mixedbag/sparse_vector.hxx>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace ARo {
+
+    /**
+     * A view of the indices that are present in all of several sparse_vectors, yielding a tuple of the index followed by references to the value in each of them.
+     *
+     * The view walks the dense storage of the smallest of the sparse_vectors, and probes the others through their indices without throwing, so the cost is
+     * proportional to the size of the smallest one. The elements are visited in the iteration order of that sparse_vector.
+     *
+     * The sparse_vectors must all use the same size type. Use join() to create a sparse_join_view.
+     *
+     * Creating a view of non-const sparse_vectors counts as a mutable access to all their elements, as with their own non-const iteration.
+     *
+     * The iterators refer to the sparse_vectors and not to the view, so they can outlive it, and sparse_join_view is a borrowed range.
+     *
+     * @warning As with the iterators of sparse_vector, inserting into or erasing from any of the sparse_vectors invalidates the view and its iterators.
+     */
+    template <typename... SparseVectors>
+    class sparse_join_view final : public std::ranges::view_interface<sparse_join_view<SparseVectors...>> {
+        static_assert(sizeof...(SparseVectors) > 0, "sparse_join_view: at least one sparse_vector is required");
+        static_assert((detail::is_sparse_vector<std::remove_const_t<SparseVectors>>::value && ...), "sparse_join_view: can only join sparse_vectors");
+
+        using FirstVector = std::remove_const_t<std::tuple_element_t<0, std::tuple<SparseVectors...>>>;
+
+    public:
+        using size_type = typename FirstVector::size_type;
+
+        static_assert((std::is_same_v<typename SparseVectors::size_type, size_type> && ...), "sparse_join_view: all sparse_vectors must have the same size type");
+
+    private:
+        // What the view and its iterators need to walk the sparse_vectors. The iterators keep a copy, so that they do not refer to the view.
+        struct walk {
+            std::tuple<SparseVectors*...> vectors;
+            std::size_t driver = 0;            // The sparse_vector that drives the iteration
+            const size_type* first = nullptr;  // Range of indices of the driving sparse_vector
+            const size_type* last = nullptr;
+        };
+
+    public:
+        class iterator {
+        public:
+            using iterator_concept = std::forward_iterator_tag;
+            using iterator_category = std::input_iterator_tag; // The reference type is a proxy
+            using value_type = std::tuple<size_type, std::conditional_t<std::is_const_v<SparseVectors>, const typename SparseVectors::value_type&, typename SparseVectors::value_type&>...>;
+            using reference = value_type;
+            using difference_type = std::ptrdiff_t;
+
+            iterator() noexcept = default;
+
+            [[nodiscard]] reference operator*() const noexcept
+            {
+                return dereference(std::index_sequence_for<SparseVectors...>{});
+            }
+
+            iterator& operator++() noexcept
+            {
+                ++cursor_;
+                skip_misses();
+                return *this;
+            }
+
+            iterator operator++(int) noexcept
+            {
+                auto result = *this;
+                ++*this;
+                return result;
+            }
+
+            [[nodiscard]] friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept
+            {
+                return lhs.cursor_ == rhs.cursor_;
+            }
+
+        private:
+            friend class sparse_join_view;
+
+            static constexpr size_type InvalidPos = FirstVector::InvalidPos;
+
+            iterator(const walk& walk, const size_type* cursor) noexcept
+                : walk_(walk)
+                , cursor_(cursor)
+            {
+                skip_misses();
+            }
+
+            // Advances until the cursor is at an index that is present in all the sparse_vectors, or at the end
+            void skip_misses() noexcept
+            {
+                for (; cursor_ != walk_.last; ++cursor_) {
+                    if (probe(std::index_sequence_for<SparseVectors...>{}))
+                        return;
+                }
+            }
+
+            template <std::size_t... Is>
+            bool probe(std::index_sequence<Is...>) noexcept
+            {
+                const auto index = *cursor_;
+                return ((positions_[Is] = Is == walk_.driver ? static_cast<size_type>(cursor_ - walk_.first) : std::get<Is>(walk_.vectors)->pos_.find(index),
+                            positions_[Is] != InvalidPos)
+                    && ...);
+            }
+
+            template <std::size_t... Is>
+            reference dereference(std::index_sequence<Is...>) const noexcept
+            {
+                return reference{*cursor_, std::get<Is>(walk_.vectors)->data_[positions_[Is]]...};
+            }
+
+            walk walk_;
+            const size_type* cursor_ = nullptr;
+            std::array<size_type, sizeof...(SparseVectors)> positions_{}; // Position of the current index in each sparse_vector
+        };
+
+        explicit sparse_join_view(SparseVectors&... vectors) noexcept
+            : walk_{.vectors{&vectors...}}
+        {
+            // Drive the iteration from the smallest sparse_vector
+            const std::array<std::size_t, sizeof...(SparseVectors)> sizes{vectors.index_.size()...};
+            const std::array<const size_type*, sizeof...(SparseVectors)> indices{vectors.index_.data()...};
+            walk_.driver = static_cast<std::size_t>(std::ranges::min_element(sizes) - sizes.begin());
+            walk_.first = indices[walk_.driver];
+            walk_.last = walk_.first + sizes[walk_.driver];
+
+            // Writes through the view bypass the per element bookkeeping, so like the other bulk mutable accessors, the non-const sparse_vectors are treated
+            // as all changed: their cached content hash is discarded, and all their elements are recorded as changed if they track changes
+            (
+                [&vectors] {
+                    if constexpr (!std::is_const_v<SparseVectors>)
+                        vectors.touch_all();
+                }(),
+                ...);
+        }
+
+        [[nodiscard]] iterator begin() const noexcept
+        {
+            return iterator{walk_, walk_.first};
+        }
+
+        [[nodiscard]] iterator end() const noexcept
+        {
+            return iterator{walk_, walk_.last};
+        }
+
+    private:
+        walk walk_;
+    };
+
+    /**
+     * Returns a view of the indices present in all the specified sparse_vectors, with references to their values
+     *
+     * @code
+     * for (auto [index, position, velocity] : ARo::join(positions, std::as_const(velocities)))
+     *     position += velocity;
+     * @endcode
+     */
+    template <typename... SparseVectors>
+    [[nodiscard]] sparse_join_view<SparseVectors...> join(SparseVectors&... vectors) noexcept
+    {
+        return sparse_join_view<SparseVectors...>{vectors...};
+    }
+
+} // namespace ARo
+
+// The iterators refer to the sparse_vectors rather than to the view, so they stay valid when the view is destroyed
+template <typename... SparseVectors>
+inline constexpr bool std::ranges::enable_borrowed_range<ARo::sparse_join_view<SparseVectors...>> = true;
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <mixedbag/exports.h>
+#include <mixedbag/detail/sparse_index.hxx>
+#include <mixedbag/detail/zip_iterator.hxx>
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ARo {
+
+    /**
+     * basic_sparse_multi_vector is a struct-of-arrays variant of sparse_vector, where each index maps to one value of each of the types Ts.
+     *
+     * All the columns share a single sparse index, so a lookup, insert or erase only touches the index once, however many columns there are.
+     * Each column is stored in its own contiguous vector, in the same order, so the columns can be iterated one at a time (for instance in
+     * loops that the compiler can vectorize) or zipped together.
+     *
+     * @tparam SizeT The size type, as for sparse_vector
+     * @tparam Checked Enable bounds checking if true
+     * @tparam PageSize The page size of the sparse index, zero for a flat index, or BitmapIndex, as for sparse_vector
+     * @tparam Ts The types of the columns
+     *
+     * @see sparse_multi_vector for the common case of std::size_t indices with bounds checking
+     */
+    template <typename SizeT, bool Checked, std::size_t PageSize, typename... Ts>
+    class MIXEDBAG_EXPORT basic_sparse_multi_vector final {
+        static_assert(sizeof...(Ts) > 0, "basic_sparse_multi_vector: at least one column type is required");
+
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+        using size_type = SizeT;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::tuple<Ts&...>;
+        using const_reference = std::tuple<const Ts&...>;
+        using iterator = detail::zip_iterator<Ts*...>;
+        using const_iterator = detail::zip_iterator<const Ts*...>;
+        using item_iterator = detail::zip_iterator<const SizeT*, Ts*...>;
+        using const_item_iterator = detail::zip_iterator<const SizeT*, const Ts*...>;
+
+        /** The type of the column with the specified number */
+        template <std::size_t Column>
+        using column_type = std::tuple_element_t<Column, std::tuple<Ts...>>;
+
+    public:
+        basic_sparse_multi_vector() noexcept = default;
+        basic_sparse_multi_vector(const basic_sparse_multi_vector& other) = default;
+        basic_sparse_multi_vector(basic_sparse_multi_vector&& other) noexcept = default;
+
+        explicit basic_sparse_multi_vector(const allocator_type& allocator)
+            : pos_(allocator)
+            , index_(allocator)
+            , columns_(std::allocator_arg, allocator)
+        {}
+
+        basic_sparse_multi_vector(const basic_sparse_multi_vector& other, const allocator_type& allocator)
+            : pos_(other.pos_, allocator)
+            , index_(other.index_, allocator)
+            , columns_(std::allocator_arg, allocator, other.columns_)
+        {}
+
+        basic_sparse_multi_vector(basic_sparse_multi_vector&& other, const allocator_type& allocator)
+            : pos_(std::move(other.pos_), allocator)
+            , index_(std::move(other.index_), allocator)
+            , columns_(std::allocator_arg, allocator, std::move(other.columns_))
+        {}
+
+        basic_sparse_multi_vector& operator=(const basic_sparse_multi_vector& other) = default;
+        basic_sparse_multi_vector& operator=(basic_sparse_multi_vector&& other) noexcept = default;
+
+        /** Returns the allocator in use */
+        allocator_type get_allocator() const
+        {
+            return index_.get_allocator();
+        }
+
+        ///@{
+        /**
+         * Inserts an element at the specified index, constructing each column from the corresponding argument, and returns references to the new values
+         *
+         * If constructing any of the values throws, the container is left unchanged.
+         */
+        template <typename... Us>
+            requires(sizeof...(Us) == sizeof...(Ts) && (std::is_constructible_v<Ts, Us&&> && ...))
+        reference insert(size_type index, Us&&... values)
+        {
+            if constexpr (Checked) {
+                if (index == InvalidPos)
+                    throw std::runtime_error("sparse_multi_vector: insert - index out of range");
+                if (pos_.find(index) != InvalidPos)
+                    throw std::runtime_error("sparse_multi_vector: insert - element already exists at specified index");
+            }
+
+            pos_.insert(index, static_cast<size_type>(index_.size()));
+            try {
+                index_.push_back(index);
+            } catch (...) {
+                pos_.reset(index);
+                throw;
+            }
+
+            std::size_t pushed = 0;
+            try {
+                [&]<std::size_t... Columns>(std::index_sequence<Columns...>) {
+                    ((std::get<Columns>(columns_).emplace_back(std::forward<Us>(values)), ++pushed), ...);
+                }(std::index_sequence_for<Ts...>{});
+            } catch (...) {
+                for_each_column([pushed, column = std::size_t{0}](auto& values) mutable {
+                    if (column++ < pushed)
+                        values.pop_back();
+                });
+                index_.pop_back();
+                pos_.reset(index);
+                throw;
+            }
+
+            return back();
+        }
+
+        /** Removes the element at the specified index, by moving the last element into its place in each column */
+        void erase(size_type index)
+        {
+            if (const auto toRemove = check_access(index); toRemove != index_.size() - 1) {
+                for_each_column([toRemove](auto& values) {
+                    using std::swap;
+                    swap(values[toRemove], values.back());
+                });
+
+                const auto movedIndex = index_.back();
+                index_[toRemove] = movedIndex;
+                pos_.set(movedIndex, toRemove);
+            }
+
+            for_each_column([](auto& values) { values.pop_back(); });
+            index_.pop_back();
+            pos_.reset(index);
+        }
+        ///@}
+
+        /** Returns the number of elements */
+        [[nodiscard]] size_type size() const noexcept
+        {
+            return static_cast<size_type>(index_.size());
+        }
+
+        /** Check for emptiness */
+        [[nodiscard]] bool empty() const noexcept
+        {
+            return index_.empty();
+        }
+
+        /** Returns true if there is an element at the specified index */
+        [[nodiscard]] bool contains(size_type index) const noexcept
+        {
+            return pos_.find(index) != InvalidPos;
+        }
+
+        ///@{
+        /** Allows increasing the capacity of the internal storage, to prevent unnecessary allocation */
+        void reserve_index(size_type size)
+        {
+            pos_.reserve(size);
+        }
+
+        void reserve_data(size_type size)
+        {
+            index_.reserve(size);
+            for_each_column([size](auto& values) { values.reserve(size); });
+        }
+        ///@}
+
+        ///@{
+        /** Access to all the values at the specified index */
+        [[nodiscard]] reference operator[](size_type index)
+        {
+            return at_pos(check_access(index));
+        }
+
+        [[nodiscard]] const_reference operator[](size_type index) const
+        {
+            return at_pos(check_access(index));
+        }
+        ///@}
+
+        ///@{
+        /** Access to the value in a single column at the specified index */
+        template <std::size_t Column>
+        [[nodiscard]] column_type<Column>& get(size_type index)
+        {
+            return std::get<Column>(columns_)[check_access(index)];
+        }
+
+        template <std::size_t Column>
+        [[nodiscard]] const column_type<Column>& get(size_type index) const
+        {
+            return std::get<Column>(columns_)[check_access(index)];
+        }
+        ///@}
+
+        ///@{
+        /**
+         * The values of a single column, as a contiguous array
+         *
+         * All columns, as well as indices(), hold the values of each element at the same position.
+         */
+        template <std::size_t Column>
+        [[nodiscard]] std::span<column_type<Column>> column() noexcept
+        {
+            return std::get<Column>(columns_);
+        }
+
+        template <std::size_t Column>
+        [[nodiscard]] std::span<const column_type<Column>> column() const noexcept
+        {
+            return std::get<Column>(columns_);
+        }
+
+        /** The index of each element, in the same order as the columns */
+        [[nodiscard]] std::span<const size_type> indices() const noexcept
+        {
+            return index_;
+        }
+        ///@}
+
+        ///@{
+        /** Zipped iteration, yielding a tuple of references to the values of each element */
+        [[nodiscard]] iterator begin() noexcept
+        {
+            return make_iterator<iterator>(0);
+        }
+
+        [[nodiscard]] iterator end() noexcept
+        {
+            return make_iterator<iterator>(index_.size());
+        }
+
+        [[nodiscard]] const_iterator begin() const noexcept
+        {
+            return make_iterator<const_iterator>(0);
+        }
+
+        [[nodiscard]] const_iterator end() const noexcept
+        {
+            return make_iterator<const_iterator>(index_.size());
+        }
+
+        [[nodiscard]] const_iterator cbegin() const noexcept
+        {
+            return begin();
+        }
+
+        [[nodiscard]] const_iterator cend() const noexcept
+        {
+            return end();
+        }
+        ///@}
+
+        ///@{
+        /**
+         * Zipped iteration, yielding a tuple holding the index followed by references to the values of each element
+         *
+         * @code
+         * for (auto [index, position, velocity] : v.items())
+         *     position += velocity;
+         * @endcode
+         */
+        [[nodiscard]] std::ranges::subrange<item_iterator> items() noexcept
+        {
+            return {make_item_iterator<item_iterator>(0), make_item_iterator<item_iterator>(index_.size())};
+        }
+
+        [[nodiscard]] std::ranges::subrange<const_item_iterator> items() const noexcept
+        {
+            return {make_item_iterator<const_item_iterator>(0), make_item_iterator<const_item_iterator>(index_.size())};
+        }
+        ///@}
+
+    private:
+        using index_type = detail::sparse_index_for<SizeT, PageSize>;
+
+        static constexpr size_type InvalidPos = index_type::InvalidPos;
+
+        template <typename Func>
+        void for_each_column(Func&& func)
+        {
+            std::apply([&func](auto&... values) { (func(values), ...); }, columns_);
+        }
+
+        reference back() noexcept
+        {
+            return at_pos(index_.size() - 1);
+        }
+
+        reference at_pos(std::size_t pos) noexcept
+        {
+            return std::apply([pos](auto&... values) { return reference{values[pos]...}; }, columns_);
+        }
+
+        const_reference at_pos(std::size_t pos) const noexcept
+        {
+            return std::apply([pos](const auto&... values) { return const_reference{values[pos]...}; }, columns_);
+        }
+
+        template <typename It>
+        It make_iterator(std::size_t pos) const noexcept
+        {
+            return std::apply([pos](auto&... values) { return It{const_cast<Ts*>(values.data()) + pos...}; }, columns_);
+        }
+
+        template <typename It>
+        It make_item_iterator(std::size_t pos) const noexcept
+        {
+            return std::apply([this, pos](auto&... values) { return It{index_.data() + pos, const_cast<Ts*>(values.data()) + pos...}; }, columns_);
+        }
+
+        // Returns the position of an index, which must be present unless Checked is true. The index is looked up once either way.
+        size_type check_access(size_type index) const
+        {
+            if constexpr (Checked) {
+                if (pos_.extent() <= index)
+                    throw std::runtime_error("sparse_multi_vector: access - index out of range");
+
+                const auto pos = pos_.find(index);
+                if (pos == InvalidPos)
+                    throw std::runtime_error("sparse_multi_vector: access - no data at specified index");
+                return pos;
+            } else {
+                return pos_[index];
+            }
+        }
+
+        index_type pos_;                              // Position in the columns for each index, or InvalidPos
+        std::pmr::vector<size_type> index_;           // Index for each position in the columns
+        std::tuple<std::pmr::vector<Ts>...> columns_; // The values, one vector per column
+    };
+
+    /** A basic_sparse_multi_vector with std::size_t indices, bounds checking and a flat index */
+    template <typename... Ts>
+    using sparse_multi_vector = basic_sparse_multi_vector<std::size_t, true, 0, Ts...>;
+
+} // namespace ARo
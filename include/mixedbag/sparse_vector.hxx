@@ -1,34 +1,115 @@
 #pragma once
 
 #include <mixedbag/exports.h>
+#include <mixedbag/detail/change_tracker.hxx>
+#include <mixedbag/detail/hash_cache.hxx>
+#include <mixedbag/detail/item_iterator.hxx>
+#include <mixedbag/detail/snapshot.hxx>
+#include <mixedbag/detail/sparse_index.hxx>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <compare>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory_resource>
+#include <numeric>
+#include <ostream>
+#include <ranges>
+#include <span>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace ARo {
 
+    template <typename... SparseVectors>
+    class sparse_join_view;
+
     /**
      * sparse_vector is a container for storing index value pairs, intended for fast unordered iteration of the values.
      *
      * The power of this kind of container is that you get very fast unordered iteration over the values, since they are stored in a contiguous vector.
+     * Each element also remembers which index it belongs to, so erasing is done in constant time by moving the last element into the hole.
      *
      * @note This is really an associative container, so the name is a bit misleading, but it is what this kind of container is referred to if you search for it.
      *
      * @tparam T The type of elements to store in the sparse_vector
      * @tparam SizeT The size type - it defaults to std::size_t, but if you know the upper bounds on the index it might make sense to use a smaller type that fits (since you can never have more elements than you can index).
      * @tparam Checked Enable bounds checking if true.
+     * @tparam PageSize If non-zero, the index is split into pages of this many entries (which must be a power of two), that are allocated when first used and freed when they become empty.
+     *                  This keeps the memory used by the index proportional to the number of elements rather than to the largest index, at the cost of some extra bookkeeping on insert and erase.
+     *                  If zero, the index is a single array that grows to fit the largest index ever used.
+     *                  If BitmapIndex, the index is a compressed bitmap of the indices present, and positions are found by counting the indices before them,
+     *                  so that its memory is proportional to the number of elements however far apart they are, at the cost of slower lookups and inserts
+     *                  (see detail::bitmap_sparse_index). This suits a few thousand elements spread over a 32 bit index range. It does not support GenerationBits.
+     * @tparam GenerationBits If non-zero, this many of the most significant bits of each index entry hold a generation counter that is advanced whenever the element at that index is erased.
+     *                        This enables handles, that detect when the element they were taken from has since been erased, even if the index has been reused.
+     *                        The generation is checked using the same load as the position, so it costs no additional memory access. The number of elements is limited
+     *                        to what fits in the remaining bits, and a paged index no longer frees pages that become empty, since they hold the generations.
+     * @tparam TrackChanges If true, inserts, mutable accesses and erases are recorded per epoch, so that the changes since an earlier epoch can be found without
+     *                      looking at every element (see changed_since()). This costs a stamp per element, and a log entry per change. If false, nothing
+     *                      is recorded and nothing is stored.
+     * @tparam CacheHash If true, content_hash() is cached until the next non-const access, and equal_with_hash() is available. This costs a word, and a store
+     *                   on each non-const access. If false, nothing is stored.
      */
-    template <typename T, typename SizeT = std::size_t, bool Checked = true>
+    template <typename T, typename SizeT = std::size_t, bool Checked = true, std::size_t PageSize = 0, unsigned GenerationBits = 0, bool TrackChanges = false,
+              bool CacheHash = false>
     class MIXEDBAG_EXPORT sparse_vector final {
+        static_assert(PageSize != BitmapIndex || GenerationBits == 0, "sparse_vector: a BitmapIndex can not hold generations");
+
     public:
         using allocator_type = std::pmr::polymorphic_allocator<>;
         using iterator = typename std::pmr::vector<T>::iterator;
         using const_iterator = typename std::pmr::vector<T>::const_iterator;
+        using item_iterator = detail::item_iterator<SizeT, T>;
+        using const_item_iterator = detail::item_iterator<SizeT, const T>;
+
+        template <bool Const>
+        class ordered_iterator;
+        class change_iterator;
         using value_type = typename std::pmr::vector<T>::value_type;
         using reference = typename std::pmr::vector<T>::reference;
         using pointer = typename std::pmr::vector<T>::pointer;
         using difference_type = typename std::pmr::vector<T>::difference_type;
         using size_type = SizeT;
+        using epoch_type = std::uint64_t;
+
+        /**
+         * Refers to the element at an index, as long as that element has not been erased (see GenerationBits)
+         *
+         * A handle is taken with handle_of(), and stays valid until the element is erased, even if other elements are inserted or erased, or the element is moved.
+         */
+        struct handle {
+            size_type index = 0;
+            size_type generation = 0;
+
+            [[nodiscard]] friend bool operator==(const handle& lhs, const handle& rhs) noexcept = default;
+        };
+
+        /**
+         * The memory held by a sparse_vector, see memory_usage()
+         *
+         * Only the memory of the sparse_vector itself is counted, not memory that the elements allocate themselves.
+         */
+        struct memory_stats {
+            std::size_t indexBytes = 0;         // Bytes of the index in use
+            std::size_t indexCapacityBytes = 0; // Bytes allocated for the index
+            std::size_t dataBytes = 0;          // Bytes of the elements and of the index of each element
+            std::size_t dataCapacityBytes = 0;  // Bytes allocated for the elements and the index of each element
+            std::size_t trackingBytes = 0;      // Bytes allocated for change tracking, if TrackChanges is true
+
+            /** Returns the total number of bytes allocated */
+            [[nodiscard]] std::size_t total_bytes() const noexcept
+            {
+                return indexCapacityBytes + dataCapacityBytes + trackingBytes;
+            }
+        };
 
     public:
         sparse_vector() noexcept = default;
@@ -37,19 +118,40 @@ namespace ARo {
 
         explicit sparse_vector(const allocator_type &allocator)
             : pos_(allocator)
+            , index_(allocator)
             , data_(allocator)
+            , changes_(allocator)
         {}
 
         sparse_vector(const sparse_vector& other, const allocator_type& allocator)
             : pos_(other.pos_, allocator)
+            , index_(other.index_, allocator)
             , data_(other.data_, allocator)
+            , hash_(other.hash_)
+            , changes_(other.changes_, allocator)
         {}
 
         sparse_vector(sparse_vector&& other, allocator_type& allocator) noexcept
             : pos_(std::move(other.pos_), allocator)
+            , index_(std::move(other.index_), allocator)
             , data_(std::move(other.data_), allocator)
+            , hash_(std::move(other.hash_))
+            , changes_(std::move(other.changes_), allocator)
         {}
 
+        /**
+         * Constructs a sparse_vector from a range of index value pairs, in any order
+         *
+         * @see insert_range
+         */
+        template <std::ranges::input_range R>
+            requires(!std::same_as<std::remove_cvref_t<R>, sparse_vector> && detail::index_value_pair<std::ranges::range_reference_t<R>, SizeT>)
+        explicit sparse_vector(R&& pairs, const allocator_type& allocator = {})
+            : sparse_vector(allocator)
+        {
+            insert_range(std::forward<R>(pairs));
+        }
+
         ///@{
 
         /**
@@ -61,7 +163,10 @@ namespace ARo {
                 return *this;
 
             pos_ = other.pos_;
+            index_ = other.index_;
             data_ = other.data_;
+            hash_ = other.hash_;
+            changes_ = other.changes_;
             return *this;
         }
 
@@ -71,7 +176,10 @@ namespace ARo {
                 return *this;
 
             pos_ = std::move(other.pos_);
+            index_ = std::move(other.index_);
             data_ = std::move(other.data_);
+            hash_ = std::move(other.hash_);
+            changes_ = std::move(other.changes_);
             return *this;
         }
         ///@}
@@ -83,41 +191,183 @@ namespace ARo {
         }
 
         ///@{
-        /** Inserts an element at the specified index by constructing it in place, and returns it by reference */
+        /**
+         * Inserts an element at the specified index by constructing it in place from args, and returns it by reference
+         *
+         * If the insertion fails, for instance because the constructor of T throws, the sparse_vector is left unchanged.
+         */
         template <typename... Args>
-        reference emplace(size_type index, Args... args)
+        reference emplace(size_type index, Args&&... args)
         {
-            prepare_insert(index);
-
-            data_.emplace_back(std::forward<Args...>(args...));
-            return data_.back();
+            check_insert(index);
+            return append(index, std::forward<Args>(args)...);
         }
 
         /** Inserts an element at the specified index by copy, and returns it by reference */
         reference insert(size_type index, const value_type& val)
         {
-            prepare_insert(index);
+            check_insert(index);
+            return append(index, val);
+        }
 
-            data_.push_back(val);
-            return data_.back();
+        /** Inserts an element at the specified index by move, and returns it by reference */
+        reference insert(size_type index, value_type&& val)
+        {
+            check_insert(index);
+            return append(index, std::move(val));
+        }
+
+        /**
+         * Inserts an element constructed from args at the specified index, unless there already is an element there
+         *
+         * If there is, nothing is constructed and args are not moved from, and this is not an error even if Checked is true.
+         * The index is looked up only once either way.
+         *
+         * @returns the element at the index, and true if it was inserted
+         */
+        template <typename... Args>
+        std::pair<reference, bool> try_emplace(size_type index, Args&&... args)
+        {
+            if (const auto pos = pos_.find(index); pos != InvalidPos) {
+                touch(pos, index);
+                return {data_[pos], false};
+            }
+
+            check_new_index(index);
+            return {append(index, std::forward<Args>(args)...), true};
+        }
+
+        /**
+         * Assigns value to the element at the specified index, or inserts it if there is no element there
+         *
+         * @returns the element at the index, and true if it was inserted
+         */
+        template <typename M>
+            requires std::is_assignable_v<reference, M&&> && std::is_constructible_v<value_type, M&&>
+        std::pair<reference, bool> insert_or_assign(size_type index, M&& value)
+        {
+            if (const auto pos = pos_.find(index); pos != InvalidPos) {
+                touch(pos, index);
+                data_[pos] = std::forward<M>(value);
+                return {data_[pos], false};
+            }
+
+            check_new_index(index);
+            return {append(index, std::forward<M>(value)), true};
+        }
+
+        /**
+         * Inserts all elements of a range of index value pairs (such as std::pair or std::tuple), in any order
+         *
+         * If the range can be traversed more than once, the index and the data storage are grown once up front, instead of once per element.
+         * The values are moved from the range if it yields rvalues.
+         * If an insertion fails, the elements inserted before it are kept. If Checked is true, an index that is out of range is reported before anything is inserted
+         * or grown, if the range can be traversed more than once.
+         */
+        template <std::ranges::input_range R>
+            requires detail::index_value_pair<std::ranges::range_reference_t<R>, SizeT>
+        void insert_range(R&& pairs)
+        {
+            if constexpr (std::ranges::forward_range<R>) {
+                std::size_t count = 0;
+                std::size_t extent = 0;
+                for (auto&& pair : pairs) {
+                    // Checked before growing, so that an invalid index does not grow the index to its largest size, or wrap the extent around
+                    const auto index = pair_index(pair);
+                    if constexpr (Checked) {
+                        if (index == InvalidPos)
+                            throw std::runtime_error("sparse_vector: insert - index out of range");
+                    }
+                    ++count;
+                    extent = std::max(extent, static_cast<std::size_t>(index) + 1);
+                }
+
+                pos_.grow(extent);
+                grow_data(count);
+            }
+
+            for (auto&& pair : pairs) {
+                const auto index = pair_index(pair);
+                check_insert(index);
+                append(index, std::get<1>(std::forward<decltype(pair)>(pair)));
+            }
         }
 
         /** Removes the element at the specified index */
         void erase(size_type index)
         {
-            check_access(index);
-            if (pos_[index] != data_.size() - 1) {
+            const auto toRemove = check_access(index);
+            hash_.reset();
+            changes_.on_erase(index);
+            if (toRemove != data_.size() - 1) {
                 // Swap the element to delete with the one in the back of data_
-                const auto toRemove = pos_[index];
                 std::swap(data_[toRemove], data_.back());
 
                 // Update the index of the one that was previously at the back
-                const auto it = std::ranges::find(pos_, data_.size() - 1);
-                *it = pos_[index];
+                const auto movedIndex = index_.back();
+                index_[toRemove] = movedIndex;
+                pos_.set(movedIndex, toRemove);
             }
 
+            changes_.on_swap_remove(toRemove);
             data_.pop_back();
-            pos_[index] = InvalidPos;
+            index_.pop_back();
+            pos_.reset(index);
+        }
+
+        /**
+         * Removes all elements for which the predicate returns true, in a single pass over the data
+         *
+         * Unlike erase(), this keeps the relative order of the remaining elements.
+         * If the predicate throws, the elements it has already selected are removed, and the rest are kept.
+         *
+         * @returns the number of removed elements
+         */
+        template <typename Predicate>
+        size_type erase_if(Predicate pred)
+        {
+            hash_.reset();
+            std::size_t kept = 0;
+            std::size_t i = 0;
+            try {
+                for (; i < data_.size(); ++i) {
+                    if (pred(std::as_const(data_[i]))) {
+                        changes_.on_erase(index_[i]);
+                        pos_.reset(index_[i]);
+                    } else {
+                        relocate(i, kept++);
+                    }
+                }
+            } catch (...) {
+                for (; i < data_.size(); ++i)
+                    relocate(i, kept++);
+                truncate(kept);
+                throw;
+            }
+
+            const auto removed = static_cast<size_type>(data_.size() - kept);
+            truncate(kept);
+            return removed;
+        }
+        ///@}
+
+        ///@{
+        /**
+         * Reorders the elements in place, so that iteration visits them in ascending index order
+         *
+         * This is useful after many erase() calls have scrambled the order, when the values are processed together with other data ordered by index.
+         * Iteration order is not kept up to date by later inserts and erases.
+         */
+        void sort()
+        {
+            sort_positions([this](size_type lhs, size_type rhs) { return index_[lhs] < index_[rhs]; });
+        }
+
+        /** Reorders the elements in place, so that iteration visits them in the order defined by comp (the order of equivalent values is unspecified) */
+        template <typename Compare>
+        void sort(Compare comp)
+        {
+            sort_positions([this, &comp](size_type lhs, size_type rhs) { return comp(std::as_const(data_[lhs]), std::as_const(data_[rhs])); });
         }
         ///@}
 
@@ -142,22 +392,208 @@ namespace ARo {
 
         void reserve_data(size_type size)
         {
+            index_.reserve(size);
             data_.reserve(size);
         }
         ///@}
 
+        /** Returns the number of bytes used and allocated by the index, the elements and the change tracking */
+        [[nodiscard]] memory_stats memory_usage() const noexcept
+        {
+            return {
+                .indexBytes = pos_.used_bytes(),
+                .indexCapacityBytes = pos_.allocated_bytes(),
+                .dataBytes = data_.size() * (sizeof(T) + sizeof(size_type)),
+                .dataCapacityBytes = data_.capacity() * sizeof(T) + index_.capacity() * sizeof(size_type),
+                .trackingBytes = changes_.allocated_bytes(),
+            };
+        }
+
+        /**
+         * Releases memory that is not in use: the entries at the end of the index past the largest index present, and any spare capacity
+         *
+         * Nothing is renumbered, so the elements keep their indices and handles stay valid. Like for std::vector, iterators and references
+         * to elements are invalidated if their storage is reallocated.
+         */
+        void shrink_to_fit()
+        {
+            pos_.shrink_to_fit();
+            index_.shrink_to_fit();
+            data_.shrink_to_fit();
+            changes_.shrink_to_fit();
+        }
+
+        /**
+         * Like shrink_to_fit(), but also rebuilds the parts of the index that have a smaller form, which takes longer
+         *
+         * With a BitmapIndex, blocks that are stored as bitmaps but have become sparse enough are converted to arrays.
+         * The other indices have only one form, so for them this is the same as shrink_to_fit().
+         */
+        void compact()
+        {
+            if constexpr (PageSize == BitmapIndex)
+                pos_.compact();
+            shrink_to_fit();
+        }
+
         ///@{
         /** Element access */
         [[nodiscard]] const value_type& operator[](size_type index) const
         {
-            check_access(index);
-            return data_[pos_[index]];
+            return data_[check_access(index)];
         }
 
         [[nodiscard]] value_type& operator[](size_type index)
+        {
+            const auto pos = check_access(index);
+            touch(pos, index);
+            return data_[pos];
+        }
+        ///@}
+
+        /** Returns true if there is an element at the specified index. Unlike operator[], this never throws, regardless of Checked. */
+        [[nodiscard]] bool contains(size_type index) const noexcept
+        {
+            return pos_.find(index) != InvalidPos;
+        }
+
+        ///@{
+        /** Returns an iterator to the element at the specified index, or end() if there is none, without throwing regardless of Checked */
+        [[nodiscard]] const_iterator find(size_type index) const noexcept
+        {
+            const auto pos = pos_.find(index);
+            return pos != InvalidPos ? data_.cbegin() + static_cast<difference_type>(pos) : data_.cend();
+        }
+
+        [[nodiscard]] iterator find(size_type index) noexcept(!TrackChanges)
+        {
+            const auto pos = pos_.find(index);
+            if (pos == InvalidPos)
+                return data_.end();
+            touch(pos, index);
+            return data_.begin() + static_cast<difference_type>(pos);
+        }
+        ///@}
+
+        ///@{
+        /** Returns a pointer to the element at the specified index, or nullptr if there is none, without throwing regardless of Checked */
+        [[nodiscard]] const value_type* get_if(size_type index) const noexcept
+        {
+            const auto pos = pos_.find(index);
+            return pos != InvalidPos ? data_.data() + pos : nullptr;
+        }
+
+        [[nodiscard]] value_type* get_if(size_type index) noexcept(!TrackChanges)
+        {
+            const auto pos = pos_.find(index);
+            if (pos == InvalidPos)
+                return nullptr;
+            touch(pos, index);
+            return data_.data() + pos;
+        }
+        ///@}
+
+        ///@{
+        /**
+         * Access through handles, only available if GenerationBits is non-zero
+         *
+         * handle_of() returns a handle to the element at the specified index. Accessing an element through a handle whose element has been erased throws if Checked is true,
+         * and is undefined otherwise. contains() never throws, and returns false for such a handle.
+         */
+        [[nodiscard]] handle handle_of(size_type index) const
+            requires(GenerationBits > 0)
         {
             check_access(index);
-            return data_[pos_[index]];
+            return {index, pos_.generation(index)};
+        }
+
+        [[nodiscard]] bool contains(const handle& h) const noexcept
+            requires(GenerationBits > 0)
+        {
+            return pos_.find(h.index, h.generation) != InvalidPos;
+        }
+
+        [[nodiscard]] const value_type& operator[](const handle& h) const
+            requires(GenerationBits > 0)
+        {
+            return data_[checked_pos(h)];
+        }
+
+        [[nodiscard]] value_type& operator[](const handle& h)
+            requires(GenerationBits > 0)
+        {
+            const auto pos = checked_pos(h);
+            touch(pos, h.index);
+            return data_[pos];
+        }
+        ///@}
+
+        ///@{
+        /**
+         * Batched lookup of many indices at once
+         *
+         * The indices are resolved in blocks, where the index entries of a whole block are prefetched before they are read, and then the values before they are accessed,
+         * so that the cache misses of the lookups overlap instead of being taken one at a time. Indices that are not present are reported instead of thrown, whatever
+         * the setting of Checked.
+         *
+         * find_many() stores a pointer to the value of each index in out, or nullptr if it is not present.
+         *
+         * @returns the number of indices that were found
+         * @throws std::invalid_argument if out is smaller than indices
+         */
+        size_type find_many(std::span<const size_type> indices, std::span<const value_type*> out) const
+        {
+            if (out.size() < indices.size())
+                throw std::invalid_argument("sparse_vector: find_many - output is smaller than the number of indices");
+
+            return resolve_batched(indices, [&out, this](std::size_t first, std::size_t count, const size_type* positions, std::uint64_t) {
+                for (std::size_t i = 0; i < count; ++i)
+                    out[first + i] = positions[i] == InvalidPos ? nullptr : data_.data() + positions[i];
+            });
+        }
+
+        size_type find_many(std::span<const size_type> indices, std::span<value_type*> out)
+        {
+            if (out.size() < indices.size())
+                throw std::invalid_argument("sparse_vector: find_many - output is smaller than the number of indices");
+
+            return resolve_batched(indices, [&out, &indices, this](std::size_t first, std::size_t count, const size_type* positions, std::uint64_t) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    out[first + i] = positions[i] == InvalidPos ? nullptr : data_.data() + positions[i];
+                    if (positions[i] != InvalidPos)
+                        touch(positions[i], indices[first + i]);
+                }
+            });
+        }
+
+        /**
+         * gather() copies the value of each present index into the same position in out, and leaves the other positions of out unchanged.
+         *
+         * Bit i % 64 of missMask[i / 64] is set if indices[i] is not present, and cleared otherwise. missMask must hold at least miss_mask_size(indices.size()) words.
+         *
+         * @returns the number of indices that were found
+         * @throws std::invalid_argument if out or missMask is too small
+         */
+        size_type gather(std::span<const size_type> indices, std::span<value_type> out, std::span<std::uint64_t> missMask) const
+        {
+            if (out.size() < indices.size())
+                throw std::invalid_argument("sparse_vector: gather - output is smaller than the number of indices");
+            if (missMask.size() < miss_mask_size(indices.size()))
+                throw std::invalid_argument("sparse_vector: gather - miss mask is too small");
+
+            return resolve_batched(indices, [&out, &missMask, this](std::size_t first, std::size_t count, const size_type* positions, std::uint64_t misses) {
+                missMask[first / BatchSize] = misses;
+                for (std::size_t i = 0; i < count; ++i) {
+                    if (positions[i] != InvalidPos)
+                        out[first + i] = data_[positions[i]];
+                }
+            });
+        }
+
+        /** Returns the number of words needed in the miss mask passed to gather() for count indices */
+        [[nodiscard]] static constexpr std::size_t miss_mask_size(std::size_t count) noexcept
+        {
+            return (count + BatchSize - 1) / BatchSize;
         }
         ///@}
 
@@ -165,10 +601,22 @@ namespace ARo {
         /** Iteration */
         [[nodiscard]] iterator begin() noexcept
         {
+            touch_all();
             return data_.begin();
         }
 
         [[nodiscard]] iterator end() noexcept
+        {
+            touch_all();
+            return data_.end();
+        }
+
+        [[nodiscard]] const_iterator begin() const noexcept
+        {
+            return data_.begin();
+        }
+
+        [[nodiscard]] const_iterator end() const noexcept
         {
             return data_.end();
         }
@@ -186,32 +634,120 @@ namespace ARo {
 
         ///@{
         /**
-         * Comparison
+         * Iteration over (index, value) pairs, in the same order as begin() and end()
          *
-         * @warning Comparing sparse_vectors is slow, and should be avoided
+         * The pairs hold the value by reference, so it can be modified through them:
+         * @code
+         * for (auto [index, value] : v.items())
+         *     value += index;
+         * @endcode
          */
-        [[nodiscard]] auto operator<=>(const sparse_vector& other) const noexcept -> std::compare_three_way_result_t<value_type>
+        [[nodiscard]] std::ranges::subrange<item_iterator> items() noexcept
         {
-            using ResultType = std::compare_three_way_result_t<value_type>;
+            touch_all();
+            return {item_iterator{index_.data(), data_.data()}, item_iterator{index_.data() + index_.size(), data_.data() + data_.size()}};
+        }
 
-            const auto minLen = std::min(pos_.size(), other.pos_.size());
-            for (auto i = size_type{0}; i < minLen; ++i) {
-                if (pos_[i] == InvalidPos && other.pos_[i] == InvalidPos)
-                    continue;
-                if (pos_[i] == InvalidPos)
-                    return ResultType::greater;
-                if (other.pos_[i] == InvalidPos)
-                    return ResultType::less;
-                if (auto cmpResult = data_[pos_[i]] <=> other.data_[other.pos_[i]]; cmpResult != ResultType::equal)
-                    return cmpResult;
-            }
+        [[nodiscard]] std::ranges::subrange<const_item_iterator> items() const noexcept
+        {
+            return {const_item_iterator{index_.data(), data_.data()}, const_item_iterator{index_.data() + index_.size(), data_.data() + data_.size()}};
+        }
+
+        ///@{
+        /**
+         * Iteration over (index, value) pairs, in ascending index order, regardless of the order of the values in storage
+         *
+         * This scans the sparse index, so the cost depends on the range of indices in use rather than the number of elements (although empty pages are skipped
+         * when the index is paged). When the whole container is processed repeatedly in index order, calling sort() once and using items() is cheaper.
+         */
+        [[nodiscard]] std::ranges::subrange<ordered_iterator<false>> ordered_items() noexcept
+        {
+            touch_all();
+            return {ordered_iterator<false>{this, 0}, ordered_iterator<false>{this, pos_.extent()}};
+        }
+
+        [[nodiscard]] std::ranges::subrange<ordered_iterator<true>> ordered_items() const noexcept
+        {
+            return {ordered_iterator<true>{this, 0}, ordered_iterator<true>{this, pos_.extent()}};
+        }
+        ///@}
+
+        ///@{
+        /**
+         * Calls func(index, value) for each element, in the same order as begin() and end()
+         *
+         * To run it with a standard execution policy, use ARo::each() from sparse_vector_execution.hxx.
+         */
+        template <typename Func>
+        void each(Func func)
+        {
+            touch_all();
+            for (std::size_t i = 0; i < data_.size(); ++i)
+                func(index_[i], data_[i]);
+        }
+
+        template <typename Func>
+        void each(Func func) const
+        {
+            for (std::size_t i = 0; i < data_.size(); ++i)
+                func(index_[i], data_[i]);
+        }
+        ///@}
+
+        ///@{
+        /**
+         * Splits the values into consecutive slices of chunkSize elements (the last one may be shorter), for distributing work over threads
+         *
+         * The result is a random access range of std::span, which stays valid until an element is inserted or erased.
+         *
+         * @throws std::invalid_argument if chunkSize is zero
+         */
+        [[nodiscard]] auto chunks(std::size_t chunkSize)
+        {
+            touch_all();
+            return make_chunks(std::span<T>(data_), chunkSize);
+        }
+
+        [[nodiscard]] auto chunks(std::size_t chunkSize) const
+        {
+            return make_chunks(std::span<const T>(data_), chunkSize);
+        }
+
+        /** Like chunks(), but each slice is a range of (index, value) pairs as returned by items() */
+        [[nodiscard]] auto item_chunks(std::size_t chunkSize)
+        {
+            touch_all();
+            return make_chunks(items(), chunkSize);
+        }
+
+        [[nodiscard]] auto item_chunks(std::size_t chunkSize) const
+        {
+            return make_chunks(items(), chunkSize);
+        }
+        ///@}
 
-            if (data_.size() < other.data_.size())
-                return ResultType::less;
-            if (data_.size() > other.data_.size())
-                return ResultType::greater;
+        ///@{
+        /**
+         * Comparison
+         *
+         * Elements are compared in ascending index order, first by index and then by value, so a sparse_vector is ordered like the sequence of its (index, value) pairs.
+         * A sparse_vector whose pairs are a prefix of those of another is smaller.
+         *
+         * @note This differs from earlier versions, which walked the index up to the smaller extent and so could order a sparse_vector with an element past the
+         *       last element of the other as smaller, depending on the extent left by erased elements. operator<=> is also no longer noexcept, since it may allocate.
+         *
+         * Equality is checked in time proportional to the number of elements, by looking up each element of one sparse_vector in the other, and is rejected at once if
+         * the sizes differ. Ordering walks the sparse index when it is dense, and otherwise sorts the
+         * positions of the elements of both sparse_vectors by index, which allocates temporary storage.
+         */
+        [[nodiscard]] auto operator<=>(const sparse_vector& other) const -> std::compare_three_way_result_t<value_type>
+        {
+            // Walking the index costs one step per index up to the smaller extent, sorting costs n log n per element
+            const auto walkLength = std::min(pos_.extent(), other.pos_.extent());
+            if (walkLength <= DenseCompareFactor * (data_.size() + other.data_.size()))
+                return compare_by_index(other, walkLength);
 
-            return ResultType::equal;
+            return compare_sorted(other);
         }
 
         [[nodiscard]] bool operator==(const sparse_vector& other) const noexcept
@@ -219,13 +755,10 @@ namespace ARo {
             if (data_.size() != other.data_.size())
                 return false;
 
-            const auto minLen = std::min(pos_.size(), other.pos_.size());
-            for (auto i = size_type{0}; i < minLen; ++i) {
-                if (pos_[i] == InvalidPos && other.pos_[i] == InvalidPos)
-                    continue;
-                if (pos_[i] == InvalidPos || other.pos_[i] == InvalidPos)
-                    return false;
-                if (data_[pos_[i]] != other.data_[other.pos_[i]])
+            // Same number of elements, so if all of ours are in other the index sets are the same
+            for (std::size_t i = 0; i < data_.size(); ++i) {
+                const auto otherPos = other.pos_.find(index_[i]);
+                if (otherPos == InvalidPos || !(data_[i] == other.data_[otherPos]))
                     return false;
             }
 
@@ -233,38 +766,651 @@ namespace ARo {
         }
         ///@}
 
+        /**
+         * Returns a hash of the indices and values, that does not depend on the order of the elements in storage
+         *
+         * If CacheHash is true, the hash is computed on the first call and cached, and the cache is discarded by any non-const access (including non-const
+         * iteration and operator[]), since the values might be modified through it. The cache is atomic, so like the other const member functions,
+         * content_hash() can be called from several threads at once.
+         *
+         * Like change tracking, the cache only sees mutable access when it is taken, so a value written through a reference, iterator or span taken before
+         * content_hash() was called is not reflected in the cached hash. Take them again after calling content_hash().
+         */
+        [[nodiscard]] std::size_t content_hash() const
+            requires requires(const T& value) { { std::hash<T>{}(value) } -> std::convertible_to<std::size_t>; }
+        {
+            if (const auto cached = hash_.get(); cached != 0)
+                return cached;
+
+            std::size_t hash = 0;
+            for (std::size_t i = 0; i < data_.size(); ++i)
+                hash += detail::mix_hash(static_cast<std::size_t>(index_[i]), std::hash<T>{}(data_[i]));
+            hash_.set(hash);
+            return hash;
+        }
+
+        /**
+         * Equality, that first compares the content_hash() of both sparse_vectors, and so rejects most unequal pairs in constant time once both are cached
+         * (which is useful when comparing against a snapshot that is kept unmodified), only available if CacheHash is true
+         *
+         * @pre No value of either sparse_vector has been written through a reference, iterator or span taken before its hash was cached, since the cached hash
+         *      does not reflect such writes (see content_hash()). If that can not be ruled out, use operator==, which never looks at the cache.
+         */
+        [[nodiscard]] bool equal_with_hash(const sparse_vector& other) const
+            requires CacheHash && requires(const T& value) { { std::hash<T>{}(value) } -> std::convertible_to<std::size_t>; }
+        {
+            return data_.size() == other.data_.size() && content_hash() == other.content_hash() && *this == other;
+        }
+
+        ///@{
+        /**
+         * Change tracking, only available if TrackChanges is true
+         *
+         * Each insert, mutable access and erase is recorded in the current epoch(). next_epoch() starts a new epoch, and returns the one that ended, so that
+         * the changes made after it can be found later:
+         *
+         * @code
+         * const auto sent = v.next_epoch();
+         * for (auto index : v.erased_since(lastSent))
+         *     sendErase(index);
+         * for (auto [index, value] : v.changed_since(lastSent))
+         *     sendValue(index, value);
+         * v.discard_changes(lastSent);
+         * lastSent = sent;
+         * @endcode
+         *
+         * Element access through operator[] and find_many() records a change to that element only. Mutable iteration, such as through begin(), items() or each(),
+         * records a change to all the elements, so iterate through a const reference when the values are not modified.
+         */
+        [[nodiscard]] epoch_type epoch() const noexcept
+            requires TrackChanges
+        {
+            return changes_.epoch();
+        }
+
+        /** Starts a new epoch, and returns the previous one */
+        epoch_type next_epoch() noexcept
+            requires TrackChanges
+        {
+            return changes_.next_epoch();
+        }
+
+        /**
+         * Returns a forward range of (index, value) pairs for the elements that have been inserted or accessed mutably after the specified epoch
+         *
+         * Each element is visited once, even if it was changed in several epochs. The cost is proportional to the number of changes rather than the number of elements,
+         * unless all elements have been accessed mutably since the epoch.
+         */
+        [[nodiscard]] std::ranges::subrange<change_iterator> changed_since(epoch_type epoch) const noexcept
+            requires TrackChanges
+        {
+            if (changes_.all_changed() > epoch)
+                return {change_iterator{this, 0}, change_iterator{this, data_.size()}};
+
+            const auto log = changes_.changed_since(epoch);
+            return {change_iterator{this, log.data(), log.data() + log.size()}, change_iterator{this, log.data() + log.size(), log.data() + log.size()}};
+        }
+
+        /**
+         * Returns a range of the indices erased after the specified epoch, in the order they were erased
+         *
+         * An index that has been erased and then inserted again is also part of changed_since(), so the erases should be applied before the changes.
+         * An index may be listed more than once, if it has been erased several times.
+         */
+        [[nodiscard]] auto erased_since(epoch_type epoch) const noexcept
+            requires TrackChanges
+        {
+            return changes_.erased_since(epoch) | std::views::transform(&detail::change_entry<SizeT>::index);
+        }
+
+        /**
+         * Frees the records of the changes in the specified epoch and earlier
+         *
+         * After this, changed_since() and erased_since() are incomplete for earlier epochs than the specified one.
+         */
+        void discard_changes(epoch_type epoch)
+            requires TrackChanges
+        {
+            changes_.discard(epoch);
+        }
+        ///@}
+
+        ///@{
+        /**
+         * Binary snapshots, for element types that are trivially copyable
+         *
+         * write_snapshot() writes the indices and values as they are in memory, and a lookup from indices to their positions, in the format described at
+         * detail::snapshot_header, so that they can be loaded again without inserting the elements one at a time. The lookup holds a position per index if the
+         * indices are close together, and otherwise the indices in sorted order with their positions (sorted in temporary storage from the allocator), so that the size of a snapshot follows the number of elements
+         * with a paged or bitmap index, however far apart the indices are. from_snapshot() loads a snapshot by copying the indices and values in bulk into storage
+         * from the allocator, and sparse_vector_view uses a snapshot in place, without copying it at all (for instance when it is in a memory mapped file).
+         *
+         * A snapshot can only be read on a machine with the same byte order, by a sparse_vector with the same element and size types. The page size and the
+         * Checked setting do not need to match. Generation counters are not saved, so all handles are invalidated by writing and loading a snapshot.
+         */
+        [[nodiscard]] std::size_t snapshot_size() const noexcept
+            requires std::is_trivially_copyable_v<T>
+        {
+            return detail::snapshot_layout::of<T, SizeT>(pos_.extent(), data_.size()).size;
+        }
+
+        /** Writes a snapshot of snapshot_size() bytes to out, which should be opened in binary mode */
+        void write_snapshot(std::ostream& out) const
+            requires std::is_trivially_copyable_v<T>
+        {
+            write_snapshot_to([&out](const void* bytes, std::size_t count) { out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(count)); });
+        }
+
+        /**
+         * Writes a snapshot to memory, such as memory allocated from a mapped_file_memory_resource
+         *
+         * @throws std::invalid_argument if out is smaller than snapshot_size()
+         */
+        void write_snapshot(std::span<std::byte> out) const
+            requires std::is_trivially_copyable_v<T>
+        {
+            if (out.size() < snapshot_size())
+                throw std::invalid_argument("sparse_vector: write_snapshot - output is smaller than the snapshot");
+
+            write_snapshot_to([cursor = out.data()](const void* bytes, std::size_t count) mutable {
+                std::memcpy(cursor, bytes, count);
+                cursor += count;
+            });
+        }
+
+        /**
+         * Creates a sparse_vector from a snapshot written by write_snapshot()
+         *
+         * The snapshot must be aligned to the alignment of T and SizeT. Its lookup is checked against its indices before anything is loaded, which takes time
+         * proportional to its extent.
+         *
+         * @throws std::runtime_error if the snapshot was written for other types, on a machine with a different byte order, or is truncated, misaligned or corrupt
+         */
+        [[nodiscard]] static sparse_vector from_snapshot(std::span<const std::byte> snapshot, const allocator_type& allocator = {})
+            requires std::is_trivially_copyable_v<T>
+        {
+            const auto contents = detail::read_snapshot<T, SizeT>(snapshot);
+            detail::validate_snapshot(contents);
+            if constexpr (GenerationBits > 0) {
+                if (contents.data.size() > MaxSize)
+                    throw std::runtime_error("sparse_vector: snapshot - too many elements for the number of generation bits");
+            }
+
+            sparse_vector result(allocator);
+            if (contents.positions.empty()) {
+                // In ascending index order, so that a flat index grows once per doubling and a bitmap index appends to its containers
+                for (std::size_t i = 0; i < contents.sortedIndex.size(); ++i)
+                    result.pos_.insert(contents.sortedIndex[i], contents.sortedPositions[i]);
+            } else {
+                result.pos_.assign(contents.positions);
+            }
+            result.index_.assign(contents.index.begin(), contents.index.end());
+            result.data_.assign(contents.data.begin(), contents.data.end());
+            result.changes_.on_load(result.data_.size());
+            return result;
+        }
+        ///@}
+
     private:
-        void prepare_insert(size_type index)
+        template <typename... SparseVectors>
+        friend class sparse_join_view;
+
+        // Records mutable access to the element at pos, for the content hash and change tracking
+        void touch(size_type pos, size_type index)
+        {
+            hash_.reset();
+            changes_.on_change(pos, index);
+        }
+
+        // Records mutable access to all elements
+        void touch_all() noexcept
+        {
+            hash_.reset();
+            changes_.on_change_all();
+        }
+
+        void check_insert(size_type index) const
+        {
+            if constexpr (Checked) {
+                if (pos_.find(index) != InvalidPos)
+                    throw std::runtime_error("sparse_vector: insert - element already exists at specified index");
+            }
+            check_new_index(index);
+        }
+
+        // Returns the index of an index value pair. If Checked is true, an integer index that does not fit in size_type is reported instead of being truncated.
+        template <typename P>
+        static size_type pair_index(const P& pair)
+        {
+            const auto& index = std::get<0>(pair);
+            using IndexT = std::remove_cvref_t<decltype(index)>;
+            if constexpr (Checked && std::integral<IndexT>) {
+                // Compared by hand rather than with std::in_range, which does not accept character types
+                if constexpr (std::is_signed_v<IndexT>) {
+                    if (index < 0)
+                        throw std::runtime_error("sparse_vector: insert - index out of range");
+                }
+                if (static_cast<std::uintmax_t>(index) > std::numeric_limits<size_type>::max())
+                    throw std::runtime_error("sparse_vector: insert - index out of range");
+            }
+            return static_cast<size_type>(index);
+        }
+
+        // Checks an index that is known to be free
+        void check_new_index(size_type index) const
         {
             if constexpr (Checked) {
                 if (index == InvalidPos)
                     throw std::runtime_error("sparse_vector: insert - index out of range");
             }
 
-            if (index >= pos_.size())
-                pos_.resize(index + 1, InvalidPos);
+            if constexpr (Checked && GenerationBits > 0) {
+                if (data_.size() >= MaxSize)
+                    throw std::runtime_error("sparse_vector: insert - too many elements for the number of generation bits");
+            }
+        }
 
-            if constexpr (Checked) {
-                if (pos_[index] != InvalidPos)
-                    throw std::runtime_error("sparse_vector: insert - element already exists at specified index");
+        // Adds an element at an index that is known to be free. If that fails, the sparse_vector is left unchanged.
+        template <typename... Args>
+        reference append(size_type index, Args&&... args)
+        {
+            hash_.reset();
+            data_.emplace_back(std::forward<Args>(args)...);
+            try {
+                index_.push_back(index);
+                pos_.insert(index, static_cast<size_type>(data_.size() - 1));
+                changes_.on_insert(index);
+            } catch (...) {
+                if (pos_.find(index) != InvalidPos)
+                    pos_.reset(index);
+                index_.resize(data_.size() - 1);
+                data_.pop_back();
+                throw;
+            }
+            return data_.back();
+        }
+
+        template <std::ranges::random_access_range R>
+        static auto make_chunks(R range, std::size_t chunkSize)
+        {
+            if (chunkSize == 0)
+                throw std::invalid_argument("sparse_vector: chunks - chunk size must be greater than zero");
+
+            const auto size = static_cast<std::size_t>(std::ranges::size(range));
+            const auto chunkCount = (size + chunkSize - 1) / chunkSize;
+            return std::views::iota(std::size_t{0}, chunkCount) | std::views::transform([range, size, chunkSize](std::size_t chunk) {
+                const auto first = chunk * chunkSize;
+                return std::views::counted(std::ranges::begin(range) + static_cast<std::ptrdiff_t>(first), static_cast<std::ptrdiff_t>(std::min(chunkSize, size - first)));
+            });
+        }
+
+        // Returns the positions in data_, sorted according to less
+        template <typename Less>
+        std::pmr::vector<size_type> sorted_positions(Less less) const
+        {
+            std::pmr::vector<size_type> order(data_.size(), get_allocator());
+            std::iota(order.begin(), order.end(), size_type{0});
+            std::ranges::sort(order, less);
+            return order;
+        }
+
+        // Sorts the positions in data_ according to less, and moves the elements to match
+        template <typename Less>
+        void sort_positions(Less less)
+        {
+            auto order = sorted_positions(less);
+
+            // order[i] is the current position of the element that belongs at position i, so follow each cycle of the permutation
+            for (std::size_t i = 0; i < order.size(); ++i) {
+                if (order[i] == i)
+                    continue;
+
+                auto value = std::move(data_[i]);
+                const auto index = index_[i];
+                const auto stamp = changes_.stamp(i);
+                auto hole = i;
+                for (auto next = static_cast<std::size_t>(order[hole]); next != i; next = order[hole]) {
+                    data_[hole] = std::move(data_[next]);
+                    index_[hole] = index_[next];
+                    changes_.set_stamp(hole, changes_.stamp(next));
+                    order[hole] = static_cast<size_type>(hole);
+                    hole = next;
+                }
+                data_[hole] = std::move(value);
+                index_[hole] = index;
+                changes_.set_stamp(hole, stamp);
+                order[hole] = static_cast<size_type>(hole);
+            }
+
+            for (std::size_t i = 0; i < index_.size(); ++i)
+                pos_.set(index_[i], static_cast<size_type>(i));
+        }
+
+        // Writes a snapshot through writeBytes(bytes, count), in the order of the layout
+        template <typename Write>
+        void write_snapshot_to(Write writeBytes) const
+        {
+            const auto layout = detail::snapshot_layout::of<T, SizeT>(pos_.extent(), data_.size());
+            const auto header = detail::make_snapshot_header<T, SizeT>(pos_.extent(), data_.size());
+            std::size_t written = 0;
+            const auto write = [&writeBytes, &written](const void* bytes, std::size_t count) {
+                if (count > 0)
+                    writeBytes(bytes, count);
+                written += count;
+            };
+            const auto pad = [&write, &written](std::size_t offset) {
+                static constexpr std::array<char, detail::snapshot_layout::Alignment> Zeros{};
+                write(Zeros.data(), offset - written);
+            };
+
+            write(&header, sizeof(header));
+            pad(layout.lookup);
+
+            // The lookup is written through a buffer, since the index may be paged or hold generations
+            std::array<size_type, 1024> buffer; // NOLINT: Filled before use
+            const auto writeBuffered = [&write, &buffer](std::size_t total, auto valueAt) {
+                for (std::size_t first = 0; first < total; first += buffer.size()) {
+                    const auto count = std::min(buffer.size(), total - first);
+                    for (std::size_t i = 0; i < count; ++i)
+                        buffer[i] = valueAt(first + i);
+                    write(buffer.data(), count * sizeof(size_type));
+                }
+            };
+            if (layout.sorted) {
+                const auto order = sorted_positions([this](size_type lhs, size_type rhs) { return index_[lhs] < index_[rhs]; });
+                writeBuffered(order.size(), [this, &order](std::size_t i) { return index_[order[i]]; });
+                write(order.data(), order.size() * sizeof(size_type));
+            } else {
+                writeBuffered(pos_.extent(), [this](std::size_t i) { return pos_.find(static_cast<size_type>(i)); });
+            }
+
+            pad(layout.index);
+            write(index_.data(), index_.size() * sizeof(size_type));
+            pad(layout.data);
+            write(data_.data(), data_.size() * sizeof(T));
+        }
+
+        // Resolves the indices to positions one block at a time, and calls onBlock(first, count, positions, misses) for each block, where misses has bit i
+        // set if positions[i] is InvalidPos. Returns the number of indices found.
+        template <typename OnBlock>
+        size_type resolve_batched(std::span<const size_type> indices, OnBlock onBlock) const
+        {
+            std::array<size_type, BatchSize> positions; // NOLINT: Filled before use
+            std::size_t found = 0;
+            for (std::size_t first = 0; first < indices.size(); first += BatchSize) {
+                const auto count = std::min(BatchSize, indices.size() - first);
+                const auto* block = indices.data() + first;
+
+                for (std::size_t i = 0; i < count; ++i)
+                    pos_.prefetch(block[i]);
+
+                for (std::size_t i = 0; i < count; ++i)
+                    positions[i] = pos_.find(block[i]);
+
+                // Branch free, so that the compiler can vectorize it
+                std::uint64_t misses = 0;
+                for (std::size_t i = 0; i < count; ++i)
+                    misses |= std::uint64_t{positions[i] == InvalidPos} << i;
+
+                for (std::size_t i = 0; i < count; ++i) {
+                    if (positions[i] != InvalidPos)
+                        detail::prefetch(data_.data() + positions[i]);
+                }
+
+                found += count - static_cast<std::size_t>(std::popcount(misses));
+                onBlock(first, count, positions.data(), misses);
+            }
+            return static_cast<size_type>(found);
+        }
+
+        // Compares by walking both indices in step, for indices below walkLength, and stops once either side has no elements left, so that the result
+        // matches compare_sorted() whatever the extents are: an element at an index where the other side has none is smaller if the other side has any
+        // elements left, and a sparse_vector that runs out of elements first is a prefix of the other and so is smaller
+        auto compare_by_index(const sparse_vector& other, std::size_t walkLength) const -> std::compare_three_way_result_t<value_type>
+        {
+            using ResultType = std::compare_three_way_result_t<value_type>;
+
+            auto remaining = data_.size();
+            auto otherRemaining = other.data_.size();
+            for (std::size_t i = 0; i < walkLength && remaining > 0 && otherRemaining > 0; ++i) {
+                const auto pos = pos_.find(static_cast<size_type>(i));
+                const auto otherPos = other.pos_.find(static_cast<size_type>(i));
+                if (pos == InvalidPos && otherPos == InvalidPos)
+                    continue;
+                if (pos == InvalidPos)
+                    return ResultType::greater;
+                if (otherPos == InvalidPos)
+                    return ResultType::less;
+                if (auto cmpResult = data_[pos] <=> other.data_[otherPos]; cmpResult != ResultType::equal)
+                    return cmpResult;
+                --remaining;
+                --otherRemaining;
             }
 
-            pos_[index] = static_cast<size_type>(data_.size());
+            // Either one side ran out, or the walk reached the end of the smaller extent, past which only one side can have elements
+            return remaining <=> otherRemaining;
         }
 
-        void check_access(size_type index) const
+        // Compares by sorting the positions of both sparse_vectors by index, for when the indices are too spread out to walk
+        auto compare_sorted(const sparse_vector& other) const -> std::compare_three_way_result_t<value_type>
+        {
+            using ResultType = std::compare_three_way_result_t<value_type>;
+
+            const auto order = sorted_positions([this](size_type lhs, size_type rhs) { return index_[lhs] < index_[rhs]; });
+            const auto otherOrder = other.sorted_positions([&other](size_type lhs, size_type rhs) { return other.index_[lhs] < other.index_[rhs]; });
+            const auto count = std::min(order.size(), otherOrder.size());
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto pos = order[i];
+                const auto otherPos = otherOrder[i];
+                if (index_[pos] != other.index_[otherPos])
+                    return index_[pos] < other.index_[otherPos] ? ResultType::less : ResultType::greater;
+                if (auto cmpResult = data_[pos] <=> other.data_[otherPos]; cmpResult != ResultType::equal)
+                    return cmpResult;
+            }
+
+            return data_.size() <=> other.data_.size();
+        }
+
+        void grow_data(std::size_t count)
+        {
+            if (const auto required = data_.size() + count; required > data_.capacity()) {
+                const auto capacity = std::max(required, 2 * data_.capacity());
+                index_.reserve(capacity);
+                data_.reserve(capacity);
+            }
+        }
+
+        // Moves an element to an earlier position in data_, during compaction
+        void relocate(std::size_t from, std::size_t to)
+        {
+            if (from == to)
+                return;
+
+            data_[to] = std::move(data_[from]);
+            index_[to] = index_[from];
+            pos_.set(index_[to], static_cast<size_type>(to));
+            changes_.on_relocate(from, to);
+        }
+
+        void truncate(std::size_t count)
+        {
+            data_.erase(data_.begin() + static_cast<difference_type>(count), data_.end());
+            index_.resize(count);
+            changes_.on_truncate(count);
+        }
+
+        // Returns the position of an index, which must be present unless Checked is true. The index is looked up once either way.
+        size_type check_access(size_type index) const
         {
             if constexpr (Checked) {
-                if (pos_.size() <= index)
+                if (pos_.extent() <= index)
                     throw std::runtime_error("sparse_vector: access - index out of range");
 
-                if (pos_[index] == InvalidPos)
+                const auto pos = pos_.find(index);
+                if (pos == InvalidPos)
                     throw std::runtime_error("sparse_vector: access - no data at specified index");
+                return pos;
+            } else {
+                return pos_[index];
+            }
+        }
+
+        size_type checked_pos(const handle& h) const
+        {
+            const auto pos = pos_.find(h.index, h.generation);
+            if constexpr (Checked) {
+                if (pos == InvalidPos)
+                    throw std::runtime_error("sparse_vector: access - handle refers to an erased element");
             }
+            return pos;
         }
 
-        static constexpr size_type InvalidPos = ~(size_type(0));
-        std::pmr::vector<size_type> pos_;
+        using index_type = detail::sparse_index_for<SizeT, PageSize, GenerationBits>;
+
+        static constexpr size_type InvalidPos = index_type::InvalidPos;
+        static constexpr std::size_t MaxSize = detail::index_entry<SizeT, GenerationBits>::PosMask; // Positions must stay below the empty marker
+        static constexpr std::size_t BatchSize = 64; // Number of indices resolved at a time by the batched lookups, one per bit of a miss mask word
+        static constexpr std::size_t DenseCompareFactor = 16; // Walk the index when comparing if its extent is at most this many times the number of elements
+
+        index_type pos_;                    // Position in data_ for each index, or InvalidPos
+        std::pmr::vector<size_type> index_; // Index for each element in data_
         std::pmr::vector<T> data_;
+        [[no_unique_address]] mutable detail::hash_cache<CacheHash> hash_; // Empty unless CacheHash is true
+        [[no_unique_address]] detail::change_tracker<SizeT, TrackChanges> changes_; // Empty unless TrackChanges is true
+    };
+
+    /** Forward iterator over the (index, value) pairs of a sparse_vector in ascending index order, see sparse_vector::ordered_items() */
+    template <typename T, typename SizeT, bool Checked, std::size_t PageSize, unsigned GenerationBits, bool TrackChanges, bool CacheHash>
+    template <bool Const>
+    class sparse_vector<T, SizeT, Checked, PageSize, GenerationBits, TrackChanges, CacheHash>::ordered_iterator {
+        using Vector = std::conditional_t<Const, const sparse_vector, sparse_vector>;
+
+    public:
+        using iterator_concept = std::forward_iterator_tag;
+        using iterator_category = std::input_iterator_tag; // The reference type is a proxy
+        using value_type = std::pair<SizeT, std::conditional_t<Const, const T&, T&>>;
+        using reference = value_type;
+        using difference_type = std::ptrdiff_t;
+
+        ordered_iterator() noexcept = default;
+
+        [[nodiscard]] reference operator*() const noexcept
+        {
+            return {static_cast<SizeT>(index_), vector_->data_[vector_->pos_[static_cast<SizeT>(index_)]]};
+        }
+
+        ordered_iterator& operator++() noexcept
+        {
+            index_ = vector_->pos_.next(index_ + 1);
+            return *this;
+        }
+
+        ordered_iterator operator++(int) noexcept
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+
+        [[nodiscard]] friend bool operator==(const ordered_iterator& lhs, const ordered_iterator& rhs) noexcept
+        {
+            return lhs.index_ == rhs.index_;
+        }
+
+    private:
+        friend class sparse_vector;
+
+        ordered_iterator(Vector* vector, std::size_t index) noexcept
+            : vector_(vector)
+            , index_(vector->pos_.next(index))
+        {}
+
+        Vector* vector_ = nullptr;
+        std::size_t index_ = 0;
+    };
+
+    /**
+     * Forward iterator over the (index, value) pairs of the elements changed since an epoch, see sparse_vector::changed_since()
+     *
+     * It either walks the change log, skipping entries for elements that have been erased or changed again later, or all elements, if they have all been accessed mutably.
+     */
+    template <typename T, typename SizeT, bool Checked, std::size_t PageSize, unsigned GenerationBits, bool TrackChanges, bool CacheHash>
+    class sparse_vector<T, SizeT, Checked, PageSize, GenerationBits, TrackChanges, CacheHash>::change_iterator {
+        using entry = detail::change_entry<SizeT>;
+
+    public:
+        using iterator_concept = std::forward_iterator_tag;
+        using iterator_category = std::input_iterator_tag; // The reference type is a proxy
+        using value_type = std::pair<SizeT, const T&>;
+        using reference = value_type;
+        using difference_type = std::ptrdiff_t;
+
+        change_iterator() noexcept = default;
+
+        [[nodiscard]] reference operator*() const noexcept
+        {
+            return {vector_->index_[pos_], vector_->data_[pos_]};
+        }
+
+        change_iterator& operator++() noexcept
+        {
+            if (entry_ == nullptr)
+                ++pos_;
+            else
+                skip_superseded(entry_ + 1);
+            return *this;
+        }
+
+        change_iterator operator++(int) noexcept
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+
+        [[nodiscard]] friend bool operator==(const change_iterator& lhs, const change_iterator& rhs) noexcept
+        {
+            return lhs.entry_ == rhs.entry_ && (lhs.entry_ != nullptr || lhs.pos_ == rhs.pos_);
+        }
+
+    private:
+        friend class sparse_vector;
+
+        // Iterates over all elements from a position
+        change_iterator(const sparse_vector* vector, std::size_t pos) noexcept
+            : vector_(vector)
+            , pos_(pos)
+        {}
+
+        // Iterates over the change log from an entry
+        change_iterator(const sparse_vector* vector, const entry* first, const entry* last) noexcept
+            : vector_(vector)
+            , last_(last)
+        {
+            skip_superseded(first);
+        }
+
+        // Advances to the first entry from the specified one, that is the last change to an element that is still present
+        void skip_superseded(const entry* from) noexcept
+        {
+            for (entry_ = from; entry_ != last_; ++entry_) {
+                pos_ = vector_->pos_.find(entry_->index);
+                if (pos_ != InvalidPos && vector_->changes_.is_live(entry_, pos_))
+                    return;
+            }
+        }
+
+        const sparse_vector* vector_ = nullptr;
+        const entry* entry_ = nullptr; // Current log entry, or nullptr when iterating over all elements
+        const entry* last_ = nullptr;
+        std::size_t pos_ = 0;
     };
+
+    namespace detail {
+        template <typename T>
+        struct is_sparse_vector : std::false_type {};
+
+        template <typename T, typename SizeT, bool Checked, std::size_t PageSize, unsigned GenerationBits, bool TrackChanges, bool CacheHash>
+        struct is_sparse_vector<sparse_vector<T, SizeT, Checked, PageSize, GenerationBits, TrackChanges, CacheHash>> : std::true_type {};
+    } // namespace detail
 } // namespace ARo
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <mixedbag/sparse_vector.hxx>
+
+#include <algorithm>
+#include <execution>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @file
+ * Iteration over a sparse_vector with the standard execution policies.
+ *
+ * This is a separate header since <execution> can impose requirements on the whole program. With libstdc++ it uses TBB for the parallel policies when TBB
+ * is installed, and every program that includes it then needs to link to TBB, whether it uses the parallel algorithms or not.
+ */
+
+namespace ARo {
+
+    ///@{
+    /**
+     * Calls func(value) for each element of a sparse_vector, using the specified standard execution policy (such as std::execution::par)
+     *
+     * func may be called concurrently for different elements, and must not insert or erase elements.
+     * As with its own non-const iteration, this counts as a mutable access to all the elements of a non-const sparse_vector.
+     */
+    template <typename ExecutionPolicy, typename SparseVector, typename Func>
+        requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>> && detail::is_sparse_vector<std::remove_const_t<SparseVector>>::value
+    void for_each(ExecutionPolicy&& policy, SparseVector& vector, Func func)
+    {
+        std::for_each(std::forward<ExecutionPolicy>(policy), vector.begin(), vector.end(), func);
+    }
+
+    /** Calls func(index, value) for each element of a sparse_vector, using the specified standard execution policy, with the same restrictions as for_each() */
+    template <typename ExecutionPolicy, typename SparseVector, typename Func>
+        requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>> && detail::is_sparse_vector<std::remove_const_t<SparseVector>>::value
+    void each(ExecutionPolicy&& policy, SparseVector& vector, Func func)
+    {
+        // The index of each element is found from its offset in the storage, so that the values can be walked with any policy
+        const auto first = vector.begin();
+        std::for_each(std::forward<ExecutionPolicy>(policy), first, vector.end(), [&func, data = std::to_address(first), items = vector.items().begin()](auto& value) {
+            func(items[&value - data].first, value);
+        });
+    }
+    ///@}
+} // namespace ARo
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <mixedbag/exports.h>
+#include <mixedbag/detail/item_iterator.hxx>
+#include <mixedbag/detail/snapshot.hxx>
+#include <mixedbag/detail/sparse_index.hxx>
+
+#include <cstddef>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ARo {
+
+    /**
+     * sparse_vector_view is a read-only sparse_vector that uses a binary snapshot in place, without copying it.
+     *
+     * The snapshot is written by sparse_vector::write_snapshot(). The view does not own the snapshot, which must outlive it, and it never allocates.
+     * This makes it possible to memory map a snapshot file and use it directly, so that only the parts that are actually accessed are ever read from disk:
+     *
+     * @code
+     * const int fd = ::open("positions.snapshot", O_RDONLY);
+     * const auto size = static_cast<std::size_t>(::lseek(fd, 0, SEEK_END));
+     * const auto* mapping = static_cast<const std::byte*>(::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0));
+     * const ARo::sparse_vector_view<Position> positions({mapping, size});
+     * @endcode
+     *
+     * If the snapshot has a dense lookup, lookups cost the same as for a sparse_vector with a flat index. If its indices were too far apart for that, they
+     * are found by a branch free binary search of the sorted indices instead (see detail::snapshot_header).
+     *
+     * The view only checks the header of the snapshot up front, so that it does not read all of it. A position read from the lookup is checked against the
+     * number of elements before it is used, so a corrupt lookup makes checked access throw rather than read outside the snapshot. Unchecked access does
+     * not check anything, so it should only be used with trusted snapshots.
+     *
+     * @tparam T The type of the elements, which must be trivially copyable
+     * @tparam SizeT The size type of the sparse_vector that wrote the snapshot
+     * @tparam Checked Enable bounds checking if true
+     */
+    template <typename T, typename SizeT = std::size_t, bool Checked = true>
+    class MIXEDBAG_EXPORT sparse_vector_view final {
+        static_assert(std::is_trivially_copyable_v<T>, "sparse_vector_view: T must be trivially copyable");
+
+    public:
+        using value_type = T;
+        using size_type = SizeT;
+        using difference_type = std::ptrdiff_t;
+        using const_reference = const T&;
+        using const_iterator = const T*;
+        using const_item_iterator = detail::item_iterator<SizeT, const T>;
+
+        static constexpr size_type InvalidPos = ~(SizeT(0));
+
+    public:
+        sparse_vector_view() noexcept = default;
+
+        /**
+         * Creates a view of a snapshot, which must be aligned to the alignment of T and SizeT
+         *
+         * @throws std::runtime_error if the snapshot was written for other types, on a machine with a different byte order, or is truncated or misaligned
+         */
+        explicit sparse_vector_view(std::span<const std::byte> snapshot)
+        {
+            const auto contents = detail::read_snapshot<T, SizeT>(snapshot);
+            pos_ = contents.positions;
+            sortedIndex_ = contents.sortedIndex;
+            sortedPos_ = contents.sortedPositions;
+            index_ = contents.index;
+            data_ = contents.data;
+        }
+
+        /** Returns the number of elements */
+        [[nodiscard]] size_type size() const noexcept
+        {
+            return static_cast<size_type>(data_.size());
+        }
+
+        /** Check for emptiness */
+        [[nodiscard]] bool empty() const noexcept
+        {
+            return data_.empty();
+        }
+
+        /** Returns true if there is an element at the specified index */
+        [[nodiscard]] bool contains(size_type index) const noexcept
+        {
+            return find(index) != InvalidPos;
+        }
+
+        /** Element access */
+        [[nodiscard]] const_reference operator[](size_type index) const
+        {
+            if constexpr (Checked) {
+                if (sortedIndex_.empty() && pos_.size() <= index)
+                    throw std::runtime_error("sparse_vector_view: access - index out of range");
+
+                const auto pos = find(index);
+                if (pos == InvalidPos)
+                    throw std::runtime_error("sparse_vector_view: access - no data at specified index");
+                return data_[pos];
+            } else {
+                return data_[sortedIndex_.empty() ? pos_[index] : sortedPos_[detail::branchless_lower_bound(sortedIndex_, index)]];
+            }
+        }
+
+        ///@{
+        /** Iteration, in the same order as the sparse_vector that wrote the snapshot */
+        [[nodiscard]] const_iterator begin() const noexcept
+        {
+            return data_.data();
+        }
+
+        [[nodiscard]] const_iterator end() const noexcept
+        {
+            return data_.data() + data_.size();
+        }
+        ///@}
+
+        /** Iteration over (index, value) pairs, in the same order as begin() and end() */
+        [[nodiscard]] std::ranges::subrange<const_item_iterator> items() const noexcept
+        {
+            return {const_item_iterator{index_.data(), data_.data()}, const_item_iterator{index_.data() + index_.size(), data_.data() + data_.size()}};
+        }
+
+        /** The index of each element, in the same order as the values */
+        [[nodiscard]] std::span<const size_type> indices() const noexcept
+        {
+            return index_;
+        }
+
+    private:
+        // Returns the position of an index, or InvalidPos if it is not present
+        [[nodiscard]] size_type find(size_type index) const noexcept
+        {
+            auto pos = InvalidPos;
+            if (sortedIndex_.empty()) {
+                if (index < pos_.size())
+                    pos = pos_[index];
+            } else if (const auto i = detail::branchless_lower_bound(sortedIndex_, index); i < sortedIndex_.size() && sortedIndex_[i] == index) {
+                pos = sortedPos_[i];
+            }
+
+            // A position past the elements can only come from a corrupt snapshot
+            return pos < data_.size() ? pos : InvalidPos;
+        }
+
+        std::span<const size_type> pos_;         // Position in data_ for each index, or InvalidPos, if the lookup is dense
+        std::span<const size_type> sortedIndex_; // The indices in ascending order, if the lookup is sorted
+        std::span<const size_type> sortedPos_;   // Position in data_ for each of sortedIndex_
+        std::span<const size_type> index_; // Index for each element in data_
+        std::span<const T> data_;
+    };
+
+} // namespace ARo
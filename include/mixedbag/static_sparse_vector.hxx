@@ -0,0 +1,411 @@
+#pragma once
+
+#include <mixedbag/exports.h>
+#include <mixedbag/detail/item_iterator.hxx>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace ARo {
+
+    namespace detail {
+        /** The smallest unsigned integer type that can hold all values up to and including N, and still has a value left over to mark an invalid position */
+        template <std::size_t N>
+        using uint_least_for = std::conditional_t<(N < std::numeric_limits<std::uint8_t>::max()), std::uint8_t,
+            std::conditional_t<(N < std::numeric_limits<std::uint16_t>::max()), std::uint16_t,
+                std::conditional_t<(N < std::numeric_limits<std::uint32_t>::max()), std::uint32_t, std::uint64_t>>>;
+    } // namespace detail
+
+    /**
+     * static_sparse_vector is a sparse_vector with a fixed capacity and all its storage inline, so it never allocates.
+     *
+     * Both the index and the values are stored in arrays inside the object, so it can be used where no allocation is allowed, and in constant expressions,
+     * for instance to build lookup tables at compile time:
+     *
+     * @code
+     * constexpr ARo::static_sparse_vector<std::string_view, 600, 3> Reasons{{200, "OK"}, {404, "Not Found"}, {500, "Internal Server Error"}};
+     * static_assert(Reasons[404] == "Not Found");
+     * @endcode
+     *
+     * The size type is the smallest unsigned type that can hold both MaxIndex and MaxSize, to keep the index as small as possible. Indices are passed as
+     * std::size_t, so that indices beyond the size type are range checked rather than truncated, and are only narrowed to the size type for storage.
+     * Since constant expressions cannot construct objects in raw storage, the value array always holds MaxSize values, so T must be default constructible.
+     * The slots that are not in use hold default constructed values, and inserting move assigns the new value into the next slot.
+     *
+     * Only the core of the sparse_vector interface is provided: inserting, erasing, lookup, equality, and iteration over the values and the (index, value) items.
+     * Unlike sparse_vector, there is no sort(), ordered_items(), chunks(), item_chunks(), find_many(), gather(), insert_range(), ordering, content_hash(),
+     * handles, change tracking, or snapshots.
+     *
+     * @tparam T The type of elements to store, which must be default constructible and move assignable
+     * @tparam MaxIndex The largest index that can be used
+     * @tparam MaxSize The largest number of elements that can be stored
+     * @tparam Checked Enable bounds checking if true
+     */
+    template <typename T, std::size_t MaxIndex, std::size_t MaxSize, bool Checked = true>
+    class MIXEDBAG_EXPORT static_sparse_vector final {
+        static_assert(std::is_default_constructible_v<T> && std::is_move_assignable_v<T>, "static_sparse_vector: T must be default constructible (to fill the unused slots) and move assignable (to insert into them)");
+
+    public:
+        using value_type = T;
+        using size_type = detail::uint_least_for<std::max(MaxIndex, MaxSize)>;
+        using difference_type = std::ptrdiff_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using iterator = T*;
+        using const_iterator = const T*;
+        using item_iterator = detail::item_iterator<size_type, T>;
+        using const_item_iterator = detail::item_iterator<size_type, const T>;
+
+    public:
+        constexpr static_sparse_vector() noexcept(std::is_nothrow_default_constructible_v<T>)
+        {
+            pos_.fill(InvalidPos);
+        }
+
+        /** Constructs a static_sparse_vector from index value pairs */
+        constexpr static_sparse_vector(std::initializer_list<std::pair<std::size_t, T>> pairs)
+            : static_sparse_vector()
+        {
+            for (const auto& [index, value] : pairs)
+                insert(index, value);
+        }
+
+        ///@{
+        /**
+         * Inserts an element constructed from args at the specified index, and returns it by reference
+         *
+         * Since every slot already holds a value, this is not construction in place: a temporary T is constructed from args, and move assigned into the
+         * default constructed slot.
+         *
+         * If the insertion fails, for instance because the constructor of T throws, the static_sparse_vector is left unchanged.
+         */
+        template <typename... Args>
+        constexpr reference emplace(std::size_t index, Args&&... args)
+        {
+            static_assert(std::is_constructible_v<T, Args&&...>, "static_sparse_vector: emplace needs T to be constructible from args");
+            check_insert(index);
+            return append(index, T(std::forward<Args>(args)...));
+        }
+
+        /** Inserts an element at the specified index by copy, and returns it by reference */
+        constexpr reference insert(std::size_t index, const value_type& val)
+        {
+            check_insert(index);
+            return append(index, val);
+        }
+
+        /** Inserts an element at the specified index by move, and returns it by reference */
+        constexpr reference insert(std::size_t index, value_type&& val)
+        {
+            check_insert(index);
+            return append(index, std::move(val));
+        }
+
+        /**
+         * Inserts an element constructed from args at the specified index, unless there already is an element there
+         *
+         * If there is, nothing is constructed and args are not moved from, and this is not an error even if Checked is true. As with emplace(), the new
+         * element is constructed as a temporary and move assigned into its slot.
+         *
+         * @returns the element at the index, and true if it was inserted
+         */
+        template <typename... Args>
+        constexpr std::pair<reference, bool> try_emplace(std::size_t index, Args&&... args)
+        {
+            static_assert(std::is_constructible_v<T, Args&&...>, "static_sparse_vector: try_emplace needs T to be constructible from args");
+            if (contains(index))
+                return {data_[pos_[index]], false};
+
+            check_insert(index);
+            return {append(index, T(std::forward<Args>(args)...)), true};
+        }
+
+        /**
+         * Assigns value to the element at the specified index, or inserts it if there is no element there
+         *
+         * @returns the element at the index, and true if it was inserted
+         */
+        template <typename M>
+            requires std::is_assignable_v<reference, M&&>
+        constexpr std::pair<reference, bool> insert_or_assign(std::size_t index, M&& value)
+        {
+            if (contains(index)) {
+                auto& element = data_[pos_[index]];
+                element = std::forward<M>(value);
+                return {element, false};
+            }
+
+            check_insert(index);
+            return {append(index, std::forward<M>(value)), true};
+        }
+
+        /** Removes the element at the specified index, by moving the last element into its place */
+        constexpr void erase(std::size_t index)
+        {
+            check_access(index);
+            const auto toRemove = pos_[index];
+            const auto last = static_cast<size_type>(size_ - 1);
+            if (toRemove != last) {
+                data_[toRemove] = std::move(data_[last]);
+                index_[toRemove] = index_[last];
+                pos_[index_[toRemove]] = toRemove;
+            }
+
+            data_[last] = T{};
+            pos_[index] = InvalidPos;
+            --size_;
+        }
+
+        /**
+         * Removes all elements for which the predicate returns true, keeping the relative order of the remaining elements
+         *
+         * @returns the number of removed elements
+         */
+        template <typename Predicate>
+        constexpr size_type erase_if(Predicate pred)
+        {
+            size_type kept = 0;
+            size_type i = 0;
+            try {
+                for (; i < size_; ++i) {
+                    if (pred(std::as_const(data_[i])))
+                        pos_[index_[i]] = InvalidPos;
+                    else
+                        relocate(i, kept++);
+                }
+            } catch (...) {
+                // The elements from the one that the predicate threw for are kept
+                for (; i < size_; ++i)
+                    relocate(i, kept++);
+                truncate(kept);
+                throw;
+            }
+
+            const auto removed = static_cast<size_type>(size_ - kept);
+            truncate(kept);
+            return removed;
+        }
+
+        /** Removes all elements */
+        constexpr void clear()
+        {
+            for (size_type i = 0; i < size_; ++i) {
+                pos_[index_[i]] = InvalidPos;
+                data_[i] = T{};
+            }
+            size_ = 0;
+        }
+        ///@}
+
+        /** Returns the number of elements */
+        [[nodiscard]] constexpr size_type size() const noexcept
+        {
+            return size_;
+        }
+
+        /** Check for emptiness */
+        [[nodiscard]] constexpr bool empty() const noexcept
+        {
+            return size_ == 0;
+        }
+
+        /** Returns the largest number of elements that can be stored */
+        [[nodiscard]] static constexpr size_type max_size() noexcept
+        {
+            return MaxSize;
+        }
+
+        /** Returns true if there is an element at the specified index */
+        [[nodiscard]] constexpr bool contains(std::size_t index) const noexcept
+        {
+            return index <= MaxIndex && pos_[index] != InvalidPos;
+        }
+
+        ///@{
+        /** Returns an iterator to the element at the specified index, or end() if there is none, without throwing regardless of Checked */
+        [[nodiscard]] constexpr const_iterator find(std::size_t index) const noexcept
+        {
+            return contains(index) ? data_.data() + pos_[index] : end();
+        }
+
+        [[nodiscard]] constexpr iterator find(std::size_t index) noexcept
+        {
+            return contains(index) ? data_.data() + pos_[index] : end();
+        }
+        ///@}
+
+        ///@{
+        /** Returns a pointer to the element at the specified index, or nullptr if there is none, without throwing regardless of Checked */
+        [[nodiscard]] constexpr const value_type* get_if(std::size_t index) const noexcept
+        {
+            return contains(index) ? data_.data() + pos_[index] : nullptr;
+        }
+
+        [[nodiscard]] constexpr value_type* get_if(std::size_t index) noexcept
+        {
+            return contains(index) ? data_.data() + pos_[index] : nullptr;
+        }
+        ///@}
+
+        ///@{
+        /** Element access */
+        [[nodiscard]] constexpr const_reference operator[](std::size_t index) const
+        {
+            check_access(index);
+            return data_[pos_[index]];
+        }
+
+        [[nodiscard]] constexpr reference operator[](std::size_t index)
+        {
+            check_access(index);
+            return data_[pos_[index]];
+        }
+        ///@}
+
+        ///@{
+        /** Iteration */
+        [[nodiscard]] constexpr iterator begin() noexcept
+        {
+            return data_.data();
+        }
+
+        [[nodiscard]] constexpr iterator end() noexcept
+        {
+            return data_.data() + size_;
+        }
+
+        [[nodiscard]] constexpr const_iterator begin() const noexcept
+        {
+            return data_.data();
+        }
+
+        [[nodiscard]] constexpr const_iterator end() const noexcept
+        {
+            return data_.data() + size_;
+        }
+
+        [[nodiscard]] constexpr const_iterator cbegin() const noexcept
+        {
+            return begin();
+        }
+
+        [[nodiscard]] constexpr const_iterator cend() const noexcept
+        {
+            return end();
+        }
+        ///@}
+
+        ///@{
+        /** Iteration over (index, value) pairs, in the same order as begin() and end() */
+        [[nodiscard]] constexpr std::ranges::subrange<item_iterator> items() noexcept
+        {
+            return {item_iterator{index_.data(), data_.data()}, item_iterator{index_.data() + size_, data_.data() + size_}};
+        }
+
+        [[nodiscard]] constexpr std::ranges::subrange<const_item_iterator> items() const noexcept
+        {
+            return {const_item_iterator{index_.data(), data_.data()}, const_item_iterator{index_.data() + size_, data_.data() + size_}};
+        }
+        ///@}
+
+        ///@{
+        /** Calls func(index, value) for each element, in the same order as begin() and end() */
+        template <typename Func>
+        constexpr void each(Func func)
+        {
+            for (size_type i = 0; i < size_; ++i)
+                func(index_[i], data_[i]);
+        }
+
+        template <typename Func>
+        constexpr void each(Func func) const
+        {
+            for (size_type i = 0; i < size_; ++i)
+                func(index_[i], data_[i]);
+        }
+        ///@}
+
+        /** Two static_sparse_vectors are equal if they have the same values at the same indices, regardless of their order in storage */
+        [[nodiscard]] constexpr bool operator==(const static_sparse_vector& other) const
+        {
+            if (size_ != other.size_)
+                return false;
+
+            for (size_type i = 0; i < size_; ++i) {
+                const auto otherPos = other.pos_[index_[i]];
+                if (otherPos == InvalidPos || !(data_[i] == other.data_[otherPos]))
+                    return false;
+            }
+            return true;
+        }
+
+    private:
+        static constexpr size_type InvalidPos = std::numeric_limits<size_type>::max();
+
+        constexpr void check_insert(std::size_t index) const
+        {
+            if constexpr (Checked) {
+                if (index > MaxIndex)
+                    throw std::runtime_error("static_sparse_vector: insert - index out of range");
+                if (pos_[index] != InvalidPos)
+                    throw std::runtime_error("static_sparse_vector: insert - element already exists at specified index");
+                if (size_ == MaxSize)
+                    throw std::runtime_error("static_sparse_vector: insert - capacity exceeded");
+            }
+        }
+
+        // Adds an element at an index that is known to be free. The value is assigned to the first unused slot before the element is added, so that
+        // if the assignment throws, the static_sparse_vector is left unchanged.
+        template <typename Value>
+        constexpr reference append(std::size_t index, Value&& value)
+        {
+            data_[size_] = std::forward<Value>(value);
+            pos_[index] = size_;
+            index_[size_] = static_cast<size_type>(index);
+            return data_[size_++];
+        }
+
+        // Moves an element to an earlier position, that is no longer in use
+        constexpr void relocate(size_type from, size_type to)
+        {
+            if (from == to)
+                return;
+
+            data_[to] = std::move(data_[from]);
+            index_[to] = index_[from];
+            pos_[index_[to]] = to;
+        }
+
+        // Resets the slots from count to the end, and makes count the size
+        constexpr void truncate(size_type count)
+        {
+            std::fill(data_.begin() + count, data_.begin() + size_, T{});
+            size_ = count;
+        }
+
+        constexpr void check_access(std::size_t index) const
+        {
+            if constexpr (Checked) {
+                if (index > MaxIndex)
+                    throw std::runtime_error("static_sparse_vector: access - index out of range");
+
+                if (pos_[index] == InvalidPos)
+                    throw std::runtime_error("static_sparse_vector: access - no data at specified index");
+            }
+        }
+
+        std::array<size_type, MaxIndex + 1> pos_{}; // Position in data_ for each index, or InvalidPos
+        std::array<size_type, MaxSize> index_{};    // Index for each element in data_
+        std::array<T, MaxSize> data_{};
+        size_type size_ = 0;
+    };
+
+} // namespace ARo
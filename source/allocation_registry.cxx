@@ -0,0 +1,91 @@
+#include "mixedbag/detail/allocation_registry.hxx"
+
+#include <format>
+#include <new>
+#include <stdexcept>
+
+namespace ARo::detail {
+
+allocation_registry::allocation_registry(std::pmr::memory_resource* resource, std::size_t freedHistorySize)
+    : live_(resource)
+    , freedHistory_(resource)
+    , freedCounts_(resource)
+    , freedHistorySize_(freedHistorySize)
+{}
+
+void allocation_registry::add(const allocation& newAllocation)
+{
+    const auto [it, inserted] = live_.try_emplace(newAllocation.address, newAllocation);
+    if (!inserted) {
+        const auto& existing = it->second;
+        throw std::runtime_error(std::format(
+            "Allocation of {} bytes with alignment {} at address {} that is already live - existing allocation was of {} bytes with alignment {}",
+            newAllocation.byteCount, newAllocation.alignment, newAllocation.address, existing.byteCount, existing.alignment));
+    }
+}
+
+void allocation_registry::discard(void* address) noexcept
+{
+    live_.erase(address);
+}
+
+void allocation_registry::remove(const allocation& deallocation)
+{
+    const auto address = deallocation.address;
+    if (const auto it = live_.find(address); it != live_.end()) {
+        const auto& existing = it->second;
+        if (existing.byteCount != deallocation.byteCount || existing.alignment != deallocation.alignment) {
+            throw std::runtime_error(std::format(
+                "Mismatched deallocation of {} bytes with alignment {} at address {} - existing allocation was of {} bytes with alignment {}",
+                deallocation.byteCount, deallocation.alignment, address, existing.byteCount, existing.alignment));
+        }
+
+        live_.erase(it);
+        remember_freed(address);
+        return;
+    }
+
+    if (freedCounts_.contains(address)) {
+        throw std::runtime_error(std::format("Double free of address {}", address));
+    }
+
+    throw std::runtime_error("Deallocation of memory that was not allocated by this resource!");
+}
+
+void allocation_registry::collect_live(std::vector<allocation>& allocations) const
+{
+    for (const auto& [address, liveAllocation] : live_)
+        allocations.push_back(liveAllocation);
+}
+
+// Forgetting the oldest address once the history is full keeps the bookkeeping bounded. Running out of memory here only weakens the double free
+// detection, so it is not reported.
+void allocation_registry::remember_freed(void* address)
+{
+    if (freedHistorySize_ == 0)
+        return;
+
+    try {
+        ++freedCounts_[address];
+    } catch (const std::bad_alloc&) {
+        return;
+    }
+
+    if (freedHistory_.size() < freedHistorySize_) {
+        try {
+            freedHistory_.push_back(address);
+        } catch (const std::bad_alloc&) {
+            if (--freedCounts_[address] == 0)
+                freedCounts_.erase(address);
+        }
+        return;
+    }
+
+    auto& oldest = freedHistory_[freedHistoryNext_];
+    if (const auto it = freedCounts_.find(oldest); --it->second == 0)
+        freedCounts_.erase(it);
+    oldest = address;
+    freedHistoryNext_ = (freedHistoryNext_ + 1) % freedHistorySize_;
+}
+
+} // namespace ARo::detail
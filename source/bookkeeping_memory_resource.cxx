@@ -1,50 +1,198 @@
 #include "mixedbag/bookkeeping_memory_resource.hxx"
 
+#include <algorithm>
+#include <bit>
 #include <format>
+#include <optional>
 #include <stdexcept>
+#include <string_view>
+#include <vector>
+#include <version>
+
+#if defined(__cpp_lib_stacktrace)
+#include <stacktrace>
+#endif
 
 namespace ARo {
 
-void bookkeeping_memory_resource::print_live_allocations(std::ostream& outputStream) const
+namespace {
+
+#if defined(__cpp_lib_stacktrace)
+// Only capture_call_site is skipped, since it may be inlined into do_allocate and then skipping more could skip the caller. The frames of do_allocate
+// and memory_resource::allocate may remain, but they are the same for every call site, so they do not split the grouping.
+constexpr std::size_t CallSiteSkippedFrames = 1;
+constexpr std::size_t CallSiteMaxDepth = 16;
+#endif
+
+// Bucket k holds the sizes from 2^(k-1) + 1 up to 2^k
+std::size_t size_class(std::size_t byteCount) noexcept
 {
-    outputStream << std::format("There are {} live allocations, with a total of {} bytes allocated:\n", liveAllocations_.size(), numAllocatedBytes_);
-    for (const auto& allocation : liveAllocations_) {
-        outputStream << std::format("  {}: {} bytes, alignment {}\n", allocation.address, allocation.byteCount, allocation.alignment);
+    return static_cast<std::size_t>(std::bit_width(std::max<std::size_t>(byteCount, 1) - 1));
+}
+
+void write_escaped(std::ostream& outputStream, std::string_view text)
+{
+    outputStream << '"';
+    for (const char c : text) {
+        switch (c) {
+        case '"':
+            outputStream << "\\\"";
+            break;
+        case '\\':
+            outputStream << "\\\\";
+            break;
+        case '\n':
+            outputStream << "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                outputStream << std::format("\\u{:04x}", static_cast<unsigned>(c));
+            else
+                outputStream << c;
+        }
     }
+    outputStream << '"';
 }
 
-void* bookkeeping_memory_resource::do_allocate(std::size_t byteCount, std::size_t alignment)
+// Writes the non-empty buckets as an object, keyed by the largest size or the alignment of the bucket
+void write_histogram(std::ostream& outputStream, const std::array<std::size_t, bookkeeping_memory_resource::HistogramSize>& histogram)
 {
-    const auto& allocation = liveAllocations_.emplace_back(byteCount, alignment, upstream_->allocate(byteCount, alignment));
-    numAllocatedBytes_ += allocation.byteCount;
-    return allocation.address;
-};
+    outputStream << '{';
+    bool first = true;
+    for (std::size_t k = 0; k < histogram.size(); ++k) {
+        if (histogram[k] == 0)
+            continue;
+        outputStream << std::format("{}\"{}\": {}", first ? "" : ", ", std::size_t{1} << k, histogram[k]);
+        first = false;
+    }
+    outputStream << '}';
+}
 
-void bookkeeping_memory_resource::do_deallocate(void* address, std::size_t byteCount, std::size_t alignment)
+} // namespace
+
+double bookkeeping_memory_resource::get_allocation_rate() const noexcept
 {
-    const Allocation allocation{byteCount, alignment, address};
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - created_;
+    return elapsed.count() > 0.0 ? static_cast<double>(numAllocations_) / elapsed.count() : 0.0;
+}
 
-    if (const auto it = std::ranges::find(liveAllocations_, allocation); it != liveAllocations_.end()) {
-        liveAllocations_.erase(it);
-        deadAllocations_.push_back(allocation);
-        numAllocatedBytes_ -= byteCount;
-        upstream_->deallocate(address, byteCount, alignment);
+bool bookkeeping_memory_resource::can_capture_call_sites() noexcept
+{
+#if defined(__cpp_lib_stacktrace)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void bookkeeping_memory_resource::set_capture_call_sites(bool capture)
+{
+    if (capture && !can_capture_call_sites())
+        throw std::runtime_error("bookkeeping_memory_resource: call sites cannot be captured without std::stacktrace");
+    captureCallSites_ = capture;
+}
+
+void bookkeeping_memory_resource::print_live_allocations(std::ostream& outputStream) const
+{
+    std::vector<detail::allocation_registry::allocation> allocations;
+    allocations.reserve(allocations_.live_count());
+    allocations_.collect_live(allocations);
+    std::ranges::sort(allocations, {}, [](const auto& allocation) { return static_cast<const std::byte*>(allocation.address); });
+
+    outputStream << std::format("There are {} live allocations, with a total of {} bytes allocated:\n", allocations.size(), numAllocatedBytes_);
+    if (liveCallSites_.empty()) {
+        for (const auto& allocation : allocations) {
+            outputStream << std::format("  {}: {} bytes, alignment {}\n", allocation.address, allocation.byteCount, allocation.alignment);
+        }
         return;
     }
 
-    if (const auto it = std::ranges::find(liveAllocations_, address, &Allocation::address); it != liveAllocations_.end()) {
-        throw std::runtime_error(std::format(
-            "Mismatched deallocation of {} bytes with alignment {} at address {} - existing allocation was of {} bytes with alignment {}",
-            byteCount, alignment, address, it->byteCount, it->alignment));
+    // Group by call site, keeping the allocations sorted by address within each group, and the ones without a call site last
+    std::ranges::stable_sort(allocations, {}, [this](const auto& allocation) {
+        const auto it = liveCallSites_.find(allocation.address);
+        return it == liveCallSites_.end() ? std::pair{true, std::size_t{0}} : std::pair{false, it->second};
+    });
+    std::optional<std::size_t> currentCallSite;
+    bool first = true;
+    for (const auto& allocation : allocations) {
+        const auto it = liveCallSites_.find(allocation.address);
+        const auto callSite = it == liveCallSites_.end() ? std::nullopt : std::optional{it->second};
+        if (first || callSite != currentCallSite) {
+            if (callSite) {
+                const auto& site = callSites_.at(*callSite);
+                outputStream << std::format("{} live allocations, with a total of {} bytes, from:\n{}\n", site.numLiveAllocations,
+                    site.numLiveAllocatedBytes, site.description);
+            } else {
+                outputStream << "From an unknown call site:\n";
+            }
+            currentCallSite = callSite;
+            first = false;
+        }
+        outputStream << std::format("  {}: {} bytes, alignment {}\n", allocation.address, allocation.byteCount, allocation.alignment);
+    }
+}
+
+void bookkeeping_memory_resource::write_profile(std::ostream& outputStream) const
+{
+    outputStream << std::format("{{\"numAllocations\": {}, \"numDeallocations\": {}, \"numLiveAllocations\": {}, \"numLiveAllocatedBytes\": {}, "
+                                "\"peakAllocatedBytes\": {}, \"totalAllocatedBytes\": {}, \"allocationRate\": {}",
+        numAllocations_, numDeallocations_, allocations_.live_count(), numAllocatedBytes_, peakAllocatedBytes_, totalAllocatedBytes_,
+        get_allocation_rate());
+    outputStream << ", \"sizes\": ";
+    write_histogram(outputStream, sizeHistogram_);
+    outputStream << ", \"alignments\": ";
+    write_histogram(outputStream, alignmentHistogram_);
+
+    // Sorted by the number of bytes allocated, so that the call sites that churn the most come first
+    std::vector<const CallSite*> callSites;
+    callSites.reserve(callSites_.size());
+    for (const auto& [hash, site] : callSites_)
+        callSites.push_back(&site);
+    std::ranges::sort(callSites, std::ranges::greater{}, [](const CallSite* site) { return site->numAllocatedBytes; });
+
+    outputStream << ", \"callSites\": [";
+    for (std::size_t i = 0; i < callSites.size(); ++i) {
+        const auto& site = *callSites[i];
+        outputStream << std::format("{}{{\"numAllocations\": {}, \"numAllocatedBytes\": {}, \"numLiveAllocations\": {}, \"numLiveAllocatedBytes\": {}, "
+                                    "\"stacktrace\": ",
+            i == 0 ? "" : ", ", site.numAllocations, site.numAllocatedBytes, site.numLiveAllocations, site.numLiveAllocatedBytes);
+        write_escaped(outputStream, site.description);
+        outputStream << '}';
+    }
+    outputStream << "]}\n";
+}
+
+void* bookkeeping_memory_resource::do_allocate(std::size_t byteCount, std::size_t alignment)
+{
+    void* address = upstream_->allocate(byteCount, alignment);
+    try {
+        allocations_.add({byteCount, alignment, address});
+    } catch (...) {
+        upstream_->deallocate(address, byteCount, alignment);
+        throw;
     }
 
-    if (const auto it = std::ranges::find(deadAllocations_, address, &Allocation::address); it != deadAllocations_.end()) {
-        throw std::runtime_error(std::format(
-            "Double free of address {}",
-            address));
+    // Captured once the address is known not to be live, so that the call site of a live allocation is never replaced
+    CallSite* callSite = nullptr;
+    try {
+        if (captureCallSites_)
+            callSite = capture_call_site(address);
+    } catch (...) {
+        allocations_.discard(address);
+        upstream_->deallocate(address, byteCount, alignment);
+        throw;
     }
+    record_allocation(byteCount, alignment, callSite);
+    return address;
+};
 
-    throw std::runtime_error(std::format("Deallocation of memory that was not allocated by this resource!"));
+void bookkeeping_memory_resource::do_deallocate(void* address, std::size_t byteCount, std::size_t alignment)
+{
+    allocations_.remove({byteCount, alignment, address});
+    release_call_site(address, byteCount);
+    ++numDeallocations_;
+    numAllocatedBytes_ -= byteCount;
+    upstream_->deallocate(address, byteCount, alignment);
 }
 
 bool bookkeeping_memory_resource::do_is_equal(const memory_resource& other) const noexcept
@@ -52,5 +200,55 @@ bool bookkeeping_memory_resource::do_is_equal(const memory_resource& other) cons
     return &other == this;
 }
 
+void bookkeeping_memory_resource::record_allocation(std::size_t byteCount, std::size_t alignment, CallSite* callSite) noexcept
+{
+    ++numAllocations_;
+    numAllocatedBytes_ += byteCount;
+    totalAllocatedBytes_ += byteCount;
+    peakAllocatedBytes_ = std::max(peakAllocatedBytes_, numAllocatedBytes_);
+    ++sizeHistogram_[std::min(size_class(byteCount), HistogramSize - 1)];
+    ++alignmentHistogram_[static_cast<std::size_t>(std::countr_zero(alignment)) % HistogramSize];
+
+    if (callSite) {
+        ++callSite->numAllocations;
+        ++callSite->numLiveAllocations;
+        callSite->numAllocatedBytes += byteCount;
+        callSite->numLiveAllocatedBytes += byteCount;
+    }
+}
+
+bookkeeping_memory_resource::CallSite* bookkeeping_memory_resource::capture_call_site(void* address)
+{
+#if defined(__cpp_lib_stacktrace)
+    const auto trace = std::stacktrace::current(CallSiteSkippedFrames, CallSiteMaxDepth);
+    const auto hash = std::hash<std::stacktrace>{}(trace);
+    auto [it, inserted] = callSites_.try_emplace(hash);
+    try {
+        // Describing the trace resolves symbols, which is slow, so it is done once per call site
+        if (inserted)
+            it->second.description = std::to_string(trace);
+        liveCallSites_.emplace(address, hash);
+    } catch (...) {
+        if (inserted)
+            callSites_.erase(it);
+        throw;
+    }
+    return &it->second;
+#else
+    (void)address;
+    return nullptr;
+#endif
+}
+
+void bookkeeping_memory_resource::release_call_site(void* address, std::size_t byteCount) noexcept
+{
+    const auto it = liveCallSites_.find(address);
+    if (it == liveCallSites_.end())
+        return;
+    auto& site = callSites_.find(it->second)->second;
+    --site.numLiveAllocations;
+    site.numLiveAllocatedBytes -= byteCount;
+    liveCallSites_.erase(it);
+}
 
 } // namespace ARo
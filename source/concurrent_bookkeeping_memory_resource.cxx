@@ -0,0 +1,97 @@
+#include "mixedbag/concurrent_bookkeeping_memory_resource.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <format>
+#include <utility>
+#include <vector>
+
+namespace ARo {
+
+concurrent_bookkeeping_memory_resource::concurrent_bookkeeping_memory_resource(std::pmr::memory_resource* upstream, std::size_t freedHistorySize)
+    : upstream_(upstream)
+    , shards_([&]<std::size_t... Is>(std::index_sequence<Is...>) {
+        const auto shardHistorySize = (freedHistorySize + ShardCount - 1) / ShardCount;
+        return std::array<Shard, ShardCount>{{((void)Is, Shard(upstream, shardHistorySize))...}};
+    }(std::make_index_sequence<ShardCount>{}))
+{}
+
+void concurrent_bookkeeping_memory_resource::print_live_allocations(std::ostream& outputStream) const
+{
+    std::vector<detail::allocation_registry::allocation> allocations;
+    for (const auto& shard : shards_) {
+        const std::lock_guard lock(shard.mutex);
+        shard.allocations.collect_live(allocations);
+    }
+    std::ranges::sort(allocations, {}, [](const auto& allocation) { return static_cast<const std::byte*>(allocation.address); });
+
+    std::size_t byteCount = 0;
+    for (const auto& allocation : allocations)
+        byteCount += allocation.byteCount;
+
+    outputStream << std::format("There are {} live allocations, with a total of {} bytes allocated:\n", allocations.size(), byteCount);
+    for (const auto& allocation : allocations) {
+        outputStream << std::format("  {}: {} bytes, alignment {}\n", allocation.address, allocation.byteCount, allocation.alignment);
+    }
+}
+
+// Fibonacci hashing, which spreads addresses that differ only in their higher bits, as allocations of the same size class tend to
+concurrent_bookkeeping_memory_resource::Shard& concurrent_bookkeeping_memory_resource::shard_of(const void* address) const noexcept
+{
+    constexpr auto ShardBits = std::countr_zero(ShardCount);
+    static_assert(std::has_single_bit(ShardCount));
+
+    const auto hash = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(address)) * 0x9e3779b97f4a7c15ULL;
+    return shards_[static_cast<std::size_t>(hash >> (64 - ShardBits))];
+}
+
+void* concurrent_bookkeeping_memory_resource::do_allocate(std::size_t byteCount, std::size_t alignment)
+{
+    void* address = upstream_->allocate(byteCount, alignment);
+    try {
+        auto& shard = shard_of(address);
+        const std::lock_guard lock(shard.mutex);
+        shard.allocations.add({byteCount, alignment, address});
+        count_allocation(byteCount);
+    } catch (...) {
+        upstream_->deallocate(address, byteCount, alignment);
+        throw;
+    }
+    return address;
+}
+
+// The allocation is removed from its shard before the memory is handed back upstream, so that another thread can not be given the same address
+// while it is still recorded as live
+void concurrent_bookkeeping_memory_resource::do_deallocate(void* address, std::size_t byteCount, std::size_t alignment)
+{
+    {
+        auto& shard = shard_of(address);
+        const std::lock_guard lock(shard.mutex);
+        shard.allocations.remove({byteCount, alignment, address});
+        count_deallocation(byteCount);
+    }
+    upstream_->deallocate(address, byteCount, alignment);
+}
+
+// The counters are updated under the lock of the shard that records the allocation, so that a deallocation, which takes the same lock, can not
+// decrement them before the allocation has incremented them, which would make them wrap around for a moment
+void concurrent_bookkeeping_memory_resource::count_allocation(std::size_t byteCount) noexcept
+{
+    numLiveAllocations_.fetch_add(1, std::memory_order_relaxed);
+    numAllocatedBytes_.fetch_add(byteCount, std::memory_order_relaxed);
+}
+
+void concurrent_bookkeeping_memory_resource::count_deallocation(std::size_t byteCount) noexcept
+{
+    numLiveAllocations_.fetch_sub(1, std::memory_order_relaxed);
+    numAllocatedBytes_.fetch_sub(byteCount, std::memory_order_relaxed);
+    numDeallocations_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool concurrent_bookkeeping_memory_resource::do_is_equal(const memory_resource& other) const noexcept
+{
+    return &other == this;
+}
+
+} // namespace ARo
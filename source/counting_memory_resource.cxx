@@ -0,0 +1,142 @@
+#include "mixedbag/counting_memory_resource.hxx"
+
+#include <algorithm>
+#include <bit>
+
+namespace ARo {
+
+namespace {
+
+static_assert(counting_memory_resource::SlotCount == 64, "The slot numbers in use are kept in a single 64 bit mask");
+
+// The slot numbers owned by running threads, shared by all counting_memory_resources, so that a thread uses the same slot in each
+std::atomic<std::uint64_t> usedSlots = 0;
+
+constexpr std::size_t NoSlot = counting_memory_resource::SlotCount + 1;
+
+// The slot number of the thread, which is trivially destructible, so that it can still be read while the thread's other thread_local objects are
+// destroyed, and possibly deallocate through a counting_memory_resource
+thread_local std::size_t threadSlot = NoSlot;
+
+// Hands the slot number of the thread back when the thread exits, after which the thread uses the shared slot. The release and acquire orderings
+// make the stores of the previous owner of a slot visible to the next, which carries on from the counts it left.
+struct slot_lease {
+    ~slot_lease()
+    {
+        if (threadSlot < counting_memory_resource::SlotCount)
+            usedSlots.fetch_and(~(std::uint64_t{1} << threadSlot), std::memory_order_release);
+        threadSlot = counting_memory_resource::SlotCount;
+    }
+};
+
+// Takes the lowest free slot number, or the shared slot if there is none
+std::size_t acquire_slot() noexcept
+{
+    thread_local const slot_lease lease;
+
+    auto used = usedSlots.load(std::memory_order_relaxed);
+    while (used != ~std::uint64_t{0}) {
+        const auto free = static_cast<std::size_t>(std::countr_one(used));
+        if (usedSlots.compare_exchange_weak(used, used | (std::uint64_t{1} << free), std::memory_order_acquire, std::memory_order_relaxed))
+            return free;
+    }
+    return counting_memory_resource::SlotCount;
+}
+
+// Adds to a counter of a slot, which needs a read-modify-write only if the slot is shared
+template <typename Counter>
+void add(std::atomic<Counter>& counter, Counter value, bool shared) noexcept
+{
+    if (shared)
+        counter.fetch_add(value, std::memory_order_relaxed);
+    else
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+} // namespace
+
+counting_memory_resource::counters counting_memory_resource::snapshot() const noexcept
+{
+    counters result;
+    for (const auto& slot : slots_) {
+        result.numAllocations += slot.numAllocations.load(std::memory_order_relaxed);
+        result.numDeallocations += slot.numDeallocations.load(std::memory_order_relaxed);
+        result.numAllocatedBytes += slot.numAllocatedBytes.load(std::memory_order_relaxed);
+        result.numDeallocatedBytes += slot.numDeallocatedBytes.load(std::memory_order_relaxed);
+        result.numFailures += slot.numFailures.load(std::memory_order_relaxed);
+    }
+    // Bytes a slot has not published yet are not in the peak, which would otherwise be below the live bytes after a few small allocations. The sums are
+    // not atomic, so a deallocation can be counted without its allocation, and then the live bytes are left out.
+    result.peakAllocatedBytes = peakAllocatedBytes_.load(std::memory_order_relaxed);
+    if (result.numAllocatedBytes >= result.numDeallocatedBytes)
+        result.peakAllocatedBytes = std::max(result.peakAllocatedBytes, result.live_bytes());
+    return result;
+}
+
+std::size_t counting_memory_resource::get_num_free_slots() noexcept
+{
+    return static_cast<std::size_t>(std::popcount(~usedSlots.load(std::memory_order_relaxed)));
+}
+
+std::size_t counting_memory_resource::current_slot() noexcept
+{
+    if (threadSlot == NoSlot)
+        threadSlot = acquire_slot();
+    return threadSlot;
+}
+
+// Only the shared total and the peak are updated with read-modify-writes, once per peakGranularity bytes
+void counting_memory_resource::publish(Slot& slot, bool shared, std::int64_t byteDelta) noexcept
+{
+    add(slot.unpublishedBytes, byteDelta, shared);
+    const auto unpublished = slot.unpublishedBytes.load(std::memory_order_relaxed);
+    if (unpublished < peakGranularity_ && unpublished > -peakGranularity_)
+        return;
+
+    const auto published = shared ? slot.unpublishedBytes.exchange(0, std::memory_order_relaxed) : unpublished;
+    if (!shared)
+        slot.unpublishedBytes.store(0, std::memory_order_relaxed);
+    const auto live = liveBytes_.fetch_add(published, std::memory_order_relaxed) + published;
+    if (live <= 0)
+        return;
+
+    auto peak = peakAllocatedBytes_.load(std::memory_order_relaxed);
+    while (static_cast<std::size_t>(live) > peak && !peakAllocatedBytes_.compare_exchange_weak(peak, static_cast<std::size_t>(live), std::memory_order_relaxed)) {
+    }
+}
+
+void* counting_memory_resource::do_allocate(std::size_t byteCount, std::size_t alignment)
+{
+    const auto slotNumber = current_slot();
+    const bool shared = slotNumber == SharedSlot;
+    auto& slot = slots_[slotNumber];
+    void* address = nullptr;
+    try {
+        address = upstream_->allocate(byteCount, alignment);
+    } catch (...) {
+        add(slot.numFailures, std::size_t{1}, shared);
+        throw;
+    }
+    add(slot.numAllocations, std::size_t{1}, shared);
+    add(slot.numAllocatedBytes, byteCount, shared);
+    publish(slot, shared, static_cast<std::int64_t>(byteCount));
+    return address;
+}
+
+void counting_memory_resource::do_deallocate(void* address, std::size_t byteCount, std::size_t alignment)
+{
+    upstream_->deallocate(address, byteCount, alignment);
+    const auto slotNumber = current_slot();
+    const bool shared = slotNumber == SharedSlot;
+    auto& slot = slots_[slotNumber];
+    add(slot.numDeallocations, std::size_t{1}, shared);
+    add(slot.numDeallocatedBytes, byteCount, shared);
+    publish(slot, shared, -static_cast<std::int64_t>(byteCount));
+}
+
+bool counting_memory_resource::do_is_equal(const memory_resource& other) const noexcept
+{
+    return &other == this;
+}
+
+} // namespace ARo
@@ -0,0 +1,259 @@
+#include "mixedbag/mapped_file_memory_resource.hxx"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ARo {
+
+namespace {
+
+constexpr std::size_t MinBlockSize = 64;
+constexpr std::size_t ClassCount = 48;       // Block sizes from 64 bytes up to 2^53 bytes
+constexpr std::size_t HeapStart = 4096;      // The header has the first page to itself
+constexpr std::size_t GrowthGranularity = std::size_t{1} << 20; // A multiple of any page size
+
+[[noreturn]] void throw_errno(const char* what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// The largest block size, limited by the size classes and by the largest power of two that fits in a std::size_t
+constexpr std::size_t MaxBlockSize = static_cast<std::size_t>(
+    std::min<std::uint64_t>(std::uint64_t{MinBlockSize} << (ClassCount - 1), std::bit_floor(std::numeric_limits<std::size_t>::max())));
+
+// Returns the size class of blocks large enough for byteCount bytes at the specified alignment, or ClassCount if there is none
+std::size_t size_class(std::size_t byteCount, std::size_t alignment)
+{
+    const auto required = std::max({byteCount, alignment, MinBlockSize});
+    if (required > MaxBlockSize)
+        return ClassCount;
+    return static_cast<std::size_t>(std::countr_zero(std::bit_ceil(required)) - std::countr_zero(MinBlockSize));
+}
+
+// Returns true if offset can be the start of a free block of the size class, which lies in the heap below top and is aligned like a new block
+bool is_valid_free_block(std::uint64_t offset, std::size_t sizeClass, std::uint64_t top)
+{
+    const std::uint64_t blockSize = std::uint64_t{MinBlockSize} << sizeClass;
+    const auto blockAlignment = std::min<std::uint64_t>(blockSize, mapped_file_memory_resource::MaxAlignment);
+    return offset >= HeapStart && offset < top && blockSize <= top - offset && offset % blockAlignment == 0;
+}
+
+// Rounds the largest file size up to the growth granularity, or down if rounding up would overflow
+std::size_t reserved_size(std::size_t maxSize)
+{
+    const auto roundedDown = std::max(maxSize, GrowthGranularity) / GrowthGranularity * GrowthGranularity;
+    if (roundedDown == maxSize || roundedDown > std::numeric_limits<std::size_t>::max() - GrowthGranularity)
+        return roundedDown;
+    return roundedDown + GrowthGranularity;
+}
+
+} // namespace
+
+// Stored at the start of the file. Offsets are relative to the start of the file, and zero means none.
+struct mapped_file_memory_resource::FileHeader {
+    static constexpr std::array<char, 8> Magic{'A', 'R', 'o', 'M', 'A', 'P', 'M', 'R'};
+    static constexpr std::uint32_t CurrentVersion = 1;
+    static constexpr std::uint32_t ByteOrderMark = 0x01020304;
+
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t top;            // End of the part of the heap that has been handed out
+    std::uint64_t allocatedBytes; // Bytes in live allocations
+    std::uint64_t rootOffset;
+    std::uint64_t rootSize;
+    std::array<std::uint64_t, ClassCount> freeLists; // First free block of each size class, each holding the offset of the next one
+};
+
+static_assert(sizeof(std::uint64_t) <= MinBlockSize);
+
+mapped_file_memory_resource::mapped_file_memory_resource(const std::filesystem::path& path, std::size_t maxSize)
+    : reservedSize_(reserved_size(maxSize))
+{
+    static_assert(sizeof(FileHeader) <= HeapStart);
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        throw_errno("mapped_file_memory_resource: open");
+
+    try {
+        struct stat status {};
+        if (::fstat(fd_, &status) != 0)
+            throw_errno("mapped_file_memory_resource: stat");
+        const auto fileSize = static_cast<std::size_t>(status.st_size);
+        if (fileSize > reservedSize_)
+            throw std::runtime_error("mapped_file_memory_resource: open - the file is larger than the maximum size");
+
+        auto* reservation = ::mmap(nullptr, reservedSize_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (reservation == MAP_FAILED)
+            throw_errno("mapped_file_memory_resource: reserve");
+        base_ = static_cast<std::byte*>(reservation);
+
+        if (fileSize == 0) {
+            grow(HeapStart);
+            auto& newHeader = header();
+            newHeader.magic = FileHeader::Magic;
+            newHeader.version = FileHeader::CurrentVersion;
+            newHeader.byteOrder = FileHeader::ByteOrderMark;
+            newHeader.top = HeapStart;
+            return;
+        }
+
+        if (fileSize < HeapStart || fileSize % GrowthGranularity != 0)
+            throw std::runtime_error("mapped_file_memory_resource: open - not a mapped_file_memory_resource file");
+        if (::mmap(base_, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd_, 0) == MAP_FAILED)
+            throw_errno("mapped_file_memory_resource: map");
+        mappedSize_ = fileSize;
+
+        const auto& existingHeader = header();
+        if (existingHeader.magic != FileHeader::Magic || existingHeader.byteOrder != FileHeader::ByteOrderMark)
+            throw std::runtime_error("mapped_file_memory_resource: open - not a mapped_file_memory_resource file");
+        if (existingHeader.version != FileHeader::CurrentVersion)
+            throw std::runtime_error("mapped_file_memory_resource: open - unsupported version");
+        if (existingHeader.top < HeapStart || existingHeader.top > fileSize)
+            throw std::runtime_error("mapped_file_memory_resource: open - corrupt file");
+        if (existingHeader.rootOffset != 0
+            && (existingHeader.rootOffset < HeapStart || existingHeader.rootOffset > existingHeader.top
+                || existingHeader.rootSize > existingHeader.top - existingHeader.rootOffset))
+            throw std::runtime_error("mapped_file_memory_resource: open - corrupt file");
+        for (std::size_t sizeClass = 0; sizeClass < ClassCount; ++sizeClass) {
+            const auto first = existingHeader.freeLists[sizeClass];
+            if (first != 0 && !is_valid_free_block(first, sizeClass, existingHeader.top))
+                throw std::runtime_error("mapped_file_memory_resource: open - corrupt file");
+        }
+    } catch (...) {
+        if (base_ != nullptr)
+            ::munmap(base_, reservedSize_);
+        ::close(fd_);
+        throw;
+    }
+}
+
+mapped_file_memory_resource::~mapped_file_memory_resource()
+{
+    ::munmap(base_, reservedSize_);
+    ::close(fd_);
+}
+
+std::span<std::byte> mapped_file_memory_resource::root() const noexcept
+{
+    const auto& fileHeader = header();
+    if (fileHeader.rootOffset == 0)
+        return {};
+    return {base_ + fileHeader.rootOffset, static_cast<std::size_t>(fileHeader.rootSize)};
+}
+
+void mapped_file_memory_resource::set_root(std::span<const std::byte> root)
+{
+    auto& fileHeader = header();
+    if (root.empty()) {
+        fileHeader.rootOffset = 0;
+        fileHeader.rootSize = 0;
+        return;
+    }
+
+    if (root.data() < base_ + HeapStart || root.data() + root.size() > base_ + fileHeader.top)
+        throw std::invalid_argument("mapped_file_memory_resource: set_root - the root must be allocated from this resource");
+    fileHeader.rootOffset = static_cast<std::uint64_t>(root.data() - base_);
+    fileHeader.rootSize = root.size();
+}
+
+void mapped_file_memory_resource::flush()
+{
+    if (::msync(base_, mappedSize_, MS_SYNC) != 0)
+        throw_errno("mapped_file_memory_resource: flush");
+}
+
+std::size_t mapped_file_memory_resource::get_num_allocated_bytes() const noexcept
+{
+    return static_cast<std::size_t>(header().allocatedBytes);
+}
+
+mapped_file_memory_resource::FileHeader& mapped_file_memory_resource::header() const noexcept
+{
+    return *reinterpret_cast<FileHeader*>(base_);
+}
+
+// Extends the file and its mapping to at least requiredSize bytes, growing geometrically
+void mapped_file_memory_resource::grow(std::size_t requiredSize)
+{
+    if (requiredSize > reservedSize_)
+        throw std::bad_alloc();
+
+    auto newSize = std::max(requiredSize, 2 * mappedSize_);
+    newSize = (newSize + GrowthGranularity - 1) / GrowthGranularity * GrowthGranularity;
+    newSize = std::min(newSize, reservedSize_);
+
+    if (::ftruncate(fd_, static_cast<off_t>(newSize)) != 0)
+        throw_errno("mapped_file_memory_resource: grow");
+    if (::mmap(base_ + mappedSize_, newSize - mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd_, static_cast<off_t>(mappedSize_)) == MAP_FAILED)
+        throw_errno("mapped_file_memory_resource: grow");
+    mappedSize_ = newSize;
+}
+
+void* mapped_file_memory_resource::do_allocate(std::size_t byteCount, std::size_t alignment)
+{
+    // Sizes beyond the mapping can never be satisfied, and are rejected before they are rounded up to a block size
+    if (alignment > MaxAlignment || byteCount > reservedSize_ - HeapStart)
+        throw std::bad_alloc();
+
+    const auto sizeClass = size_class(byteCount, alignment);
+    if (sizeClass >= ClassCount)
+        throw std::bad_alloc();
+    const auto blockSize = MinBlockSize << sizeClass;
+
+    auto& fileHeader = header();
+    auto& freeList = fileHeader.freeLists[sizeClass];
+    std::uint64_t offset = freeList;
+    if (offset != 0) {
+        // The first block of each free list is checked when the file is opened, and the ones after it as they are reached
+        const auto next = *reinterpret_cast<const std::uint64_t*>(base_ + offset);
+        if (next != 0 && !is_valid_free_block(next, sizeClass, fileHeader.top))
+            throw std::runtime_error("mapped_file_memory_resource: allocate - corrupt file");
+        freeList = next;
+    } else {
+        // Blocks are aligned to their size, so that a block taken from a free list is as aligned as a new one
+        const auto blockAlignment = std::min(blockSize, MaxAlignment);
+        offset = (fileHeader.top + blockAlignment - 1) / blockAlignment * blockAlignment;
+        if (offset + blockSize > mappedSize_)
+            grow(static_cast<std::size_t>(offset + blockSize));
+        header().top = offset + blockSize;
+    }
+
+    header().allocatedBytes += blockSize;
+    return base_ + offset;
+}
+
+void mapped_file_memory_resource::do_deallocate(void* address, std::size_t byteCount, std::size_t alignment)
+{
+    auto* block = static_cast<std::byte*>(address);
+    auto& fileHeader = header();
+    if (block < base_ + HeapStart || block >= base_ + fileHeader.top)
+        throw std::runtime_error("Deallocation of memory that was not allocated by this resource!");
+
+    const auto sizeClass = size_class(byteCount, alignment);
+    if (sizeClass >= ClassCount)
+        throw std::runtime_error("Deallocation of memory that was not allocated by this resource!");
+    *reinterpret_cast<std::uint64_t*>(block) = fileHeader.freeLists[sizeClass];
+    fileHeader.freeLists[sizeClass] = static_cast<std::uint64_t>(block - base_);
+    fileHeader.allocatedBytes -= MinBlockSize << sizeClass;
+}
+
+bool mapped_file_memory_resource::do_is_equal(const memory_resource& other) const noexcept
+{
+    return &other == this;
+}
+
+} // namespace ARo
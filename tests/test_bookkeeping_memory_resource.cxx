@@ -1,4 +1,9 @@
 #include <catch.hpp>
+#include <cstddef>
+#include <memory_resource>
+#include <sstream>
+#include <vector>
+
 #include <mixedbag/bookkeeping_memory_resource.hxx>
 
 TEST_CASE("bookkeping_memory_resource", "[normal]")
@@ -38,4 +43,179 @@ TEST_CASE("bookkeping_memory_resource", "[normal]")
     memResource.deallocate(bar, 100, 4);
     REQUIRE(memResource.has_no_leak());
     REQUIRE_FALSE(memResource.is_unused());
-}
\ No newline at end of file
+}
+
+TEST_CASE("bookkeeping_memory_resource Freed history", "[normal]")
+{
+    SECTION("Only the most recent deallocations are remembered")
+    {
+        ARo::bookkeeping_memory_resource memResource(std::pmr::get_default_resource(), 2);
+        REQUIRE(memResource.get_freed_history_size() == 2);
+
+        void* first = memResource.allocate(16, 8);
+        void* second = memResource.allocate(16, 8);
+        void* third = memResource.allocate(16, 8);
+        memResource.deallocate(first, 16, 8);
+        memResource.deallocate(second, 16, 8);
+        memResource.deallocate(third, 16, 8);
+
+        REQUIRE_THROWS_WITH(memResource.deallocate(third, 16, 8), Catch::Contains("Double free"));
+        REQUIRE_THROWS_WITH(memResource.deallocate(second, 16, 8), Catch::Contains("Double free"));
+        REQUIRE_THROWS_WITH(memResource.deallocate(first, 16, 8), Catch::Contains("not allocated by this resource"));
+        REQUIRE(memResource.get_num_deallocations() == 3);
+    }
+
+    SECTION("Many live allocations")
+    {
+        ARo::bookkeeping_memory_resource memResource;
+        std::vector<void*> addresses;
+        for (std::size_t i = 0; i < 100'000; ++i)
+            addresses.push_back(memResource.allocate(8, 8));
+        REQUIRE(memResource.get_num_live_allocations() == 100'000);
+        REQUIRE(memResource.get_num_live_allocated_bytes() == 800'000);
+
+        for (auto* address : addresses)
+            memResource.deallocate(address, 8, 8);
+        REQUIRE(memResource.has_no_leak());
+        REQUIRE(memResource.get_num_deallocations() == 100'000);
+    }
+}
+
+TEST_CASE("bookkeeping_memory_resource Live addresses", "[normal]")
+{
+    // Hands out the same address for every allocation aligned to 64 bytes, as an upstream resource that someone deallocated from directly would.
+    // The bookkeeping itself is allocated from the default resource.
+    struct SameAddressResource final : std::pmr::memory_resource {
+        alignas(64) std::byte buffer[64]{};
+        std::size_t numDeallocations = 0;
+
+        void* do_allocate(std::size_t byteCount, std::size_t alignment) override
+        {
+            return alignment == 64 ? buffer : std::pmr::get_default_resource()->allocate(byteCount, alignment);
+        }
+
+        void do_deallocate(void* address, std::size_t byteCount, std::size_t alignment) override
+        {
+            if (address == buffer)
+                ++numDeallocations;
+            else
+                std::pmr::get_default_resource()->deallocate(address, byteCount, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return &other == this;
+        }
+    };
+
+    SameAddressResource upstream;
+    ARo::bookkeeping_memory_resource memResource(&upstream);
+
+    void* first = memResource.allocate(16, 64);
+    REQUIRE_THROWS_WITH(memResource.allocate(32, 64), Catch::Contains("already live"));
+    REQUIRE(upstream.numDeallocations == 1);
+
+    // The first allocation is kept as it was
+    REQUIRE(memResource.get_num_live_allocations() == 1);
+    REQUIRE(memResource.get_num_live_allocated_bytes() == 16);
+    memResource.deallocate(first, 16, 64);
+    REQUIRE(memResource.has_no_leak());
+}
+
+TEST_CASE("bookkeeping_memory_resource Profiling", "[normal]")
+{
+    ARo::bookkeeping_memory_resource memResource;
+
+    SECTION("Peak and total bytes")
+    {
+        void* first = memResource.allocate(100, 8);
+        void* second = memResource.allocate(50, 8);
+        memResource.deallocate(first, 100, 8);
+        void* third = memResource.allocate(20, 8);
+        memResource.deallocate(second, 50, 8);
+        memResource.deallocate(third, 20, 8);
+
+        REQUIRE(memResource.get_num_allocations() == 3);
+        REQUIRE(memResource.get_peak_allocated_bytes() == 150);
+        REQUIRE(memResource.get_total_allocated_bytes() == 170);
+        REQUIRE(memResource.get_num_live_allocated_bytes() == 0);
+        REQUIRE(memResource.get_allocation_rate() > 0.0);
+    }
+
+    SECTION("Histograms")
+    {
+        void* tiny = memResource.allocate(1, 1);
+        void* small = memResource.allocate(16, 16);
+        void* medium = memResource.allocate(17, 16);
+        void* large = memResource.allocate(4096, 64);
+
+        const auto& sizes = memResource.get_size_histogram();
+        REQUIRE(sizes[0] == 1);
+        REQUIRE(sizes[4] == 1);
+        REQUIRE(sizes[5] == 1);
+        REQUIRE(sizes[12] == 1);
+        const auto& alignments = memResource.get_alignment_histogram();
+        REQUIRE(alignments[0] == 1);
+        REQUIRE(alignments[4] == 2);
+        REQUIRE(alignments[6] == 1);
+
+        memResource.deallocate(tiny, 1, 1);
+        memResource.deallocate(small, 16, 16);
+        memResource.deallocate(medium, 17, 16);
+        memResource.deallocate(large, 4096, 64);
+        REQUIRE(memResource.get_size_histogram()[12] == 1);
+    }
+
+    SECTION("Profile")
+    {
+        void* address = memResource.allocate(24, 8);
+        std::ostringstream profile;
+        memResource.write_profile(profile);
+        memResource.deallocate(address, 24, 8);
+
+        REQUIRE_THAT(profile.str(), Catch::StartsWith("{\"numAllocations\": 1, \"numDeallocations\": 0, \"numLiveAllocations\": 1"));
+        REQUIRE_THAT(profile.str(), Catch::Contains("\"sizes\": {\"32\": 1}, \"alignments\": {\"8\": 1}"));
+        REQUIRE_THAT(profile.str(), Catch::Contains("\"callSites\": []"));
+    }
+
+    SECTION("Call sites")
+    {
+#if defined(MIXEDBAG_TEST_STACKTRACE)
+        // Built with MIXEDBAG_ENABLE_STACKTRACE, so the capture must not be skipped
+        REQUIRE(ARo::bookkeeping_memory_resource::can_capture_call_sites());
+#endif
+        if (!ARo::bookkeeping_memory_resource::can_capture_call_sites()) {
+            REQUIRE_THROWS_WITH(memResource.set_capture_call_sites(true), Catch::Contains("std::stacktrace"));
+            return;
+        }
+
+        memResource.set_capture_call_sites(true);
+        std::vector<void*> repeated;
+        for (int i = 0; i < 3; ++i)
+            repeated.push_back(memResource.allocate(8, 8));
+        void* single = memResource.allocate(100, 8);
+        memResource.set_capture_call_sites(false);
+        void* uncaptured = memResource.allocate(8, 8);
+
+        // The allocations in the loop share a call site, and the single one has another
+        std::ostringstream live;
+        memResource.print_live_allocations(live);
+        REQUIRE_THAT(live.str(), Catch::Contains("3 live allocations, with a total of 24 bytes, from:"));
+        REQUIRE_THAT(live.str(), Catch::Contains("1 live allocations, with a total of 100 bytes, from:"));
+        REQUIRE_THAT(live.str(), Catch::Contains("From an unknown call site"));
+
+        memResource.deallocate(repeated[0], 8, 8);
+        std::ostringstream profile;
+        memResource.write_profile(profile);
+        REQUIRE_THAT(profile.str(), Catch::Contains("{\"numAllocations\": 1, \"numAllocatedBytes\": 100, \"numLiveAllocations\": 1, \"numLiveAllocatedBytes\": 100, "
+                                                    "\"stacktrace\": \""));
+        REQUIRE_THAT(profile.str(), Catch::Contains("{\"numAllocations\": 3, \"numAllocatedBytes\": 24, \"numLiveAllocations\": 2, \"numLiveAllocatedBytes\": 16, "
+                                                    "\"stacktrace\": \""));
+
+        memResource.deallocate(repeated[1], 8, 8);
+        memResource.deallocate(repeated[2], 8, 8);
+        memResource.deallocate(single, 100, 8);
+        memResource.deallocate(uncaptured, 8, 8);
+        REQUIRE(memResource.has_no_leak());
+    }
+}
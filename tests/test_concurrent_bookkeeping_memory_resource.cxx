@@ -0,0 +1,108 @@
+#include <atomic>
+#include <catch.hpp>
+#include <cstddef>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <mixedbag/concurrent_bookkeeping_memory_resource.hxx>
+
+TEST_CASE("concurrent_bookkeeping_memory_resource", "[normal]")
+{
+    ARo::concurrent_bookkeeping_memory_resource memResource;
+
+    SECTION("Diagnostics")
+    {
+        REQUIRE(memResource.is_unused());
+
+        void* foo = memResource.allocate(10, 2);
+        REQUIRE_FALSE(memResource.has_no_leak());
+        REQUIRE(memResource.get_num_live_allocations() == 1);
+        REQUIRE(memResource.get_num_live_allocated_bytes() == 10);
+
+        REQUIRE_THROWS_WITH(memResource.deallocate(foo, 1, 2), Catch::Contains("Mismatched deallocation"));
+        REQUIRE_THROWS_WITH(memResource.deallocate(&foo, 10, 2), Catch::Contains("not allocated by this resource"));
+
+        std::ostringstream out;
+        memResource.print_live_allocations(out);
+        REQUIRE_THAT(out.str(), Catch::Contains("1 live allocations, with a total of 10 bytes"));
+
+        memResource.deallocate(foo, 10, 2);
+        REQUIRE_THROWS_WITH(memResource.deallocate(foo, 10, 2), Catch::Contains("Double free"));
+        REQUIRE(memResource.get_num_deallocations() == 1);
+        REQUIRE(memResource.has_no_leak());
+        REQUIRE_FALSE(memResource.is_unused());
+    }
+
+    SECTION("The freed history is split over the shards")
+    {
+        REQUIRE(memResource.get_freed_history_size() == ARo::concurrent_bookkeeping_memory_resource::DefaultFreedHistorySize);
+
+        const ARo::concurrent_bookkeeping_memory_resource small(std::pmr::get_default_resource(), 100);
+        REQUIRE(small.get_freed_history_size() == 2 * ARo::concurrent_bookkeeping_memory_resource::ShardCount);
+    }
+
+    SECTION("Allocations from many threads")
+    {
+        constexpr std::size_t ThreadCount = 8;
+        constexpr std::size_t AllocationsPerThread = 10'000;
+
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < ThreadCount; ++t) {
+            threads.emplace_back([&memResource, t] {
+                std::vector<void*> addresses;
+                for (std::size_t i = 0; i < AllocationsPerThread; ++i) {
+                    addresses.push_back(memResource.allocate(8 + t, 8));
+                    if (i % 3 == 2) {
+                        memResource.deallocate(addresses.back(), 8 + t, 8);
+                        addresses.pop_back();
+                    }
+                }
+                for (auto* address : addresses)
+                    memResource.deallocate(address, 8 + t, 8);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        REQUIRE(memResource.has_no_leak());
+        REQUIRE(memResource.get_num_live_allocated_bytes() == 0);
+        REQUIRE(memResource.get_num_deallocations() == ThreadCount * AllocationsPerThread);
+    }
+
+    SECTION("Counters never wrap around when another thread deallocates")
+    {
+        constexpr std::size_t Count = 20'000;
+
+        // One thread allocates and hands each allocation over to another, which deallocates it as soon as it can, while a third watches the counters
+        std::vector<std::atomic<void*>> handover(Count);
+        std::atomic<bool> done = false;
+        std::atomic<bool> wrapped = false;
+        std::thread producer([&] {
+            for (auto& slot : handover)
+                slot.store(memResource.allocate(16, 8));
+        });
+        std::thread consumer([&] {
+            for (auto& slot : handover) {
+                void* address = nullptr;
+                while ((address = slot.load()) == nullptr)
+                    std::this_thread::yield();
+                memResource.deallocate(address, 16, 8);
+            }
+            done.store(true);
+        });
+        std::thread watcher([&] {
+            while (!done.load()) {
+                if (memResource.get_num_live_allocations() > Count || memResource.get_num_live_allocated_bytes() > 16 * Count)
+                    wrapped.store(true);
+                std::this_thread::yield();
+            }
+        });
+        producer.join();
+        consumer.join();
+        watcher.join();
+
+        REQUIRE_FALSE(wrapped.load());
+        REQUIRE(memResource.has_no_leak());
+    }
+}
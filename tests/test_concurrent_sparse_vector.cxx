@@ -0,0 +1,122 @@
+#include <atomic>
+#include <catch.hpp>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mixedbag/bookkeeping_memory_resource.hxx>
+#include <mixedbag/concurrent_sparse_vector.hxx>
+
+TEST_CASE("concurrent_sparse_vector Single thread", "[normal]")
+{
+    ARo::bookkeeping_memory_resource memResource;
+
+    {
+        ARo::concurrent_sparse_vector<std::string, std::uint32_t, 64> v(1'000'000, &memResource);
+        REQUIRE(v.empty());
+        REQUIRE(v.begin() == v.end());
+        REQUIRE(v.get_allocator().resource() == &memResource);
+        REQUIRE(memResource.get_num_live_allocations() == 1);
+
+        auto [value, inserted] = v.try_emplace(999'999, "last");
+        REQUIRE(inserted);
+        REQUIRE(*value == "last");
+
+        auto [existing, insertedAgain] = v.insert(999'999, "again");
+        REQUIRE_FALSE(insertedAgain);
+        REQUIRE(existing == value);
+
+        REQUIRE_THROWS(v.insert(1'000'000, "out of range"));
+        REQUIRE(v.find(1'000'000) == nullptr);
+        REQUIRE(v.find(5) == nullptr);
+        REQUIRE_FALSE(v.contains(5));
+
+        ARo::concurrent_sparse_vector<std::string, std::uint32_t, 64>::appender appender(v, 16);
+        for (std::uint32_t i = 0; i < 200; ++i)
+            appender.insert(i * 7, std::to_string(i * 7));
+        REQUIRE_FALSE(appender.insert(14, "duplicate").second);
+
+        REQUIRE(v.size() == 201U);
+        REQUIRE(*v.find(700) == "700");
+        REQUIRE(*std::as_const(v).find(999'999) == "last");
+
+        std::map<std::uint32_t, std::string> seen;
+        for (auto [index, str] : v.items())
+            seen[index] = str;
+        REQUIRE(seen.size() == 201U);
+        REQUIRE(seen[1393] == "1393");
+
+        std::size_t count = 0;
+        for (auto& str : v) {
+            str += "!";
+            ++count;
+        }
+        REQUIRE(count == 201U);
+        REQUIRE(*v.find(0) == "0!");
+    }
+
+    REQUIRE(memResource.has_no_leak());
+}
+
+TEST_CASE("concurrent_sparse_vector Maximal index limit", "[normal]")
+{
+    // A huge page size keeps the page table small, so that the limit itself is what is being tested
+    constexpr auto pageSize = std::size_t{1} << (std::numeric_limits<std::size_t>::digits - 2);
+    constexpr auto limit = std::numeric_limits<std::size_t>::max();
+
+    ARo::concurrent_sparse_vector<int, std::size_t, pageSize> v(limit);
+    REQUIRE(v.index_limit() == limit);
+    REQUIRE(v.find(limit - 1) == nullptr);
+    REQUIRE_FALSE(v.contains(limit - 1));
+    REQUIRE_THROWS(v.insert(limit, 1));
+}
+
+TEST_CASE("concurrent_sparse_vector Multiple threads", "[normal]")
+{
+    constexpr std::uint32_t ThreadCount = 4;
+    constexpr std::uint32_t PerThread = 20'000;
+
+    ARo::concurrent_sparse_vector<std::uint64_t, std::uint32_t, 256> v(ThreadCount * PerThread * 2);
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> readerErrors{0};
+
+    // A reader that keeps iterating and looking up while the writers insert (Catch2 assertions are not thread safe, so count the errors instead)
+    std::thread reader([&] {
+        while (!done.load()) {
+            for (auto [index, value] : v.items()) {
+                if (value != index * 3U)
+                    readerErrors.fetch_add(1);
+            }
+            if (const auto* value = v.find(42); value != nullptr && *value != 126U)
+                readerErrors.fetch_add(1);
+        }
+    });
+
+    std::vector<std::thread> writers;
+    std::atomic<std::uint32_t> insertedCount{0};
+    for (std::uint32_t t = 0; t < ThreadCount; ++t) {
+        writers.emplace_back([&, t] {
+            decltype(v)::appender appender(v);
+            for (std::uint32_t i = 0; i < PerThread; ++i) {
+                // Half of the indices are shared between pairs of threads, to make them race on the same index
+                const auto index = i % 2 == 0 ? (t / 2) * PerThread + i : ThreadCount * PerThread + t * PerThread + i;
+                if (t % 2 == 0 ? appender.insert(index, index * 3U).second : v.insert(index, index * 3U).second)
+                    insertedCount.fetch_add(1);
+            }
+        });
+    }
+    for (auto& writer : writers)
+        writer.join();
+    done = true;
+    reader.join();
+    REQUIRE(readerErrors == 0U);
+
+    const auto expectedSize = ThreadCount * PerThread / 2 + ThreadCount / 2 * PerThread / 2;
+    REQUIRE(insertedCount == expectedSize);
+    REQUIRE(v.size() == expectedSize);
+    REQUIRE(static_cast<std::size_t>(std::ranges::distance(v.items())) == expectedSize);
+    for (auto [index, value] : v.items())
+        REQUIRE(*v.find(index) == index * 3U);
+}
@@ -0,0 +1,172 @@
+#include <atomic>
+#include <catch.hpp>
+#include <cstddef>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <mixedbag/bookkeeping_memory_resource.hxx>
+#include <mixedbag/counting_memory_resource.hxx>
+
+TEST_CASE("counting_memory_resource", "[normal]")
+{
+    SECTION("Counters")
+    {
+        ARo::bookkeeping_memory_resource upstream;
+        ARo::counting_memory_resource memResource(&upstream, 1);
+        REQUIRE(memResource.upstream_resource() == &upstream);
+        REQUIRE(memResource.snapshot().numAllocations == 0);
+
+        void* first = memResource.allocate(100, 8);
+        void* second = memResource.allocate(50, 16);
+        auto counters = memResource.snapshot();
+        REQUIRE(counters.numAllocations == 2);
+        REQUIRE(counters.numAllocatedBytes == 150);
+        REQUIRE(counters.live_allocations() == 2);
+        REQUIRE(counters.live_bytes() == 150);
+
+        memResource.deallocate(first, 100, 8);
+        void* third = memResource.allocate(20, 8);
+        memResource.deallocate(second, 50, 16);
+        memResource.deallocate(third, 20, 8);
+
+        counters = memResource.snapshot();
+        REQUIRE(counters.numAllocations == 3);
+        REQUIRE(counters.numDeallocations == 3);
+        REQUIRE(counters.numAllocatedBytes == 170);
+        REQUIRE(counters.numDeallocatedBytes == 170);
+        REQUIRE(counters.live_bytes() == 0);
+        REQUIRE(counters.peakAllocatedBytes == 150);
+        REQUIRE(counters.numFailures == 0);
+        REQUIRE(upstream.has_no_leak());
+    }
+
+    SECTION("Peak granularity")
+    {
+        ARo::counting_memory_resource memResource(std::pmr::get_default_resource(), 1024);
+
+        // Not published yet, but the live bytes are reported as the peak
+        void* small = memResource.allocate(100, 8);
+        REQUIRE(memResource.snapshot().peakAllocatedBytes == 100);
+        void* large = memResource.allocate(1000, 8);
+        REQUIRE(memResource.snapshot().peakAllocatedBytes == 1100);
+
+        memResource.deallocate(small, 100, 8);
+        memResource.deallocate(large, 1000, 8);
+        REQUIRE(memResource.snapshot().peakAllocatedBytes == 1100);
+    }
+
+    SECTION("Peak of small allocations under the default granularity")
+    {
+        ARo::counting_memory_resource memResource(std::pmr::get_default_resource());
+
+        void* address = memResource.allocate(64, 8);
+        const auto counters = memResource.snapshot();
+        REQUIRE(counters.live_bytes() == 64);
+        REQUIRE(counters.peakAllocatedBytes == 64);
+
+        memResource.deallocate(address, 64, 8);
+    }
+
+    SECTION("Failures")
+    {
+        ARo::counting_memory_resource memResource(std::pmr::null_memory_resource());
+
+        REQUIRE_THROWS_AS(memResource.allocate(8, 8), std::bad_alloc);
+        const auto counters = memResource.snapshot();
+        REQUIRE(counters.numFailures == 1);
+        REQUIRE(counters.numAllocations == 0);
+    }
+
+    SECTION("Allocations from many threads")
+    {
+        constexpr std::size_t ThreadCount = 8;
+        constexpr std::size_t AllocationsPerThread = 10'000;
+
+        ARo::counting_memory_resource memResource;
+        std::vector<void*> survivors(ThreadCount);
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < ThreadCount; ++t) {
+            threads.emplace_back([&memResource, &survivors, t] {
+                for (std::size_t i = 0; i < AllocationsPerThread; ++i)
+                    memResource.deallocate(memResource.allocate(8 + t, 8), 8 + t, 8);
+                survivors[t] = memResource.allocate(8, 8);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        // Deallocated by another thread than the one that allocated them
+        for (auto* address : survivors)
+            memResource.deallocate(address, 8, 8);
+
+        std::size_t expectedBytes = 0;
+        for (std::size_t t = 0; t < ThreadCount; ++t)
+            expectedBytes += AllocationsPerThread * (8 + t) + 8;
+
+        const auto counters = memResource.snapshot();
+        REQUIRE(counters.numAllocations == ThreadCount * (AllocationsPerThread + 1));
+        REQUIRE(counters.numDeallocations == counters.numAllocations);
+        REQUIRE(counters.numAllocatedBytes == expectedBytes);
+        REQUIRE(counters.live_bytes() == 0);
+    }
+
+    SECTION("Slots are handed back by threads that exit")
+    {
+        constexpr std::size_t ThreadCount = 500;
+
+        ARo::counting_memory_resource memResource;
+        memResource.deallocate(memResource.allocate(8, 8), 8, 8);
+        const auto freeSlots = ARo::counting_memory_resource::get_num_free_slots();
+
+        // Far more threads than slots over time, but only a few at once, so that each gets a slot of its own
+        std::atomic<bool> ownSlots = true;
+        for (std::size_t first = 0; first < ThreadCount; first += 4) {
+            std::vector<std::thread> threads;
+            for (std::size_t t = first; t < first + 4; ++t) {
+                threads.emplace_back([&memResource, &ownSlots, t] {
+                    memResource.deallocate(memResource.allocate(8 + t, 8), 8 + t, 8);
+                    if (ARo::counting_memory_resource::get_num_free_slots() == 0)
+                        ownSlots = false;
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+        }
+        REQUIRE(ownSlots);
+        REQUIRE(ARo::counting_memory_resource::get_num_free_slots() == freeSlots);
+
+        // The counts of the threads that exited are kept
+        const auto counters = memResource.snapshot();
+        REQUIRE(counters.numAllocations == ThreadCount + 1);
+        REQUIRE(counters.numAllocatedBytes == 8 + ThreadCount * 8 + ThreadCount * (ThreadCount - 1) / 2);
+        REQUIRE(counters.live_bytes() == 0);
+    }
+
+    SECTION("Threads beyond the slots share one")
+    {
+        constexpr std::size_t ThreadCount = 80;
+        constexpr std::size_t AllocationsPerThread = 1000;
+
+        ARo::counting_memory_resource memResource;
+        std::atomic<std::size_t> ready = 0;
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < ThreadCount; ++t) {
+            threads.emplace_back([&memResource, &ready] {
+                // All threads hold on to their slot until all have one
+                memResource.deallocate(memResource.allocate(8, 8), 8, 8);
+                ++ready;
+                while (ready.load() < ThreadCount)
+                    std::this_thread::yield();
+                for (std::size_t i = 1; i < AllocationsPerThread; ++i)
+                    memResource.deallocate(memResource.allocate(8, 8), 8, 8);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        const auto counters = memResource.snapshot();
+        REQUIRE(counters.numAllocations == ThreadCount * AllocationsPerThread);
+        REQUIRE(counters.numDeallocatedBytes == 8 * ThreadCount * AllocationsPerThread);
+    }
+}
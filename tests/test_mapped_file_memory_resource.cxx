@@ -0,0 +1,185 @@
+#include <catch.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <string>
+#include <unistd.h>
+
+#include <mixedbag/mapped_file_memory_resource.hxx>
+#include <mixedbag/sparse_vector.hxx>
+#include <mixedbag/sparse_vector_view.hxx>
+
+namespace {
+
+// Removes the file when going out of scope
+struct TemporaryFile {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / ("mixedbag_test_" + std::to_string(::getpid()) + ".heap");
+
+    TemporaryFile()
+    {
+        std::filesystem::remove(path);
+    }
+
+    ~TemporaryFile()
+    {
+        std::filesystem::remove(path);
+    }
+};
+
+} // namespace
+
+TEST_CASE("mapped_file_memory_resource", "[normal]")
+{
+    const TemporaryFile file;
+
+    SECTION("Allocations are reused and aligned")
+    {
+        ARo::mapped_file_memory_resource memResource(file.path);
+        REQUIRE(memResource.root().empty());
+        REQUIRE(memResource.get_num_allocated_bytes() == 0);
+
+        void* a = memResource.allocate(10, 8);
+        void* b = memResource.allocate(100, 16);
+        REQUIRE(memResource.get_num_allocated_bytes() == 64 + 128);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(b) % 128 == 0);
+
+        void* page = memResource.allocate(64, 4096);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(page) % 4096 == 0);
+        REQUIRE_THROWS_AS(memResource.allocate(64, 8192), std::bad_alloc);
+
+        memResource.deallocate(a, 10, 8);
+        REQUIRE(memResource.allocate(50, 4) == a);
+        memResource.deallocate(a, 50, 4);
+        memResource.deallocate(b, 100, 16);
+        memResource.deallocate(page, 64, 4096);
+        REQUIRE(memResource.get_num_allocated_bytes() == 0);
+
+        int local = 0;
+        REQUIRE_THROWS(memResource.deallocate(&local, sizeof(local), alignof(int)));
+    }
+
+    SECTION("The file grows without moving allocations")
+    {
+        ARo::mapped_file_memory_resource memResource(file.path);
+        ARo::sparse_vector<std::uint64_t> v(&memResource);
+        for (std::uint64_t i = 0; i < 200'000; ++i)
+            v.insert(i * 2, i);
+        REQUIRE(memResource.get_file_size() > 4 * 1024 * 1024);
+        REQUIRE(memResource.get_file_size() == std::filesystem::file_size(file.path));
+        REQUIRE(v[199'998] == 99'999);
+
+        auto* first = &v[0];
+        REQUIRE(reinterpret_cast<std::byte*>(memResource.allocate(8 * 1024 * 1024, 8)) != nullptr);
+        REQUIRE(&v[0] == first);
+    }
+
+    SECTION("Running out of space")
+    {
+        ARo::mapped_file_memory_resource memResource(file.path, 1024 * 1024);
+        void* a = memResource.allocate(256 * 1024, 8);
+        REQUIRE_THROWS_AS(memResource.allocate(768 * 1024, 8), std::bad_alloc);
+        memResource.deallocate(a, 256 * 1024, 8);
+
+        // Sizes that cannot be rounded up to a block size
+        REQUIRE_THROWS_AS(memResource.allocate(std::numeric_limits<std::size_t>::max(), 8), std::bad_alloc);
+        REQUIRE_THROWS_AS(memResource.allocate(std::numeric_limits<std::size_t>::max() / 2 + 2, 8), std::bad_alloc);
+        REQUIRE_THROWS(memResource.deallocate(a, std::numeric_limits<std::size_t>::max(), 8));
+    }
+
+    SECTION("Contents survive reopening")
+    {
+        ARo::sparse_vector<double, std::uint32_t> v;
+        for (std::uint32_t i = 0; i < 1000; i += 7)
+            v.insert(i, i * 1.5);
+
+        {
+            ARo::mapped_file_memory_resource memResource(file.path);
+            auto* snapshot = static_cast<std::byte*>(memResource.allocate(v.snapshot_size(), 64));
+            v.write_snapshot({snapshot, v.snapshot_size()});
+            memResource.set_root({snapshot, v.snapshot_size()});
+            REQUIRE(memResource.root().data() == snapshot);
+            memResource.flush();
+
+            int local = 0;
+            REQUIRE_THROWS_AS(memResource.set_root(std::as_bytes(std::span(&local, 1))), std::invalid_argument);
+        }
+
+        ARo::mapped_file_memory_resource memResource(file.path);
+        REQUIRE(memResource.get_num_allocated_bytes() >= v.snapshot_size());
+
+        const ARo::sparse_vector_view<double, std::uint32_t> view(memResource.root());
+        REQUIRE(view.size() == v.size());
+        REQUIRE(view[994] == 994 * 1.5);
+
+        auto restored = ARo::sparse_vector<double, std::uint32_t>::from_snapshot(memResource.root(), &memResource);
+        REQUIRE(restored == v);
+        restored = {};
+    }
+
+    SECTION("A root outside of the heap is rejected")
+    {
+        {
+            ARo::mapped_file_memory_resource memResource(file.path);
+            auto* root = static_cast<std::byte*>(memResource.allocate(64, 8));
+            memResource.set_root({root, 64});
+            memResource.flush();
+        }
+
+        {
+            // Overwrite rootSize, which follows magic, version, byteOrder, top, allocatedBytes and rootOffset in the header
+            std::fstream io(file.path, std::ios::in | std::ios::out | std::ios::binary);
+            io.seekp(40);
+            const auto rootSize = std::numeric_limits<std::uint64_t>::max();
+            io.write(reinterpret_cast<const char*>(&rootSize), sizeof(rootSize));
+        }
+        REQUIRE_THROWS_WITH(ARo::mapped_file_memory_resource(file.path), Catch::Contains("corrupt file"));
+    }
+
+    SECTION("A free list outside of the heap is rejected")
+    {
+        {
+            ARo::mapped_file_memory_resource memResource(file.path);
+            memResource.deallocate(memResource.allocate(64, 8), 64, 8);
+            memResource.flush();
+        }
+
+        // The free list of the smallest blocks follows rootSize in the header
+        constexpr std::streamoff freeListOffset = 48;
+        std::uint64_t block = 0;
+        {
+            std::fstream io(file.path, std::ios::in | std::ios::out | std::ios::binary);
+            io.seekg(freeListOffset);
+            io.read(reinterpret_cast<char*>(&block), sizeof(block));
+            REQUIRE(block != 0);
+
+            const auto outside = block + (std::uint64_t{1} << 40);
+            io.seekp(freeListOffset);
+            io.write(reinterpret_cast<const char*>(&outside), sizeof(outside));
+        }
+        REQUIRE_THROWS_AS(ARo::mapped_file_memory_resource(file.path), std::runtime_error);
+
+        {
+            // Restore the head, and make the next block in the list misaligned instead
+            std::fstream io(file.path, std::ios::in | std::ios::out | std::ios::binary);
+            io.seekp(freeListOffset);
+            io.write(reinterpret_cast<const char*>(&block), sizeof(block));
+            const auto misaligned = block + 1;
+            io.seekp(static_cast<std::streamoff>(block));
+            io.write(reinterpret_cast<const char*>(&misaligned), sizeof(misaligned));
+        }
+        ARo::mapped_file_memory_resource memResource(file.path);
+        REQUIRE_THROWS_AS(memResource.allocate(64, 8), std::runtime_error);
+    }
+
+    SECTION("Other files are rejected")
+    {
+        {
+            std::ofstream out(file.path);
+            out << "This is not a heap";
+        }
+        REQUIRE_THROWS(ARo::mapped_file_memory_resource(file.path));
+        REQUIRE_THROWS(ARo::mapped_file_memory_resource(std::filesystem::path("/nonexistent/directory/file.heap")));
+    }
+}
@@ -0,0 +1,134 @@
+#include <array>
+#include <algorithm>
+#include <catch.hpp>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include <mixedbag/bookkeeping_memory_resource.hxx>
+#include <mixedbag/sparse_join.hxx>
+
+TEST_CASE("sparse_join_view", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+
+    ARo::sparse_vector<int> a(&memResource);
+    ARo::sparse_vector<double, std::size_t, false> b(&memResource);
+    ARo::sparse_vector<std::string, std::size_t, true, 64> c(&memResource);
+
+    for (std::size_t i = 0; i < 100; ++i)
+        a.insert(i, static_cast<int>(i));
+    for (std::size_t i = 0; i < 100; i += 2)
+        b.insert(i, static_cast<double>(i) / 2);
+    for (std::size_t i = 0; i < 1000; i += 3)
+        c.insert(i, std::to_string(i));
+    a.erase(30);
+
+    SECTION("Intersection of three")
+    {
+        std::map<std::size_t, std::string> seen;
+        for (auto [index, x, y, z] : ARo::join(a, b, c)) {
+            REQUIRE(static_cast<std::size_t>(x) == index);
+            REQUIRE(y * 2 == static_cast<double>(index));
+            seen[index] = z;
+        }
+
+        std::map<std::size_t, std::string> expected;
+        for (std::size_t i = 0; i < 100; i += 6) {
+            if (i != 30)
+                expected[i] = std::to_string(i);
+        }
+        REQUIRE(seen == expected);
+    }
+
+    SECTION("Iterators outlive the view")
+    {
+        static_assert(std::ranges::borrowed_range<decltype(ARo::join(a, b))>);
+
+        // The view is a temporary, and the iterators are used after it is destroyed
+        const auto found = std::ranges::find_if(ARo::join(a, b), [](const auto& item) { return std::get<0>(item) == 42; });
+        REQUIRE(std::get<2>(*found) == 21.0);
+
+        auto it = ARo::join(a, b).begin();
+        REQUIRE(std::get<0>(*it) == 0U);
+        auto view = ARo::join(a, b);
+        auto copiedFrom = std::ranges::next(view.begin());
+        const auto copy = std::move(view);
+        view = ARo::join(a, b);
+        REQUIRE(std::ranges::distance(copiedFrom, copy.end()) == 48);
+        REQUIRE(std::get<0>(*++it) == 2U);
+    }
+
+    SECTION("Modification through the view")
+    {
+        const auto& cb = b;
+        static_assert(std::ranges::forward_range<decltype(ARo::join(a, cb))>);
+        static_assert(std::is_same_v<std::tuple_element_t<2, std::ranges::range_value_t<decltype(ARo::join(a, cb))>>, const double&>);
+
+        for (auto [index, x, y] : ARo::join(a, cb))
+            x = -static_cast<int>(y);
+
+        REQUIRE(a[40] == -20);
+        REQUIRE(a[41] == 41);
+        REQUIRE(std::ranges::distance(ARo::join(cb, a)) == 49);
+    }
+
+    SECTION("Modification through the view discards the cached content hash")
+    {
+        ARo::sparse_vector<int, std::size_t, true, 0, 0, false, true> cached(&memResource);
+        ARo::sparse_vector<int, std::size_t, true, 0, 0, false, true> cached2(&memResource);
+        for (const auto [index, value] : std::as_const(a).items()) {
+            cached.insert(index, value);
+            cached2.insert(index, value);
+        }
+        cached2[40] = -1;
+
+        REQUIRE(cached.content_hash() != cached2.content_hash());
+        for (auto [index, x, y] : ARo::join(cached, std::as_const(b))) {
+            if (index == 40)
+                x = -1;
+        }
+        REQUIRE(cached.equal_with_hash(cached2));
+
+        // A const view leaves the cache alone
+        const auto hash = std::as_const(cached).content_hash();
+        REQUIRE(std::ranges::distance(ARo::join(std::as_const(cached), std::as_const(b))) == 49);
+        REQUIRE(std::as_const(cached).content_hash() == hash);
+    }
+
+    SECTION("Modification through the view is tracked")
+    {
+        ARo::sparse_vector<int, std::size_t, true, 0, 0, true> tracked(&memResource);
+        for (std::size_t i = 0; i < 10; ++i)
+            tracked.insert(i, static_cast<int>(i));
+        const auto epoch = tracked.next_epoch();
+
+        for (auto [index, x, y] : ARo::join(std::as_const(tracked), std::as_const(b)))
+            (void)x;
+        REQUIRE(std::ranges::distance(tracked.changed_since(epoch)) == 0);
+
+        for (auto [index, x, y] : ARo::join(tracked, std::as_const(b)))
+            x = -x;
+        REQUIRE(tracked[4] == -4);
+        REQUIRE(std::ranges::distance(tracked.changed_since(epoch)) == 10);
+    }
+
+    SECTION("Empty intersections")
+    {
+        ARo::sparse_vector<int> empty(&memResource);
+        REQUIRE(ARo::join(a, empty).empty());
+        REQUIRE(ARo::join(empty, a, c).empty());
+
+        ARo::sparse_vector<int> disjoint(&memResource);
+        disjoint.insert(1, 1);
+        disjoint.insert(2000, 2);
+        REQUIRE(ARo::join(c, disjoint).empty());
+    }
+
+    SECTION("Single sparse_vector")
+    {
+        REQUIRE(std::ranges::distance(ARo::join(c)) == static_cast<std::ptrdiff_t>(c.size()));
+    }
+}
@@ -0,0 +1,174 @@
+#include <array>
+#include <catch.hpp>
+#include <map>
+#include <string>
+
+#include <mixedbag/bookkeeping_memory_resource.hxx>
+#include <mixedbag/sparse_multi_vector.hxx>
+
+namespace ARo::Test {
+
+struct Vec2 {
+    float x;
+    float y;
+
+    bool operator==(const Vec2&) const noexcept = default;
+};
+
+using Entities = sparse_multi_vector<Vec2, Vec2, std::string>;
+
+struct ThrowingType {
+    int value;
+
+    explicit ThrowingType(int val)
+        : value(val)
+    {
+        if (val < 0)
+            throw std::runtime_error("negative value");
+    }
+};
+
+template <typename SizeT, bool Checked, std::size_t PageSize, typename... Ts>
+std::map<SizeT, std::tuple<Ts...>> toMap(const basic_sparse_multi_vector<SizeT, Checked, PageSize, Ts...>& v)
+{
+    std::map<SizeT, std::tuple<Ts...>> result;
+    for (const auto& item : v.items()) {
+        result.emplace(std::get<0>(item), std::apply([](auto, const auto&... values) { return std::tuple<Ts...>{values...}; }, item));
+    }
+    return result;
+}
+
+} // namespace ARo::Test
+
+TEST_CASE("sparse_multi_vector Construction", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+    std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+    ARo::Test::Entities v(testAllocator);
+    REQUIRE(v.empty());
+    REQUIRE(v.size() == 0U);
+    REQUIRE(v.get_allocator() == testAllocator);
+    REQUIRE(memResource.is_unused());
+
+    v.insert(3, ARo::Test::Vec2{1, 2}, ARo::Test::Vec2{0, 1}, "three");
+    v.insert(7, ARo::Test::Vec2{3, 4}, ARo::Test::Vec2{1, 0}, "seven");
+
+    const ARo::Test::Entities copy{v, testAllocator};
+    REQUIRE(copy.get_allocator() == testAllocator);
+    REQUIRE(ARo::Test::toMap(copy) == ARo::Test::toMap(v));
+
+    ARo::bookkeeping_memory_resource memResource2(&bufferResource);
+    ARo::Test::Entities moved{std::move(v), &memResource2};
+    REQUIRE(ARo::Test::toMap(moved) == ARo::Test::toMap(copy));
+    REQUIRE(!memResource2.is_unused());
+}
+
+TEST_CASE("sparse_multi_vector Modifiers and access", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+
+    ARo::Test::Entities v(&memResource);
+    auto [pos, vel, name] = v.insert(10, ARo::Test::Vec2{1, 1}, ARo::Test::Vec2{2, 2}, "ten");
+    pos.x = 5;
+    REQUIRE(v.get<0>(10) == ARo::Test::Vec2{5, 1});
+    REQUIRE(vel == ARo::Test::Vec2{2, 2});
+    REQUIRE(name == "ten");
+
+    v.insert(2, ARo::Test::Vec2{}, ARo::Test::Vec2{}, "two");
+    v.insert(30, ARo::Test::Vec2{3, 0}, ARo::Test::Vec2{}, "thirty");
+    REQUIRE(v.size() == 3U);
+    REQUIRE(v.contains(2));
+    REQUIRE_FALSE(v.contains(3));
+    REQUIRE_FALSE(v.contains(1000));
+
+    REQUIRE_THROWS(v.insert(2, ARo::Test::Vec2{}, ARo::Test::Vec2{}, "again"));
+    REQUIRE_THROWS(v[3]);
+    REQUIRE_THROWS(v.get<2>(1000));
+    REQUIRE(std::get<2>(v[30]) == "thirty");
+    REQUIRE(std::get<2>(std::as_const(v)[2]) == "two");
+
+    v.erase(2);
+    REQUIRE_THROWS(v.erase(2));
+    REQUIRE(v.size() == 2U);
+    REQUIRE(v.get<2>(10) == "ten");
+    REQUIRE(v.get<2>(30) == "thirty");
+    REQUIRE(v.get<0>(30) == ARo::Test::Vec2{3, 0});
+
+    v.erase(30);
+    v.erase(10);
+    REQUIRE(v.empty());
+}
+
+TEST_CASE("sparse_multi_vector Failed insert", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+
+    ARo::sparse_multi_vector<int, ARo::Test::ThrowingType> v(&memResource);
+    v.insert(1, 10, 10);
+    REQUIRE_THROWS(v.insert(2, 20, -20));
+    REQUIRE(v.size() == 1U);
+    REQUIRE_FALSE(v.contains(2));
+    REQUIRE(v.column<0>().size() == 1U);
+    REQUIRE(v.column<1>().size() == 1U);
+
+    v.insert(2, 20, 20);
+    REQUIRE(v.get<1>(2).value == 20);
+}
+
+TEST_CASE("sparse_multi_vector Iteration", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+
+    ARo::basic_sparse_multi_vector<std::uint32_t, true, 64, float, int> v(&memResource);
+    for (std::uint32_t i = 0; i < 10; ++i)
+        v.insert(i * 100, static_cast<float>(i), static_cast<int>(i) * 2);
+    v.erase(300);
+
+    SECTION("Per column")
+    {
+        const auto values = v.column<0>();
+        const auto factors = v.column<1>();
+        const auto indices = v.indices();
+        REQUIRE(values.size() == 9U);
+        REQUIRE(factors.size() == 9U);
+        REQUIRE(indices.size() == 9U);
+
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            REQUIRE(values[i] * 100 == static_cast<float>(indices[i]));
+            REQUIRE(factors[i] * 50 == static_cast<int>(indices[i]));
+        }
+
+        for (auto& value : v.column<0>())
+            value *= 2;
+        REQUIRE(v.get<0>(500) == 10.0F);
+    }
+
+    SECTION("Zipped")
+    {
+        static_assert(std::ranges::random_access_range<decltype(v)>);
+        for (auto [value, factor] : v)
+            value *= static_cast<float>(factor);
+        REQUIRE(v.get<0>(400) == 32.0F);
+
+        std::map<std::uint32_t, int> seen;
+        for (auto [index, value, factor] : std::as_const(v).items())
+            seen[index] = factor;
+        REQUIRE(seen.size() == 9U);
+        REQUIRE_FALSE(seen.contains(300));
+        REQUIRE(seen[900] == 18);
+
+        REQUIRE(std::ranges::distance(v.begin(), v.end()) == 9);
+        ARo::basic_sparse_multi_vector<std::uint32_t, true, 64, float, int>::const_iterator it = v.begin();
+        REQUIRE(it == v.cbegin());
+        REQUIRE(std::get<1>(it[2]) == std::get<1>(*(v.begin() + 2)));
+    }
+}
@@ -1,8 +1,20 @@
 #include <array>
 #include <catch.hpp>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <span>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include <mixedbag/bookkeeping_memory_resource.hxx>
 #include <mixedbag/sparse_vector.hxx>
+#include <mixedbag/sparse_vector_execution.hxx>
 
 namespace ARo::Test {
 
@@ -28,6 +40,36 @@ struct NonDefaultConstructibleMoveOnlyType {
 };
 
 
+// Forwards to an upstream resource, but throws std::bad_alloc for allocations of failSize bytes while armed, after letting numToSkip of them through
+struct FailOnSizeResource final : std::pmr::memory_resource {
+    std::pmr::memory_resource* upstream;
+    std::size_t failSize = 0;
+    std::size_t numToSkip = 0;
+    bool armed = false;
+
+    explicit FailOnSizeResource(std::pmr::memory_resource* up, std::size_t size)
+        : upstream(up)
+        , failSize(size)
+    {}
+
+    void* do_allocate(std::size_t byteCount, std::size_t alignment) override
+    {
+        if (armed && byteCount == failSize && numToSkip-- == 0)
+            throw std::bad_alloc();
+        return upstream->allocate(byteCount, alignment);
+    }
+
+    void do_deallocate(void* address, std::size_t byteCount, std::size_t alignment) override
+    {
+        upstream->deallocate(address, byteCount, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return &other == this;
+    }
+};
+
 template <typename ValT>
 struct IndexValuePair {
     std::size_t idx;
@@ -228,7 +270,7 @@ TEST_CASE("sparse_vector Construction", "[normal]")
                 REQUIRE(memResource.get_num_live_allocations() == memResource1InitialAllocationCount);
                 REQUIRE(v2.get_allocator() == testAllocator2);
                 REQUIRE(!memResource2.is_unused());
-                REQUIRE(memResource2.get_num_live_allocations() == 2);
+                REQUIRE(memResource2.get_num_live_allocations() == 3);
             }
         }
     }
@@ -333,6 +375,78 @@ TEST_CASE("sparse_vector Modifiers", "[normal]")
         REQUIRE_THROWS(v.emplace(255, 33));
 }
 
+    SECTION("Move-only values and multiple constructor arguments")
+    {
+        ARo::bookkeeping_memory_resource memResource(&bufferResource);
+        std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+        ARo::sparse_vector<std::unique_ptr<int>, std::uint8_t> pointers(testAllocator);
+        auto value = std::make_unique<int>(7);
+        const auto* address = value.get();
+        pointers.insert(3, std::move(value));
+        REQUIRE(pointers[3].get() == address);
+        pointers.emplace(4, new int(8));
+        REQUIRE(*pointers[4] == 8);
+
+        ARo::sparse_vector<std::string, std::uint8_t> strings(testAllocator);
+        REQUIRE(strings.emplace(1, 3U, 'x') == "xxx");
+        REQUIRE(strings.emplace(2, "abcdef", 2U) == "ab");
+    }
+
+    SECTION("try_emplace and insert_or_assign")
+    {
+        ARo::bookkeeping_memory_resource memResource(&bufferResource);
+        std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+        ARo::sparse_vector<std::unique_ptr<int>, std::uint8_t> v(testAllocator);
+        auto [inserted, wasInserted] = v.try_emplace(2, std::make_unique<int>(1));
+        REQUIRE(wasInserted);
+        REQUIRE(*inserted == 1);
+
+        auto value = std::make_unique<int>(2);
+        auto [existing, wasInsertedAgain] = v.try_emplace(2, std::move(value));
+        REQUIRE_FALSE(wasInsertedAgain);
+        REQUIRE(*existing == 1);
+        REQUIRE(value != nullptr); // Not moved from, since nothing was constructed
+
+        auto [assigned, wasAssignedByInsert] = v.insert_or_assign(2, std::move(value));
+        REQUIRE_FALSE(wasAssignedByInsert);
+        REQUIRE(*assigned == 2);
+        REQUIRE(v.size() == 1U);
+
+        REQUIRE(v.insert_or_assign(5, std::make_unique<int>(5)).second);
+        REQUIRE(*v[5] == 5);
+        REQUIRE(v.size() == 2U);
+    }
+
+    SECTION("A failed insertion leaves the sparse_vector unchanged")
+    {
+        ARo::bookkeeping_memory_resource memResource(&bufferResource);
+        std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+        struct ThrowsOnNegative {
+            int value;
+
+            explicit ThrowsOnNegative(int val)
+                : value(val)
+            {
+                if (val < 0)
+                    throw std::invalid_argument("negative");
+            }
+
+            auto operator<=>(const ThrowsOnNegative& other) const = default;
+        };
+
+        ARo::sparse_vector<ThrowsOnNegative, std::uint8_t> v(testAllocator);
+        v.emplace(1, 1);
+        REQUIRE_THROWS_AS(v.emplace(2, -1), std::invalid_argument);
+        REQUIRE_THROWS_AS(v.try_emplace(2, -1), std::invalid_argument);
+        REQUIRE(v.size() == 1U);
+        REQUIRE_THROWS(v[2]);
+        REQUIRE(v.emplace(2, 2).value == 2);
+        REQUIRE(v[1].value == 1);
+    }
+
     SECTION("Erase")
     {
         ARo::bookkeeping_memory_resource memResource(&bufferResource);
@@ -375,6 +489,155 @@ TEST_CASE("sparse_vector Modifiers", "[normal]")
         expected.erase(25);
         REQUIRE(ARo::Test::equals(v, expected));
     }
+
+    SECTION("Erase and reinsert")
+    {
+        ARo::bookkeeping_memory_resource memResource(&bufferResource);
+        std::pmr::polymorphic_allocator testAllocator(&memResource);
+        ARo::sparse_vector<int, std::uint16_t> v(testAllocator);
+        std::map<std::uint16_t, int> expected;
+
+        for (std::uint16_t i = 0; i < 20; ++i) {
+            v.insert(i * 3, i);
+            expected[i * 3] = i;
+        }
+
+        for (std::uint16_t i = 0; i < 20; i += 3) {
+            v.erase(i * 3);
+            expected.erase(i * 3);
+            REQUIRE(ARo::Test::equals(v, expected));
+        }
+
+        for (std::uint16_t i = 0; i < 20; i += 6) {
+            v.insert(i * 3, -i);
+            expected[i * 3] = -i;
+            REQUIRE(ARo::Test::equals(v, expected));
+        }
+
+        for (auto [idx, val] : std::map{expected}) {
+            v.erase(idx);
+            expected.erase(idx);
+            REQUIRE(ARo::Test::equals(v, expected));
+        }
+        REQUIRE(v.empty());
+    }
+}
+
+TEST_CASE("sparse_vector Bulk operations", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+
+    SECTION("Construction from unsorted pairs")
+    {
+        ARo::bookkeeping_memory_resource memResource(&bufferResource);
+        std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+        const std::vector<std::pair<std::size_t, int>> pairs{{8, 3}, {0, 1}, {5, 14}};
+        const ARo::sparse_vector<int> v(pairs, testAllocator);
+
+        REQUIRE(ARo::Test::equals(v, std::map<std::size_t, int>{{0, 1}, {5, 14}, {8, 3}}));
+        REQUIRE(v.get_allocator() == testAllocator);
+        // The index, the back-index and the data are allocated exactly once each
+        REQUIRE(memResource.get_num_live_allocations() == 3);
+        REQUIRE(memResource.get_num_deallocations() == 0);
+    }
+
+    SECTION("Construction from a map and from tuples")
+    {
+        const std::map<std::uint16_t, int> m{{3, 30}, {1, 10}, {700, 7}};
+        const ARo::sparse_vector<int, std::uint16_t> v1(m);
+        REQUIRE(ARo::Test::equals(v1, m));
+
+        const std::vector<std::tuple<std::uint16_t, int>> tuples{{3, 30}, {700, 7}, {1, 10}};
+        const ARo::sparse_vector<int, std::uint16_t, true, 256> v2(tuples);
+        REQUIRE(v2.size() == 3U);
+        REQUIRE(v2[700] == 7);
+    }
+
+    SECTION("insert_range")
+    {
+        ARo::bookkeeping_memory_resource memResource(&bufferResource);
+        std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+        auto v = ARo::Test::makeVec<ARo::Test::NonDefaultConstructibleMoveOnlyType, int>(testAllocator, {
+            {2, 20},
+        });
+
+        std::vector<std::pair<std::size_t, ARo::Test::NonDefaultConstructibleMoveOnlyType>> pairs;
+        pairs.emplace_back(9, ARo::Test::NonDefaultConstructibleMoveOnlyType{90});
+        pairs.emplace_back(4, ARo::Test::NonDefaultConstructibleMoveOnlyType{40});
+        v.insert_range(pairs | std::views::transform([](auto& p) { return std::move(p); }));
+
+        REQUIRE(ARo::Test::equals(v, std::map<std::size_t, int>{{2, 20}, {4, 40}, {9, 90}}));
+
+        const std::vector<std::pair<std::size_t, int>> duplicate{{1, 10}, {4, 41}};
+        REQUIRE_THROWS(v.insert_range(duplicate | std::views::transform([](const auto& p) {
+            return std::pair{p.first, ARo::Test::NonDefaultConstructibleMoveOnlyType{p.second}};
+        })));
+        REQUIRE(ARo::Test::equals(v, std::map<std::size_t, int>{{1, 10}, {2, 20}, {4, 40}, {9, 90}}));
+    }
+
+    SECTION("insert_range rejects an out of range index before growing")
+    {
+        ARo::bookkeeping_memory_resource memResource(&bufferResource);
+        std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+        ARo::sparse_vector<int, std::uint32_t> small(testAllocator);
+        const std::vector<std::pair<std::uint32_t, int>> outOfRange{{1, 10}, {0xFFFF'FFFFU, 20}};
+        REQUIRE_THROWS_WITH(small.insert_range(outOfRange), Catch::Contains("index out of range"));
+        REQUIRE(small.empty());
+        REQUIRE(small.memory_usage().indexCapacityBytes == 0);
+
+        ARo::sparse_vector<int> wide(testAllocator);
+        const std::vector<std::pair<std::size_t, int>> wraps{{3, 30}, {~std::size_t{0}, 40}};
+        REQUIRE_THROWS_WITH(wide.insert_range(wraps), Catch::Contains("index out of range"));
+        REQUIRE(wide.empty());
+
+        const std::vector<std::pair<std::uint64_t, int>> truncates{{5, 50}, {(std::uint64_t{1} << 32) + 5, 60}};
+        REQUIRE_THROWS_WITH(small.insert_range(truncates), Catch::Contains("index out of range"));
+        REQUIRE(small.empty());
+
+        const std::vector<std::pair<int, int>> negative{{-1, 10}};
+        REQUIRE_THROWS_WITH(small.insert_range(negative), Catch::Contains("index out of range"));
+        REQUIRE(small.empty());
+        REQUIRE(memResource.has_no_leak());
+    }
+
+    SECTION("erase_if")
+    {
+        ARo::bookkeeping_memory_resource memResource(&bufferResource);
+        std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+        auto v = ARo::Test::makeVec<ARo::Test::NonDefaultConstructibleMoveOnlyType, int>(testAllocator, {
+            {0, 4},
+            {8, 43},
+            {4, 32},
+            {25, 2},
+            {32, 1},
+        });
+
+        REQUIRE(v.erase_if([](const auto& val) { return val.value > 40; }) == 1U);
+        REQUIRE(ARo::Test::equals(v, std::map<std::size_t, int>{{0, 4}, {4, 32}, {25, 2}, {32, 1}}));
+
+        REQUIRE(v.erase_if([](const auto& val) { return val.value % 2 == 0; }) == 3U);
+        REQUIRE(ARo::Test::equals(v, std::map<std::size_t, int>{{32, 1}}));
+
+        REQUIRE(v.erase_if([](const auto&) { return false; }) == 0U);
+        v.emplace(4, 5);
+        REQUIRE(ARo::Test::equals(v, std::map<std::size_t, int>{{4, 5}, {32, 1}}));
+
+        int calls = 0;
+        REQUIRE_THROWS(v.erase_if([&calls](const auto&) {
+            if (++calls == 2)
+                throw std::runtime_error("predicate failure");
+            return true;
+        }));
+        REQUIRE(v.size() == 1U);
+
+        REQUIRE(v.erase_if([](const auto&) { return true; }) == 1U);
+        REQUIRE(v.empty());
+    }
 }
 
 TEST_CASE("sparse_vector Assignment", "[normal]")
@@ -625,6 +888,158 @@ TEST_CASE("sparse_vector Comparison", "[normal]")
         REQUIRE_FALSE(v4 > v1);
         REQUIRE_FALSE(v4 >= v1);
     }
+
+    SECTION("Widely spread indices")
+    {
+        // Far more index range than elements, so that the elements are sorted rather than the index walked
+        using SpreadVector = ARo::sparse_vector<int, std::uint16_t>;
+        const SpreadVector v1(std::vector<std::pair<std::uint16_t, int>>{{390, 390}, {5, 5}, {300, 300}}, &memResource);
+        const SpreadVector v2(std::vector<std::pair<std::uint16_t, int>>{{5, 5}, {300, 300}, {380, 0}}, &memResource);
+
+        // Same contents, inserted in a different order
+        SpreadVector v3(&memResource);
+        v3.insert(300, 300);
+        v3.insert(390, 390);
+        v3.insert(5, 5);
+        REQUIRE(v1 == v3);
+        REQUIRE((v1 <=> v3) == std::strong_ordering::equal);
+
+        REQUIRE(v1 != v2);
+        REQUIRE(v1 > v2);
+        REQUIRE(v2 < v1);
+
+        v3.erase(390);
+        v3.insert(391, 0);
+        REQUIRE(v3 > v1);
+        v3.erase(391);
+        REQUIRE(v3 < v1);
+    }
+
+    SECTION("Prefixes with different extents")
+    {
+        // A prefix is smaller, whether the index is walked or the elements are sorted, and whatever indices were used before
+        using PrefixVector = ARo::sparse_vector<int, std::uint16_t>;
+        PrefixVector a(&memResource);
+        a.insert(0, 0);
+        a.insert(3, 3);
+        PrefixVector b(&memResource);
+        b.insert(0, 0);
+        b.insert(10, 10);
+        b.erase(10);
+
+        REQUIRE((a <=> b) == std::strong_ordering::greater);
+        REQUIRE((b <=> a) == std::strong_ordering::less);
+        b.shrink_to_fit();
+        REQUIRE((a <=> b) == std::strong_ordering::greater);
+        REQUIRE((b <=> a) == std::strong_ordering::less);
+
+        PrefixVector c(&memResource);
+        c.insert(0, 0);
+        c.insert(1000, 1000);
+        PrefixVector d(&memResource);
+        d.insert(0, 0);
+        d.insert(2000, 2000);
+        d.erase(2000);
+
+        REQUIRE((c <=> d) == std::strong_ordering::greater);
+        REQUIRE((d <=> c) == std::strong_ordering::less);
+        d.shrink_to_fit();
+        REQUIRE((c <=> d) == std::strong_ordering::greater);
+        REQUIRE((d <=> c) == std::strong_ordering::less);
+
+        // An element at an index where the other has none, but the other has elements left
+        d.insert(5, 5);
+        REQUIRE(c > d);
+        a.erase(3);
+        a.insert(2, 2);
+        b.insert(1, 1);
+        REQUIRE(a > b);
+    }
+
+    SECTION("Ordering of the (index, value) pairs")
+    {
+        // The elements are compared like the sequences of their (index, value) pairs in ascending index order. Earlier versions walked the index up to the
+        // smaller extent, so an element past the last element of the other side made a sparse_vector smaller if the extent of the other side reached it
+        // (for instance because of an erased element), and larger otherwise
+        using PairVector = ARo::sparse_vector<int, std::uint16_t>;
+        PairVector prefix(&memResource);
+        prefix.insert(0, 7);
+        PairVector longer(&memResource);
+        longer.insert(0, 7);
+        longer.insert(3, 1);
+        PairVector earlier(&memResource);
+        earlier.insert(0, 7);
+        earlier.insert(2, 9);
+
+        REQUIRE(prefix < longer);
+        REQUIRE(earlier < longer);  // (2, 9) comes before (3, 1)
+        REQUIRE(prefix < earlier);
+
+        // Used to compare the other way around, since index 3 was walked and found only in longer
+        prefix.insert(10, 10);
+        prefix.erase(10);
+        REQUIRE(prefix < longer);
+        REQUIRE(longer > prefix);
+    }
+
+    SECTION("Cached content hash")
+    {
+        using cached_vector = ARo::sparse_vector<int, std::size_t, true, 0, 0, false, true>;
+        static_assert(sizeof(ARo::sparse_vector<int>) < sizeof(cached_vector));
+
+        cached_vector v1(&memResource);
+        cached_vector v2(&memResource);
+        for (const auto& [index, value] : std::initializer_list<std::pair<std::size_t, int>>{{0, 1}, {5, 14}, {8, 99}})
+            v1.insert(index, value);
+        for (const auto& [index, value] : std::initializer_list<std::pair<std::size_t, int>>{{8, 99}, {0, 1}, {5, 14}})
+            v2.insert(index, value);
+
+        REQUIRE(v1.content_hash() == v2.content_hash());
+        REQUIRE(v1.equal_with_hash(v2));
+
+        v1[5] = 15;
+        REQUIRE(std::as_const(v1).content_hash() != v2.content_hash());
+        REQUIRE_FALSE(v1.equal_with_hash(v2));
+        REQUIRE(v1 != v2);
+
+        v1.erase(5);
+        v1.insert(5, 14);
+        REQUIRE(v1.equal_with_hash(v2));
+        REQUIRE(std::as_const(v1).content_hash() == v2.content_hash());
+
+        auto moved = std::move(v1);
+        REQUIRE(moved.equal_with_hash(v2));
+        REQUIRE(v1.equal_with_hash(cached_vector{})); // NOLINT: Testing the moved from state
+    }
+
+    SECTION("Writes through references taken before hashing")
+    {
+        ARo::sparse_vector<int, std::size_t, true, 0, 0, false, true> v1(&memResource);
+        ARo::sparse_vector<int, std::size_t, true, 0, 0, false, true> v2(&memResource);
+        for (std::size_t i = 0; i < 3; ++i) {
+            v1.insert(i, static_cast<int>(i));
+            v2.insert(i, static_cast<int>(i));
+        }
+
+        auto& element = v1[1];
+        REQUIRE(v1.content_hash() == v2.content_hash());
+        element = 20;
+        v2[1] = 20;
+        REQUIRE(v2.content_hash() != std::as_const(v1).content_hash());
+
+        // The cached hash of v1 is stale, which operator== never looks at
+        REQUIRE(v1 == v2);
+        REQUIRE_FALSE(v1.equal_with_hash(v2));
+
+        // Taking mutable access again discards the cached hash, so the write is seen
+        (void)v1[1];
+        REQUIRE(v1.equal_with_hash(v2));
+
+        const auto values = v1.chunks(3)[0];
+        values[0] = 2;
+        REQUIRE(v1 != v2);
+        REQUIRE_FALSE(v1.equal_with_hash(v2));
+    }
 }
 
 TEST_CASE("sparse_vector Element Access", "[normal]")
@@ -673,6 +1088,64 @@ TEST_CASE("sparse_vector Element Access", "[normal]")
     }
 }
 
+TEST_CASE("sparse_vector Non-throwing lookup", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+    std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+    SECTION("Checked")
+    {
+        ARo::sparse_vector<int, std::uint16_t> v(testAllocator);
+        v.insert(3, 30);
+        v.insert(7, 70);
+
+        STATIC_REQUIRE(noexcept(v.contains(3)));
+        STATIC_REQUIRE(noexcept(v.find(3)));
+        STATIC_REQUIRE(noexcept(v.get_if(3)));
+
+        REQUIRE(v.contains(3));
+        REQUIRE_FALSE(v.contains(4));
+        REQUIRE_FALSE(v.contains(60000));
+
+        REQUIRE(*v.find(7) == 70);
+        REQUIRE(v.find(4) == v.end());
+        REQUIRE(std::as_const(v).find(60000) == v.cend());
+
+        *v.get_if(3) += 1;
+        REQUIRE(v[3] == 31);
+        REQUIRE(v.get_if(4) == nullptr);
+        REQUIRE(std::as_const(v).get_if(60000) == nullptr);
+    }
+
+    SECTION("Unchecked")
+    {
+        ARo::sparse_vector<int, std::uint16_t, false, 256> v(testAllocator);
+        v.insert(3, 30);
+
+        REQUIRE(v.contains(3));
+        REQUIRE_FALSE(v.contains(4));
+        REQUIRE_FALSE(v.contains(60000));
+        REQUIRE(v.find(60000) == v.end());
+        REQUIRE(v.get_if(60000) == nullptr);
+        REQUIRE(*v.get_if(3) == 30);
+    }
+
+    SECTION("Mutable lookup records a change")
+    {
+        ARo::sparse_vector<int, std::uint16_t, true, 0, 0, true> v(testAllocator);
+        v.insert(3, 30);
+        v.insert(4, 40);
+        const auto epoch = v.next_epoch();
+        REQUIRE(std::ranges::distance(v.changed_since(epoch)) == 0);
+
+        *v.get_if(3) = 31;
+        *v.find(4) = 41;
+        REQUIRE(std::ranges::distance(v.changed_since(epoch)) == 2);
+    }
+}
+
 TEST_CASE("sparse_vector Iteration", "[normal]")
 {
     std::array<std::byte, 10*1024> buf{};
@@ -735,3 +1208,950 @@ TEST_CASE("sparse_vector Iteration", "[normal]")
         }
     }
 }
+
+TEST_CASE("sparse_vector Paged index", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+    std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+    using PagedVector = ARo::sparse_vector<int, std::uint32_t, true, 4096>;
+
+    SECTION("Pages are only allocated where elements are")
+    {
+        PagedVector v(testAllocator);
+        v.insert(50'000'000, 1);
+        v.insert(50'000'001, 2);
+        v.insert(3, 3);
+
+        REQUIRE(v.size() == 3U);
+        REQUIRE(v[50'000'000] == 1);
+        REQUIRE(v[50'000'001] == 2);
+        REQUIRE(v[3] == 3);
+        REQUIRE_THROWS(v[4]);
+        REQUIRE_THROWS(v[50'004'096]);
+        REQUIRE_THROWS(v[60'000'000]);
+        REQUIRE_THROWS(v.insert(3, 4));
+        REQUIRE(memResource.get_num_live_allocated_bytes() < 256 * 1024);
+    }
+
+    SECTION("Pages are freed when they become empty")
+    {
+        PagedVector v(testAllocator);
+        v.insert(1000, 1);
+        const auto allocationsWithOnePage = memResource.get_num_live_allocations();
+
+        v.insert(1001, 2);
+        v.insert(9000, 3);
+        REQUIRE(memResource.get_num_live_allocations() == allocationsWithOnePage + 1);
+
+        v.erase(9000);
+        REQUIRE(memResource.get_num_live_allocations() == allocationsWithOnePage);
+
+        v.erase(1000);
+        REQUIRE(memResource.get_num_live_allocations() == allocationsWithOnePage);
+        REQUIRE(v[1001] == 2);
+
+        v.erase(1001);
+        REQUIRE(memResource.get_num_live_allocations() == allocationsWithOnePage - 1);
+        REQUIRE(v.empty());
+        REQUIRE_THROWS(v[1001]);
+    }
+
+    SECTION("A failed growth of the page table leaves the index unchanged")
+    {
+        // Growing the page table from one to two pages allocates the page counts and then the page table, two allocations of two words each
+        ARo::Test::FailOnSizeResource failing(&memResource, 2 * sizeof(std::size_t));
+        ARo::sparse_vector<int, std::uint32_t, true, 16> v(&failing);
+        v.reserve_data(4);
+        v.insert(3, 3);
+
+        failing.armed = true;
+        failing.numToSkip = 1;
+        REQUIRE_THROWS_AS(v.insert(20, 20), std::bad_alloc);
+        REQUIRE(v.size() == 1U);
+        REQUIRE_FALSE(v.contains(20));
+        REQUIRE(std::ranges::distance(v.ordered_items()) == 1);
+
+        failing.armed = false;
+        v.insert(20, 20);
+        v.insert(40, 40);
+        std::vector<std::uint32_t> indices;
+        for (auto [index, value] : v.ordered_items())
+            indices.push_back(index);
+        REQUIRE(indices == std::vector<std::uint32_t>{3, 20, 40});
+    }
+
+    SECTION("Copy, move and comparison")
+    {
+        PagedVector v(testAllocator);
+        v.insert(5, 50);
+        v.insert(700, 7000);
+
+        const PagedVector copy{v, testAllocator};
+        REQUIRE(copy == v);
+        REQUIRE(copy[700] == 7000);
+
+        PagedVector moved{std::move(v)};
+        REQUIRE(moved == copy);
+        REQUIRE(moved.get_allocator() == testAllocator);
+
+        PagedVector assigned(testAllocator);
+        assigned.insert(1, 1);
+        REQUIRE(assigned < copy);
+        assigned = copy;
+        REQUIRE(assigned == copy);
+        assigned.erase(5);
+        REQUIRE(assigned != copy);
+        REQUIRE(copy[5] == 50);
+    }
+
+    REQUIRE(memResource.has_no_leak());
+}
+
+TEST_CASE("sparse_vector Bitmap index", "[normal]")
+{
+    ARo::bookkeeping_memory_resource memResource;
+    std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+    using BitmapVector = ARo::sparse_vector<int, std::uint32_t, true, ARo::BitmapIndex>;
+
+    SECTION("Memory follows the number of elements, not the range of indices")
+    {
+        BitmapVector v(testAllocator);
+        v.insert(4'000'000'000U, 1);
+        v.insert(4'000'000'001U, 2);
+        v.insert(3, 3);
+        v.insert(2'000'000'000U, 4);
+
+        REQUIRE(v.size() == 4U);
+        REQUIRE(v[4'000'000'000U] == 1);
+        REQUIRE(v[4'000'000'001U] == 2);
+        REQUIRE(v[3] == 3);
+        REQUIRE(v[2'000'000'000U] == 4);
+        REQUIRE_THROWS(v[4]);
+        REQUIRE_THROWS(v[4'000'000'002U]);
+        REQUIRE_THROWS(v.insert(3, 4));
+        REQUIRE(memResource.get_num_live_allocated_bytes() < 1024);
+
+        std::vector<std::uint32_t> ordered;
+        for (auto [index, value] : v.ordered_items())
+            ordered.push_back(index);
+        REQUIRE(ordered == std::vector<std::uint32_t>{3, 2'000'000'000U, 4'000'000'000U, 4'000'000'001U});
+
+        v.erase(4'000'000'001U);
+        v.erase(4'000'000'000U);
+        REQUIRE_THROWS(v[4'000'000'000U]);
+        REQUIRE(v[2'000'000'000U] == 4);
+    }
+
+    SECTION("Dense blocks are converted to bitmaps and back")
+    {
+        BitmapVector v(testAllocator);
+        std::map<std::uint32_t, int> expected;
+        for (std::uint32_t i = 0; i < 10'000; ++i) {
+            const auto index = 70'000 + i * 5;
+            v.insert(index, static_cast<int>(i));
+            expected[index] = static_cast<int>(i);
+        }
+        v.insert(1, -1);
+        expected[1] = -1;
+
+        for (auto [index, value] : expected)
+            REQUIRE(v[index] == value);
+        REQUIRE_THROWS(v[70'001]);
+
+        std::map<std::uint32_t, int> ordered;
+        std::uint32_t previous = 0;
+        for (auto [index, value] : v.ordered_items()) {
+            REQUIRE((ordered.empty() || index > previous));
+            previous = index;
+            ordered[index] = value;
+        }
+        REQUIRE(ordered == expected);
+
+        // Erasing moves elements, which updates the positions of their indices
+        REQUIRE(v.erase_if([](int value) { return value >= 0 && value % 3 != 0; }) == 6666U);
+        std::erase_if(expected, [](const auto& item) { return item.second >= 0 && item.second % 3 != 0; });
+        for (std::uint32_t i = 0; i < 10'000; i += 2) {
+            const auto index = 70'000 + i * 5;
+            if (expected.erase(index) != 0)
+                v.erase(index);
+        }
+
+        REQUIRE(v.size() == expected.size());
+        for (auto [index, value] : expected)
+            REQUIRE(v[index] == value);
+        REQUIRE(std::map<std::uint32_t, int>(v.ordered_items().begin(), v.ordered_items().end()) == expected);
+    }
+
+    SECTION("Copy, move and snapshots")
+    {
+        BitmapVector v(testAllocator);
+        for (std::uint32_t i = 0; i < 5000; ++i)
+            v.insert(i * 3, static_cast<int>(i));
+
+        const BitmapVector copy{v, testAllocator};
+        REQUIRE(copy == v);
+
+        BitmapVector moved{std::move(v)};
+        REQUIRE(moved == copy);
+        REQUIRE(v.empty());
+
+        std::ostringstream out(std::ios::binary);
+        moved.write_snapshot(out);
+        const auto bytes = out.str();
+        std::vector<std::uint64_t> storage((bytes.size() + 7) / 8);
+        std::memcpy(storage.data(), bytes.data(), bytes.size());
+        const auto loaded = BitmapVector::from_snapshot({reinterpret_cast<const std::byte*>(storage.data()), bytes.size()}, testAllocator);
+        REQUIRE(loaded == copy);
+        REQUIRE(loaded[4998 * 3] == 4998);
+    }
+
+    SECTION("A failed insertion leaves no empty container behind")
+    {
+        // The first position of a new container is the only allocation of sizeof(std::uint32_t) bytes once the data is reserved
+        ARo::Test::FailOnSizeResource failing(&memResource, sizeof(std::uint32_t));
+        BitmapVector v(&failing);
+        v.reserve_data(4);
+        v.insert(5, 5);
+
+        failing.armed = true;
+        REQUIRE_THROWS_AS(v.insert(100'000, 1), std::bad_alloc);
+        REQUIRE(v.size() == 1U);
+        REQUIRE_FALSE(v.contains(100'000));
+        REQUIRE(std::ranges::distance(v.ordered_items()) == 1);
+
+        v.erase(5);
+        REQUIRE(v.empty());
+        REQUIRE(v.memory_usage().indexBytes == 0);
+        REQUIRE(v.ordered_items().empty());
+
+        failing.armed = false;
+        v.insert(100'000, 1);
+        REQUIRE(v[100'000] == 1);
+    }
+
+    REQUIRE(memResource.has_no_leak());
+}
+
+TEST_CASE("sparse_vector Memory usage", "[normal]")
+{
+    ARo::bookkeeping_memory_resource memResource;
+    std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+    SECTION("Flat index")
+    {
+        ARo::sparse_vector<std::uint64_t, std::uint32_t> v(testAllocator);
+        for (std::uint32_t i = 0; i < 1000; ++i)
+            v.insert(i, i);
+        REQUIRE(v.memory_usage().total_bytes() == memResource.get_num_live_allocated_bytes());
+        REQUIRE(v.memory_usage().dataBytes == 1000 * (sizeof(std::uint64_t) + sizeof(std::uint32_t)));
+
+        v.erase_if([](std::uint64_t value) { return value >= 10; });
+        const auto before = v.memory_usage();
+        REQUIRE(before.indexBytes == 1000 * sizeof(std::uint32_t));
+
+        v.shrink_to_fit();
+        const auto after = v.memory_usage();
+        REQUIRE(after.indexBytes == 10 * sizeof(std::uint32_t));
+        REQUIRE(after.indexCapacityBytes == after.indexBytes);
+        REQUIRE(after.dataCapacityBytes == after.dataBytes);
+        REQUIRE(after.total_bytes() == memResource.get_num_live_allocated_bytes());
+        REQUIRE(after.total_bytes() < before.total_bytes());
+        REQUIRE(v[9] == 9U);
+        REQUIRE_THROWS(v[10]);
+        v.insert(500, 500);
+        REQUIRE(v[500] == 500U);
+    }
+
+    SECTION("Paged index and change tracking")
+    {
+        ARo::sparse_vector<int, std::uint32_t, true, 1024, 0, true> v(testAllocator);
+        v.insert(1, 1);
+        v.insert(1'000'000, 2);
+        REQUIRE(v.memory_usage().trackingBytes > 0);
+        REQUIRE(v.memory_usage().total_bytes() == memResource.get_num_live_allocated_bytes());
+
+        v.erase(1'000'000);
+        const auto before = v.memory_usage();
+        v.shrink_to_fit();
+        const auto after = v.memory_usage();
+        REQUIRE(after.indexCapacityBytes < before.indexCapacityBytes);
+        REQUIRE(after.indexCapacityBytes < 2 * 1024 * sizeof(std::uint32_t));
+        REQUIRE(after.total_bytes() == memResource.get_num_live_allocated_bytes());
+        REQUIRE(v[1] == 1);
+    }
+
+    SECTION("Entries holding a generation are kept")
+    {
+        ARo::sparse_vector<int, std::uint32_t, true, 0, 8> v(testAllocator);
+        v.insert(1, 1);
+        v.insert(5, 5);
+        const auto h = v.handle_of(5);
+        v.erase(5);
+        v.shrink_to_fit();
+        REQUIRE(v.memory_usage().indexBytes == 6 * sizeof(std::uint32_t));
+        v.insert(5, 6);
+        REQUIRE_FALSE(v.contains(h));
+    }
+
+    SECTION("Compacting a bitmap index")
+    {
+        ARo::sparse_vector<int, std::uint32_t, true, ARo::BitmapIndex> v(testAllocator);
+        for (std::uint32_t i = 0; i < 5000; ++i)
+            v.insert(i * 2, static_cast<int>(i));
+        v.erase_if([](int value) { return value % 2 != 0; });
+        REQUIRE(v.memory_usage().total_bytes() == memResource.get_num_live_allocated_bytes());
+
+        v.shrink_to_fit();
+        const auto shrunk = v.memory_usage();
+        v.compact();
+        const auto compacted = v.memory_usage();
+        REQUIRE(compacted.indexCapacityBytes < shrunk.indexCapacityBytes);
+        REQUIRE(compacted.total_bytes() == memResource.get_num_live_allocated_bytes());
+        for (std::uint32_t i = 0; i < 5000; i += 2)
+            REQUIRE(v[i * 2] == static_cast<int>(i));
+        REQUIRE_THROWS(v[2]);
+    }
+
+    REQUIRE(memResource.has_no_leak());
+}
+
+TEST_CASE("sparse_vector Index-aware iteration", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+
+    SECTION("Empty vector")
+    {
+        auto v = ARo::Test::makeVec<int>(&memResource, {});
+        REQUIRE(v.items().empty());
+        REQUIRE(std::as_const(v).items().empty());
+
+        int calls = 0;
+        v.each([&calls](std::size_t, int&) { ++calls; });
+        REQUIRE(calls == 0);
+    }
+
+    SECTION("Vector with multiple elements")
+    {
+        auto v = ARo::Test::makeVec<int>(&memResource, {
+            {3, 5},
+            {5, 6},
+            {53, 4},
+            {44, 43},
+        });
+        v.erase(5);
+
+        static_assert(std::ranges::random_access_range<decltype(v.items())>);
+        REQUIRE(v.items().size() == 3);
+
+        std::map<std::size_t, int> seen;
+        for (auto [index, value] : v.items())
+            seen[index] = value;
+        REQUIRE(seen == std::map<std::size_t, int>{{3, 5}, {44, 43}, {53, 4}});
+
+        for (auto [index, value] : v.items())
+            value += static_cast<int>(index);
+        REQUIRE(ARo::Test::equals(v, std::map<std::size_t, int>{{3, 8}, {44, 87}, {53, 57}}));
+
+        auto it = v.items().begin();
+        for (auto dataIt = v.begin(); dataIt != v.end(); ++dataIt, ++it)
+            REQUIRE(&(*it).second == &*dataIt);
+
+        const auto& cv = v;
+        ARo::sparse_vector<int>::const_item_iterator cit = v.items().begin();
+        REQUIRE(cit == cv.items().begin());
+        REQUIRE((*(cit + 2)).second == cv.items()[2].second);
+
+        seen.clear();
+        cv.each([&seen](std::size_t index, const int& value) { seen[index] = value; });
+        REQUIRE(seen == std::map<std::size_t, int>{{3, 8}, {44, 87}, {53, 57}});
+
+        v.each([](std::size_t, int& value) { value = 0; });
+        REQUIRE(std::ranges::count(v, 0) == 3);
+    }
+}
+
+TEST_CASE("sparse_vector Sorting and ordered iteration", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+
+    std::map<std::size_t, int> expected;
+    auto v = ARo::Test::makeVec<ARo::Test::NonDefaultConstructibleMoveOnlyType, int>(&memResource, {});
+    for (std::size_t i = 0; i < 50; ++i) {
+        const auto index = (i * 37) % 101;
+        v.emplace(index, static_cast<int>(100 - index));
+        expected[index] = static_cast<int>(100 - index);
+    }
+    for (std::size_t i = 0; i < 50; i += 4) {
+        const auto index = (i * 37) % 101;
+        v.erase(index);
+        expected.erase(index);
+    }
+
+    SECTION("Ordered iteration without sorting")
+    {
+        std::vector<std::size_t> indices;
+        for (auto [index, value] : v.ordered_items()) {
+            REQUIRE(value == expected.at(index));
+            indices.push_back(index);
+        }
+        REQUIRE(std::ranges::equal(indices, expected | std::views::keys));
+
+        for (auto [index, value] : v.ordered_items())
+            value.value += 1;
+        for (auto [index, value] : std::as_const(v).ordered_items())
+            REQUIRE(value == expected.at(index) + 1);
+    }
+
+    SECTION("Sort by index")
+    {
+        v.sort();
+        REQUIRE(ARo::Test::equals(v, expected));
+        REQUIRE(std::ranges::equal(v.items() | std::views::keys, expected | std::views::keys));
+
+        // The order is kept by erase_if, and lookups still work after erase
+        v.erase_if([](const auto& val) { return val.value % 3 == 0; });
+        std::erase_if(expected, [](const auto& item) { return item.second % 3 == 0; });
+        REQUIRE(std::ranges::equal(v.items() | std::views::keys, expected | std::views::keys));
+        v.erase(expected.begin()->first);
+        expected.erase(expected.begin());
+        REQUIRE(ARo::Test::equals(v, expected));
+    }
+
+    SECTION("Sort by value")
+    {
+        v.sort([](const auto& lhs, const auto& rhs) { return lhs.value > rhs.value; });
+        REQUIRE(ARo::Test::equals(v, expected));
+        REQUIRE(std::ranges::is_sorted(v, std::ranges::greater{}, &ARo::Test::NonDefaultConstructibleMoveOnlyType::value));
+    }
+
+    SECTION("Paged index")
+    {
+        ARo::sparse_vector<int, std::uint32_t, true, 16> paged(&memResource);
+        for (std::uint32_t index : {1000U, 3U, 17U, 999U, 16U, 100'000U})
+            paged.insert(index, static_cast<int>(index));
+
+        std::vector<std::uint32_t> indices;
+        for (auto [index, value] : paged.ordered_items())
+            indices.push_back(index);
+        REQUIRE(indices == std::vector<std::uint32_t>{3, 16, 17, 999, 1000, 100'000});
+
+        paged.sort();
+        REQUIRE(std::ranges::equal(paged, indices | std::views::transform([](auto i) { return static_cast<int>(i); })));
+        REQUIRE(paged[17] == 17);
+    }
+
+    SECTION("Empty vector")
+    {
+        ARo::sparse_vector<int> empty(&memResource);
+        REQUIRE(empty.ordered_items().empty());
+        empty.sort();
+        REQUIRE(empty.empty());
+    }
+}
+
+TEST_CASE("sparse_vector Parallel and chunked iteration", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+
+    ARo::sparse_vector<int> v(&memResource);
+    for (std::size_t i = 0; i < 100; ++i)
+        v.insert(i * 2, static_cast<int>(i));
+    v.erase(10);
+
+    SECTION("for_each and each with execution policies")
+    {
+        ARo::for_each(std::execution::par, v, [](int& value) { value *= 2; });
+        ARo::each(std::execution::par_unseq, v, [](std::size_t index, int& value) { value += static_cast<int>(index); });
+        for (auto [index, value] : v.items())
+            REQUIRE(value == static_cast<int>(index * 2));
+
+        int sum = 0;
+        ARo::for_each(std::execution::seq, std::as_const(v), [&sum](const int& value) { sum += value; });
+        REQUIRE(sum == std::accumulate(v.begin(), v.end(), 0));
+
+        std::size_t indexSum = 0;
+        ARo::each(std::execution::seq, std::as_const(v), [&indexSum](std::size_t index, const int&) { indexSum += index; });
+        REQUIRE(indexSum == 99 * 100 - 10);
+    }
+
+    SECTION("Chunks")
+    {
+        REQUIRE_THROWS_AS(v.chunks(0), std::invalid_argument);
+
+        auto chunks = v.chunks(16);
+        static_assert(std::ranges::random_access_range<decltype(chunks)>);
+        static_assert(std::is_same_v<std::ranges::range_value_t<decltype(chunks)>, std::span<int>>);
+        REQUIRE(chunks.size() == 7U);
+        REQUIRE(chunks[6].size() == 3U);
+        REQUIRE(chunks[0].data() == &*v.begin());
+
+        std::size_t count = 0;
+        for (auto chunk : chunks) {
+            for (auto& value : chunk)
+                value = -value;
+            count += chunk.size();
+        }
+        REQUIRE(count == v.size());
+        REQUIRE(v[12] == -6);
+
+        REQUIRE(std::as_const(v).chunks(99).size() == 1U);
+        REQUIRE(std::as_const(v).chunks(1).size() == 99U);
+        REQUIRE(ARo::sparse_vector<int>{}.chunks(8).empty());
+    }
+
+    SECTION("Item chunks")
+    {
+        std::map<std::size_t, int> seen;
+        for (auto chunk : v.item_chunks(10)) {
+            REQUIRE(std::ranges::size(chunk) <= 10U);
+            for (auto [index, value] : chunk)
+                seen[index] = value;
+        }
+        REQUIRE(ARo::Test::equals(v, seen));
+
+        const auto& cv = v;
+        REQUIRE(cv.item_chunks(50).size() == 2U);
+        auto [index, value] = *cv.item_chunks(50)[1].begin();
+        REQUIRE(cv[index] == value);
+    }
+}
+
+TEST_CASE("sparse_vector Generational handles", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+    std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+    SECTION("Handles are invalidated when their element is erased")
+    {
+        ARo::sparse_vector<int, std::uint32_t, true, 0, 8> v(testAllocator);
+        v.insert(3, 30);
+        v.insert(5, 50);
+        v.insert(7, 70);
+
+        const auto h3 = v.handle_of(3);
+        const auto h7 = v.handle_of(7);
+        REQUIRE(h3.index == 3U);
+        REQUIRE_THROWS(v.handle_of(4));
+        REQUIRE(v.contains(h3));
+        REQUIRE(v[h3] == 30);
+
+        // Erasing moves the last element, which must not affect its handle
+        v.erase(3);
+        REQUIRE(!v.contains(h3));
+        REQUIRE_THROWS(v[h3]);
+        REQUIRE(v.contains(h7));
+        REQUIRE(v[h7] == 70);
+        v[h7] = 71;
+        REQUIRE(v[7] == 71);
+
+        // Reusing the index gives a new generation
+        v.insert(3, 33);
+        REQUIRE(!v.contains(h3));
+        const auto newH3 = v.handle_of(3);
+        REQUIRE(newH3 != h3);
+        REQUIRE(v[newH3] == 33);
+
+        // Generations survive sorting and erase_if
+        v.sort();
+        REQUIRE(v[newH3] == 33);
+        v.erase_if([](int value) { return value == 50; });
+        REQUIRE(v[newH3] == 33);
+        REQUIRE(std::as_const(v)[h7] == 71);
+        REQUIRE(!v.contains(ARo::sparse_vector<int, std::uint32_t, true, 0, 8>::handle{1000, 0}));
+    }
+
+    SECTION("Generations wrap around")
+    {
+        ARo::sparse_vector<int, std::uint16_t, true, 0, 2> v(testAllocator);
+        v.insert(1, 1);
+        const auto first = v.handle_of(1);
+        for (int i = 0; i < 4; ++i) {
+            v.erase(1);
+            v.insert(1, i);
+        }
+        REQUIRE(v.handle_of(1) == first);
+        REQUIRE(v[first] == 3);
+    }
+
+    SECTION("Element count is limited by the remaining bits")
+    {
+        ARo::sparse_vector<int, std::uint8_t, true, 0, 5> v(testAllocator);
+        for (std::uint8_t i = 0; i < 7; ++i)
+            v.insert(i, i);
+        REQUIRE_THROWS(v.insert(7, 7));
+        REQUIRE(v.size() == 7U);
+        REQUIRE(v[v.handle_of(6)] == 6);
+    }
+
+    SECTION("Paged index keeps generations of empty pages")
+    {
+        ARo::sparse_vector<int, std::uint32_t, true, 64, 4> v(testAllocator);
+        v.insert(1000, 1);
+        const auto handle = v.handle_of(1000);
+        const auto allocations = memResource.get_num_live_allocations();
+        v.erase(1000);
+        REQUIRE(memResource.get_num_live_allocations() == allocations);
+        REQUIRE(!v.contains(handle));
+        v.insert(1000, 2);
+        REQUIRE(!v.contains(handle));
+        REQUIRE(v[v.handle_of(1000)] == 2);
+
+        const decltype(v) copy{v, testAllocator};
+        REQUIRE(copy.handle_of(1000) == v.handle_of(1000));
+        REQUIRE(copy == v);
+    }
+
+    REQUIRE(memResource.has_no_leak());
+}
+
+TEST_CASE("sparse_vector Batched lookup", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+    std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+    ARo::sparse_vector<int, std::uint32_t> v(testAllocator);
+    for (std::uint32_t i = 0; i < 300; i += 3)
+        v.insert(i, static_cast<int>(i) * 10);
+
+    // More than one block, with hits, misses and indices beyond the extent
+    std::vector<std::uint32_t> indices;
+    for (std::uint32_t i = 0; i < 150; ++i)
+        indices.push_back(i * 2);
+    indices.push_back(1'000'000);
+
+    SECTION("find_many")
+    {
+        std::vector<const int*> found(indices.size());
+        REQUIRE(std::as_const(v).find_many(indices, found) == 50U);
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            if (indices[i] % 3 == 0 && indices[i] < 300)
+                REQUIRE(found[i] == &std::as_const(v)[indices[i]]);
+            else
+                REQUIRE(found[i] == nullptr);
+        }
+
+        std::vector<int*> mutableFound(indices.size());
+        REQUIRE(v.find_many(indices, mutableFound) == 50U);
+        *mutableFound[3] = -1;
+        REQUIRE(v[6] == -1);
+
+        REQUIRE(v.find_many({}, std::span<int*>{}) == 0U);
+        REQUIRE_THROWS_AS(v.find_many(indices, std::span(mutableFound).first(10)), std::invalid_argument);
+    }
+
+    SECTION("gather")
+    {
+        REQUIRE(decltype(v)::miss_mask_size(0) == 0U);
+        REQUIRE(decltype(v)::miss_mask_size(64) == 1U);
+        REQUIRE(decltype(v)::miss_mask_size(151) == 3U);
+
+        std::vector<int> out(indices.size(), 7);
+        std::vector<std::uint64_t> misses(decltype(v)::miss_mask_size(indices.size()));
+        REQUIRE(v.gather(indices, out, misses) == 50U);
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            const bool missed = ((misses[i / 64] >> (i % 64)) & 1U) != 0;
+            if (indices[i] % 3 == 0 && indices[i] < 300) {
+                REQUIRE(!missed);
+                REQUIRE(out[i] == static_cast<int>(indices[i]) * 10);
+            } else {
+                REQUIRE(missed);
+                REQUIRE(out[i] == 7);
+            }
+        }
+
+        REQUIRE_THROWS_AS(v.gather(indices, out, std::span(misses).first(2)), std::invalid_argument);
+        REQUIRE_THROWS_AS(v.gather(indices, std::span(out).first(3), misses), std::invalid_argument);
+    }
+
+    SECTION("Paged index")
+    {
+        ARo::sparse_vector<int, std::uint32_t, false, 256> paged(testAllocator);
+        paged.insert(70'000, 1);
+        paged.insert(5, 2);
+
+        const std::array<std::uint32_t, 4> lookups{5, 70'000, 70'001, 4'000'000'000U};
+        std::array<int, 4> out{};
+        std::array<std::uint64_t, 1> misses{};
+        REQUIRE(paged.gather(lookups, out, misses) == 2U);
+        REQUIRE(misses[0] == 0b1100U);
+        REQUIRE(out[0] == 2);
+        REQUIRE(out[1] == 1);
+    }
+}
+
+TEST_CASE("sparse_vector Snapshots", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+    std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+    struct Point {
+        float x;
+        float y;
+        auto operator<=>(const Point&) const = default;
+    };
+
+    // Snapshots are read from storage aligned like a memory mapping would be
+    const auto toAligned = [](const std::string& bytes) {
+        std::vector<std::uint64_t> storage((bytes.size() + 7) / 8);
+        std::memcpy(storage.data(), bytes.data(), bytes.size());
+        return storage;
+    };
+
+    ARo::sparse_vector<Point, std::uint32_t, true, 64> v(testAllocator);
+    for (std::uint32_t i = 0; i < 50; ++i)
+        v.insert(i * 7, Point{static_cast<float>(i), -static_cast<float>(i)});
+    v.erase(14);
+
+    std::ostringstream out(std::ios::binary);
+    v.write_snapshot(out);
+    const auto bytes = out.str();
+    REQUIRE(bytes.size() == v.snapshot_size());
+    const auto storage = toAligned(bytes);
+    const std::span snapshot(reinterpret_cast<const std::byte*>(storage.data()), bytes.size());
+
+    SECTION("Loading into a sparse_vector")
+    {
+        // A flat index and unchecked access can read a snapshot from a paged, checked sparse_vector
+        const auto loaded = ARo::sparse_vector<Point, std::uint32_t, false>::from_snapshot(snapshot, testAllocator);
+        REQUIRE(loaded.size() == v.size());
+        REQUIRE(loaded.get_allocator() == testAllocator);
+        REQUIRE(std::ranges::equal(loaded.cbegin(), loaded.cend(), v.begin(), v.end()));
+        for (auto [index, value] : v.items())
+            REQUIRE(loaded[index] == value);
+
+        auto paged = decltype(v)::from_snapshot(snapshot, testAllocator);
+        REQUIRE(paged == v);
+        REQUIRE_THROWS(paged[14]);
+        paged.insert(14, Point{1, 2});
+        REQUIRE(paged.size() == v.size() + 1);
+    }
+
+    SECTION("Mismatches are detected")
+    {
+        REQUIRE_THROWS(ARo::sparse_vector<Point>::from_snapshot(snapshot));
+        REQUIRE_THROWS(ARo::sparse_vector<double, std::uint32_t>::from_snapshot(snapshot));
+        REQUIRE_THROWS(decltype(v)::from_snapshot(snapshot.first(snapshot.size() - 1)));
+        REQUIRE_THROWS(decltype(v)::from_snapshot(snapshot.first(20)));
+        REQUIRE_THROWS(decltype(v)::from_snapshot(snapshot.subspan(1)));
+
+        auto corrupt = storage;
+        reinterpret_cast<char*>(corrupt.data())[0] = 'X';
+        REQUIRE_THROWS(decltype(v)::from_snapshot(std::as_bytes(std::span(corrupt))));
+    }
+
+    SECTION("Corrupt lookups are detected")
+    {
+        // The dense lookup starts at byte 64, with a position per index
+        const auto withPosition = [&storage](std::size_t index, std::uint32_t pos) {
+            auto corrupt = storage;
+            std::memcpy(reinterpret_cast<std::byte*>(corrupt.data()) + 64 + index * sizeof(pos), &pos, sizeof(pos));
+            return corrupt;
+        };
+
+        // Past the elements, the position of another index, and an index that is not there
+        for (const auto& corrupt : {withPosition(0, 1000), withPosition(7, 0), withPosition(1, 0), withPosition(14, 3)})
+            REQUIRE_THROWS_AS(decltype(v)::from_snapshot(std::as_bytes(std::span(corrupt)).first(bytes.size())), std::runtime_error);
+    }
+
+    SECTION("Widely spread indices")
+    {
+        // Far too few elements for a dense lookup, so the size of the snapshot follows the number of elements
+        ARo::sparse_vector<Point, std::uint32_t, true, ARo::BitmapIndex> spread(testAllocator);
+        spread.insert(4'000'000'000U, Point{1, 2});
+        spread.insert(7, Point{3, 4});
+        spread.insert(4'294'967'294U, Point{5, 6});
+        spread.insert(100'000, Point{7, 8});
+
+        std::ostringstream spreadOut(std::ios::binary);
+        spread.write_snapshot(spreadOut);
+        const auto spreadBytes = spreadOut.str();
+        REQUIRE(spreadBytes.size() == spread.snapshot_size());
+        REQUIRE(spreadBytes.size() < 512);
+
+        const auto spreadStorage = toAligned(spreadBytes);
+        const auto loaded = decltype(spread)::from_snapshot({reinterpret_cast<const std::byte*>(spreadStorage.data()), spreadBytes.size()}, testAllocator);
+        REQUIRE(loaded == spread);
+        REQUIRE(std::ranges::equal(loaded.cbegin(), loaded.cend(), std::as_const(spread).begin(), std::as_const(spread).end()));
+        REQUIRE(loaded[4'294'967'294U] == Point{5, 6});
+        REQUIRE_THROWS(loaded[8]);
+
+        // The sorted lookup starts at byte 64, with the indices in ascending order followed by their positions
+        auto corrupt = spreadStorage;
+        const std::uint32_t pastElements = 4;
+        std::memcpy(reinterpret_cast<std::byte*>(corrupt.data()) + 64 + 4 * sizeof(std::uint32_t), &pastElements, sizeof(pastElements));
+        REQUIRE_THROWS_AS(decltype(spread)::from_snapshot(std::as_bytes(std::span(corrupt)).first(spreadBytes.size())), std::runtime_error);
+
+        corrupt = spreadStorage;
+        const std::uint32_t unordered = 200'000;
+        std::memcpy(reinterpret_cast<std::byte*>(corrupt.data()) + 64 + sizeof(std::uint32_t), &unordered, sizeof(unordered));
+        REQUIRE_THROWS_AS(decltype(spread)::from_snapshot(std::as_bytes(std::span(corrupt)).first(spreadBytes.size())), std::runtime_error);
+    }
+
+    SECTION("Empty sparse_vector")
+    {
+        const ARo::sparse_vector<int> empty;
+        std::ostringstream emptyOut(std::ios::binary);
+        empty.write_snapshot(emptyOut);
+        const auto emptyStorage = toAligned(emptyOut.str());
+        const auto loaded = ARo::sparse_vector<int>::from_snapshot(std::as_bytes(std::span(emptyStorage)));
+        REQUIRE(loaded.empty());
+    }
+}
+
+TEST_CASE("sparse_vector Change tracking", "[normal]")
+{
+    std::array<std::byte, 10*1024> buf{};
+    std::pmr::monotonic_buffer_resource bufferResource(buf.data(), buf.size());
+    ARo::bookkeeping_memory_resource memResource(&bufferResource);
+    std::pmr::polymorphic_allocator testAllocator(&memResource);
+
+    using TrackedVector = ARo::sparse_vector<int, std::uint32_t, true, 0, 0, true>;
+    static_assert(sizeof(ARo::sparse_vector<int, std::uint32_t>) < sizeof(TrackedVector), "Tracking must take no space when disabled");
+
+    const auto changed = [](const TrackedVector& v, TrackedVector::epoch_type epoch) {
+        std::map<std::uint32_t, int> result;
+        for (auto [index, value] : v.changed_since(epoch)) {
+            REQUIRE(!result.contains(index));
+            result[index] = value;
+        }
+        return result;
+    };
+    const auto erased = [](const TrackedVector& v, TrackedVector::epoch_type epoch) {
+        std::vector<std::uint32_t> result;
+        std::ranges::copy(v.erased_since(epoch), std::back_inserter(result));
+        return result;
+    };
+
+    TrackedVector v(testAllocator);
+    REQUIRE(v.epoch() == 1U);
+    REQUIRE(changed(v, 0).empty());
+
+    for (std::uint32_t i = 0; i < 10; ++i)
+        v.insert(i, static_cast<int>(i));
+    const auto first = v.next_epoch();
+    REQUIRE(first == 1U);
+    REQUIRE(v.epoch() == 2U);
+    REQUIRE(changed(v, 0).size() == 10U);
+    REQUIRE(changed(v, first).empty());
+
+    SECTION("Inserts, element access and erases")
+    {
+        v[3] = 30;
+        v[3] = 31;
+        REQUIRE(std::as_const(v)[4] == 4);
+        v.insert(20, 200);
+        v.erase(5);
+        v.erase(20);
+        v.insert(5, 50);
+
+        REQUIRE(changed(v, first) == std::map<std::uint32_t, int>{{3, 31}, {5, 50}});
+        REQUIRE(erased(v, first) == std::vector<std::uint32_t>{5, 20});
+
+        // Changes in later epochs replace earlier ones, and the erased element is not reported
+        const auto second = v.next_epoch();
+        v[9] = 90;
+        v[3] = 32;
+        v.erase(0);
+        REQUIRE(changed(v, second) == std::map<std::uint32_t, int>{{3, 32}, {9, 90}});
+        REQUIRE(changed(v, first) == std::map<std::uint32_t, int>{{3, 32}, {5, 50}, {9, 90}});
+        REQUIRE(erased(v, second) == std::vector<std::uint32_t>{0});
+        REQUIRE(changed(v, 0).size() == v.size());
+
+        v.discard_changes(second);
+        REQUIRE(changed(v, second) == std::map<std::uint32_t, int>{{3, 32}, {9, 90}});
+        REQUIRE(erased(v, second) == std::vector<std::uint32_t>{0});
+    }
+
+    SECTION("An index erased and inserted again in the same epoch is visited once")
+    {
+        v[4] = 40;
+        v.erase(4);
+        v.insert(4, 41);
+        v.insert(30, 300);
+        v.erase(30);
+        v.insert(30, 301);
+        v.erase(30);
+        v.insert(30, 302);
+        REQUIRE(std::ranges::distance(v.changed_since(first)) == 2);
+        REQUIRE(changed(v, first) == std::map<std::uint32_t, int>{{4, 41}, {30, 302}});
+
+        // Erased in the previous epoch and inserted again, which is logged in the new one
+        const auto second = v.next_epoch();
+        v.erase(4);
+        const auto third = v.next_epoch();
+        v.insert(4, 42);
+        REQUIRE(changed(v, third) == std::map<std::uint32_t, int>{{4, 42}});
+        REQUIRE(changed(v, second) == std::map<std::uint32_t, int>{{4, 42}});
+
+        REQUIRE(v.erase_if([](int value) { return value == 302; }) == 1U);
+        v.insert(30, 303);
+        REQUIRE(std::ranges::distance(v.changed_since(second)) == 2);
+    }
+
+    SECTION("Stamps follow the elements when they move")
+    {
+        v[2] = 20;
+        v[8] = 80;
+        v.erase(0);
+        REQUIRE(changed(v, first) == std::map<std::uint32_t, int>{{2, 20}, {8, 80}});
+
+        v.sort([](int lhs, int rhs) { return lhs > rhs; });
+        REQUIRE(changed(v, first) == std::map<std::uint32_t, int>{{2, 20}, {8, 80}});
+
+        REQUIRE(v.erase_if([](int value) { return value == 20 || value == 7; }) == 2U);
+        REQUIRE(changed(v, first) == std::map<std::uint32_t, int>{{8, 80}});
+        REQUIRE(erased(v, first) == std::vector<std::uint32_t>{0, 2, 7}); // In storage order, which is by descending value
+
+        std::vector<std::uint32_t> indices{8, 1, 100};
+        std::vector<int*> found(indices.size());
+        const auto second = v.next_epoch();
+        v.find_many(indices, found);
+        REQUIRE(changed(v, second) == std::map<std::uint32_t, int>{{1, 1}, {8, 80}});
+    }
+
+    SECTION("Mutable iteration changes all elements")
+    {
+        for (const auto& value : std::as_const(v))
+            (void)value;
+        REQUIRE(changed(v, first).empty());
+
+        for (auto& value : v)
+            value += 1;
+        REQUIRE(changed(v, first).size() == v.size());
+        REQUIRE(changed(v, first).at(9) == 10);
+
+        const auto second = v.next_epoch();
+        REQUIRE(changed(v, second).empty());
+    }
+
+    SECTION("Copies and snapshots")
+    {
+        v[1] = 11;
+        const TrackedVector copy(v, testAllocator);
+        REQUIRE(changed(copy, first) == std::map<std::uint32_t, int>{{1, 11}});
+
+        std::ostringstream out(std::ios::binary);
+        v.write_snapshot(out);
+        const auto bytes = out.str();
+        std::vector<std::uint64_t> storage((bytes.size() + 7) / 8);
+        std::memcpy(storage.data(), bytes.data(), bytes.size());
+        const auto loaded = TrackedVector::from_snapshot(std::as_bytes(std::span(storage)).first(bytes.size()), testAllocator);
+        REQUIRE(changed(loaded, 0).size() == v.size());
+    }
+}
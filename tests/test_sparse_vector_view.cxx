@@ -0,0 +1,116 @@
+#include <catch.hpp>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mixedbag/sparse_vector.hxx>
+#include <mixedbag/sparse_vector_view.hxx>
+
+TEST_CASE("sparse_vector_view", "[normal]")
+{
+    ARo::sparse_vector<double, std::uint32_t> v;
+    std::map<std::uint32_t, double> expected;
+    for (std::uint32_t i = 1; i < 1000; i *= 3) {
+        v.insert(i, i * 0.5);
+        expected[i] = i * 0.5;
+    }
+    v.erase(9);
+    expected.erase(9);
+
+    std::ostringstream out(std::ios::binary);
+    v.write_snapshot(out);
+    const auto bytes = out.str();
+    std::vector<std::uint64_t> storage((bytes.size() + 7) / 8);
+    std::memcpy(storage.data(), bytes.data(), bytes.size());
+    const std::span snapshot(reinterpret_cast<const std::byte*>(storage.data()), bytes.size());
+
+    SECTION("Lookup and iteration use the snapshot in place")
+    {
+        const ARo::sparse_vector_view<double, std::uint32_t> view(snapshot);
+        REQUIRE(view.size() == expected.size());
+        REQUIRE(!view.empty());
+
+        for (auto [index, value] : expected) {
+            REQUIRE(view.contains(index));
+            REQUIRE(view[index] == value);
+        }
+        REQUIRE(!view.contains(9));
+        REQUIRE(!view.contains(10'000));
+        REQUIRE_THROWS(view[9]);
+        REQUIRE_THROWS(view[10'000]);
+
+        const auto* first = reinterpret_cast<const double*>(&*view.begin());
+        REQUIRE(reinterpret_cast<const std::byte*>(first) >= snapshot.data());
+        REQUIRE(reinterpret_cast<const std::byte*>(first) < snapshot.data() + snapshot.size());
+        REQUIRE(std::ranges::equal(view, v));
+
+        std::map<std::uint32_t, double> seen;
+        for (auto [index, value] : view.items())
+            seen[index] = value;
+        REQUIRE(seen == expected);
+        REQUIRE(std::ranges::equal(view.indices(), v.items() | std::views::keys));
+    }
+
+    SECTION("Widely spread indices are found through the sorted lookup")
+    {
+        ARo::sparse_vector<double, std::uint32_t, true, ARo::BitmapIndex> spread;
+        std::map<std::uint32_t, double> spreadExpected;
+        for (std::uint32_t i = 0; i < 100; ++i) {
+            const auto index = 4'000'000'000U - i * 1'000'003U;
+            spread.insert(index, i * 0.25);
+            spreadExpected[index] = i * 0.25;
+        }
+
+        std::ostringstream spreadOut(std::ios::binary);
+        spread.write_snapshot(spreadOut);
+        const auto spreadBytes = spreadOut.str();
+        REQUIRE(spreadBytes.size() < 4096);
+        std::vector<std::uint64_t> spreadStorage((spreadBytes.size() + 7) / 8);
+        std::memcpy(spreadStorage.data(), spreadBytes.data(), spreadBytes.size());
+
+        const ARo::sparse_vector_view<double, std::uint32_t> view({reinterpret_cast<const std::byte*>(spreadStorage.data()), spreadBytes.size()});
+        REQUIRE(view.size() == spreadExpected.size());
+        for (auto [index, value] : spreadExpected) {
+            REQUIRE(view.contains(index));
+            REQUIRE(view[index] == value);
+            REQUIRE(!view.contains(index + 1));
+            REQUIRE_THROWS(view[index - 1]);
+        }
+        REQUIRE(!view.contains(0));
+        REQUIRE(!view.contains(4'294'967'295U));
+        REQUIRE(std::ranges::equal(view, std::as_const(spread)));
+
+        const ARo::sparse_vector_view<double, std::uint32_t, false> unchecked({reinterpret_cast<const std::byte*>(spreadStorage.data()), spreadBytes.size()});
+        for (auto [index, value] : spreadExpected)
+            REQUIRE(unchecked[index] == value);
+    }
+
+    SECTION("Default constructed and mismatched views")
+    {
+        const ARo::sparse_vector_view<double, std::uint32_t> view;
+        REQUIRE(view.empty());
+        REQUIRE(!view.contains(0));
+        REQUIRE(view.begin() == view.end());
+
+        REQUIRE_THROWS((ARo::sparse_vector_view<float, std::uint32_t>(snapshot)));
+        REQUIRE_THROWS((ARo::sparse_vector_view<double, std::uint64_t>(snapshot)));
+        REQUIRE_THROWS((ARo::sparse_vector_view<double, std::uint32_t>(snapshot.first(100))));
+    }
+
+    SECTION("Positions past the elements are not read through")
+    {
+        // Six elements spread over 730 indices have a sorted lookup at byte 64, with the six indices followed by their positions
+        auto corrupt = storage;
+        const std::uint32_t pastElements = 100;
+        std::memcpy(reinterpret_cast<std::byte*>(corrupt.data()) + 64 + 6 * sizeof(std::uint32_t), &pastElements, sizeof(pastElements));
+        const ARo::sparse_vector_view<double, std::uint32_t> view(std::as_bytes(std::span(corrupt)).first(bytes.size()));
+
+        REQUIRE_FALSE(view.contains(1));
+        REQUIRE_THROWS_AS(view[1], std::runtime_error);
+        REQUIRE(view[3] == 1.5);
+    }
+}
@@ -0,0 +1,202 @@
+#include <catch.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <mixedbag/static_sparse_vector.hxx>
+
+namespace {
+    constexpr ARo::static_sparse_vector<std::string_view, 600, 3> Reasons{{200, "OK"}, {404, "Not Found"}, {500, "Internal Server Error"}};
+    static_assert(Reasons.size() == 3);
+    static_assert(Reasons[404] == "Not Found");
+    static_assert(Reasons.contains(500) && !Reasons.contains(201) && !Reasons.contains(601));
+    static_assert(*Reasons.find(200) == "OK" && Reasons.find(201) == Reasons.end() && Reasons.find(601) == Reasons.end());
+    static_assert(*Reasons.get_if(500) == "Internal Server Error" && Reasons.get_if(201) == nullptr);
+
+    constexpr int sum_after_erase()
+    {
+        ARo::static_sparse_vector<int, 20, 5> v;
+        for (int i = 1; i <= 5; ++i)
+            v.emplace(static_cast<std::uint8_t>(i * 3), i);
+        v.erase(6);
+        v.erase_if([](int value) { return value == 4; });
+        int sum = 0;
+        v.each([&sum](auto index, int value) { sum += index * value; });
+        return sum;
+    }
+    static_assert(sum_after_erase() == 3 * 1 + 9 * 3 + 15 * 5);
+
+    static_assert(std::is_same_v<ARo::static_sparse_vector<int, 254, 10>::size_type, std::uint8_t>);
+    static_assert(std::is_same_v<ARo::static_sparse_vector<int, 255, 10>::size_type, std::uint16_t>);
+    static_assert(std::is_same_v<ARo::static_sparse_vector<int, 100, 1000>::size_type, std::uint16_t>);
+    static_assert(std::is_same_v<ARo::static_sparse_vector<int, 70000, 10>::size_type, std::uint32_t>);
+} // namespace
+
+TEST_CASE("static_sparse_vector", "[normal]")
+{
+    ARo::static_sparse_vector<std::string, 1000, 8> v;
+    std::map<std::uint16_t, std::string> expected;
+
+    SECTION("Insertion, lookup and erasure")
+    {
+        REQUIRE(v.empty());
+        for (std::uint16_t i = 1; i < 1000; i *= 3) {
+            v.insert(i, std::to_string(i));
+            expected[i] = std::to_string(i);
+        }
+        v.emplace(500, 3, 'x');
+        expected[500] = "xxx";
+        v.erase(9);
+        expected.erase(9);
+
+        REQUIRE(v.size() == expected.size());
+        for (auto [index, value] : expected)
+            REQUIRE(v[index] == value);
+        REQUIRE(!v.contains(9));
+
+        std::map<std::uint16_t, std::string> items;
+        for (auto [index, value] : v.items())
+            items[index] = value;
+        REQUIRE(items == expected);
+
+        REQUIRE(v.erase_if([](const std::string& value) { return value.size() == 3; }) == 3);
+        REQUIRE(v.size() == expected.size() - 3);
+        REQUIRE(std::vector<std::string>(v.begin(), v.end()) == std::vector<std::string>{"1", "3", "27", "81"});
+
+        v.clear();
+        REQUIRE(v.empty());
+        REQUIRE(!v.contains(1));
+    }
+
+    SECTION("A throwing predicate leaves erase_if consistent")
+    {
+        v.insert(1, "a");
+        v.insert(2, "b");
+        v.insert(3, "c");
+        v.insert(4, "d");
+
+        int calls = 0;
+        const auto throwsOnSecondCall = [&calls](const std::string& value) {
+            if (++calls == 2)
+                throw std::runtime_error("predicate");
+            return value == "a";
+        };
+        REQUIRE_THROWS_AS(v.erase_if(throwsOnSecondCall), std::runtime_error);
+
+        REQUIRE(v.size() == 3U);
+        REQUIRE_FALSE(v.contains(1));
+        REQUIRE((v.contains(2) && v.contains(3) && v.contains(4)));
+        REQUIRE(v[2] == "b");
+        REQUIRE(v[4] == "d");
+        REQUIRE(std::vector<std::string>(v.begin(), v.end()) == std::vector<std::string>{"b", "c", "d"});
+    }
+
+    SECTION("Equality does not depend on the order in storage")
+    {
+        decltype(v) other;
+        v.insert(1, "a");
+        v.insert(2, "b");
+        other.insert(2, "b");
+        other.insert(1, "a");
+        REQUIRE(v == other);
+
+        other[1] = "c";
+        REQUIRE(v != other);
+    }
+
+    SECTION("Checked access and capacity")
+    {
+        REQUIRE_THROWS_AS(v[3], std::runtime_error);
+        REQUIRE_THROWS_AS(v.insert(1001, "x"), std::runtime_error);
+        v.insert(1, "x");
+        REQUIRE_THROWS_AS(v.insert(1, "y"), std::runtime_error);
+        for (std::uint16_t i = 2; i <= decltype(v)::max_size(); ++i)
+            v.insert(i, "x");
+        REQUIRE_THROWS_AS(v.insert(100, "x"), std::runtime_error);
+        REQUIRE_THROWS_AS(v.erase(100), std::runtime_error);
+    }
+
+    SECTION("Indices wider than the size type are checked, not truncated")
+    {
+        ARo::static_sparse_vector<int, 200, 10> narrow;
+        static_assert(std::is_same_v<decltype(narrow)::size_type, std::uint8_t>);
+
+        REQUIRE_THROWS_AS(narrow.insert(300, 1), std::runtime_error);
+        REQUIRE_THROWS_AS(narrow.emplace(256 + 44, 1), std::runtime_error);
+        REQUIRE(narrow.empty());
+        REQUIRE_FALSE(narrow.contains(44));
+        REQUIRE_FALSE(narrow.contains(300));
+
+        narrow.insert(44, 1);
+        REQUIRE_THROWS_AS(narrow[300], std::runtime_error);
+        REQUIRE_THROWS_AS(narrow.erase(300), std::runtime_error);
+        REQUIRE(narrow[44] == 1);
+    }
+
+    SECTION("Move-aware modifiers")
+    {
+        ARo::static_sparse_vector<std::unique_ptr<int>, 10, 4> owners;
+        auto value = std::make_unique<int>(1);
+        const auto* address = value.get();
+        REQUIRE(owners.insert(1, std::move(value)).get() == address);
+
+        auto spare = std::make_unique<int>(2);
+        auto [element, inserted] = owners.try_emplace(1, std::move(spare));
+        REQUIRE_FALSE(inserted);
+        REQUIRE(element.get() == address);
+        REQUIRE(spare != nullptr); // NOLINT: Not moved from, since nothing was inserted
+
+        auto unused = std::make_unique<int>(3);
+        REQUIRE(owners.try_emplace(2, std::move(unused)).second);
+        REQUIRE(*owners[2] == 3);
+
+        REQUIRE_FALSE(owners.insert_or_assign(1, std::make_unique<int>(4)).second);
+        REQUIRE(*owners[1] == 4);
+        REQUIRE(owners.insert_or_assign(5, std::make_unique<int>(5)).second);
+        REQUIRE(owners.size() == 3U);
+    }
+
+    SECTION("Non-throwing lookup")
+    {
+        v.insert(3, "c");
+        REQUIRE(*v.find(3) == "c");
+        REQUIRE(v.find(4) == v.end());
+        REQUIRE(v.find(1001) == v.end());
+
+        *v.get_if(3) = "d";
+        REQUIRE(v[3] == "d");
+        REQUIRE(v.get_if(4) == nullptr);
+        REQUIRE(std::as_const(v).get_if(1001) == nullptr);
+    }
+
+    SECTION("A failed insertion leaves the static_sparse_vector unchanged")
+    {
+        struct ThrowsOnNegative {
+            int value = 0;
+
+            ThrowsOnNegative() = default;
+
+            explicit ThrowsOnNegative(int val)
+                : value(val)
+            {
+                if (val < 0)
+                    throw std::invalid_argument("negative");
+            }
+        };
+
+        ARo::static_sparse_vector<ThrowsOnNegative, 10, 4> throwing;
+        throwing.emplace(1, 1);
+        REQUIRE_THROWS_AS(throwing.emplace(2, -1), std::invalid_argument);
+        REQUIRE(throwing.size() == 1U);
+        REQUIRE_FALSE(throwing.contains(2));
+        REQUIRE(throwing.emplace(2, 2).value == 2);
+        REQUIRE(throwing[1].value == 1);
+        REQUIRE(throwing.end() - throwing.begin() == 2);
+    }
+}